@@ -0,0 +1,554 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_arpcache.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Hash indexed ARP cache with LRU eviction, see sr_arpcache.h.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stddef.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sr_arpcache.h"
+
+static uint32_t arp_hash(int if_index, uint32_t ip)
+{
+    uint32_t h = ip ^ ((uint32_t)if_index * 0x9e3779b1);
+
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+} /* -- arp_hash -- */
+
+/* -- a write section: readers that overlap one take what they read as a miss -- */
+static void arp_write_begin(struct sr_arpcache* cache)
+{
+    __atomic_store_n(&cache->seq, cache->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+} /* -- arp_write_begin -- */
+
+static void arp_write_end(struct sr_arpcache* cache)
+{
+    __atomic_store_n(&cache->seq, cache->seq + 1, __ATOMIC_RELEASE);
+} /* -- arp_write_end -- */
+
+/* -- index slot holding (if_index, ip), or the empty slot ending its probe -- */
+static uint32_t arp_slot(const struct sr_arpcache* cache, int if_index,
+                         uint32_t ip)
+{
+    const struct sr_arp_entry* e;
+    uint32_t i = arp_hash(if_index, ip) & cache->index_mask;
+
+    while(cache->index[i])
+    {
+        e = &cache->entries[cache->index[i] - 1];
+        if(e->ip == ip && e->if_index == if_index)
+        { break; }
+        i = (i + 1) & cache->index_mask;
+    }
+    return i;
+} /* -- arp_slot -- */
+
+/*---------------------------------------------------------------------
+ * Method: arp_index_delete(..)
+ * Scope: Local
+ *
+ * Empty index slot i, moving later members of its probe run back so
+ * every entry stays reachable from its home slot.
+ *
+ *---------------------------------------------------------------------*/
+
+static void arp_index_delete(struct sr_arpcache* cache, uint32_t i)
+{
+    const struct sr_arp_entry* e;
+    uint32_t j = i, home;
+
+    for(;;)
+    {
+        j = (j + 1) & cache->index_mask;
+        if(cache->index[j] == 0)
+        { break; }
+        e = &cache->entries[cache->index[j] - 1];
+        home = arp_hash(e->if_index, e->ip) & cache->index_mask;
+
+        /* -- j can fill the hole only if its home is not in (i, j] -- */
+        if(((j - home) & cache->index_mask) >= ((j - i) & cache->index_mask))
+        {
+            __atomic_store_n(&cache->index[i], cache->index[j], __ATOMIC_RELAXED);
+            i = j;
+        }
+    }
+    __atomic_store_n(&cache->index[i], 0, __ATOMIC_RELAXED);
+} /* -- arp_index_delete -- */
+
+static void arp_lru_unlink(struct sr_arpcache* cache, uint32_t n)
+{
+    struct sr_arp_entry* e = &cache->entries[n];
+
+    if(e->lru_prev != SR_ARP_NIL)
+    { cache->entries[e->lru_prev].lru_next = e->lru_next; }
+    else
+    { cache->lru_head = e->lru_next; }
+    if(e->lru_next != SR_ARP_NIL)
+    { cache->entries[e->lru_next].lru_prev = e->lru_prev; }
+    else
+    { cache->lru_tail = e->lru_prev; }
+} /* -- arp_lru_unlink -- */
+
+static void arp_lru_push(struct sr_arpcache* cache, uint32_t n)
+{
+    struct sr_arp_entry* e = &cache->entries[n];
+
+    e->lru_prev = SR_ARP_NIL;
+    e->lru_next = cache->lru_head;
+    if(cache->lru_head != SR_ARP_NIL)
+    { cache->entries[cache->lru_head].lru_prev = n; }
+    else
+    { cache->lru_tail = n; }
+    cache->lru_head = n;
+} /* -- arp_lru_push -- */
+
+/* -- take entry n out of the index and the LRU list and free its slot, in a
+ *    write section -- */
+static void arp_release(struct sr_arpcache* cache, uint32_t slot, uint32_t n)
+{
+    if(cache->wheel)
+    { sr_timer_cancel(cache->wheel, &cache->entries[n].timer); }
+    arp_index_delete(cache, slot);
+    arp_lru_unlink(cache, n);
+    __atomic_store_n(&cache->entries[n].used, 0, __ATOMIC_RELAXED);
+    cache->entries[n].lru_next = cache->free_list;
+    cache->free_list = n;
+    cache->count--;
+} /* -- arp_release -- */
+
+/* -- e was confirmed at now: good for its whole life again -- */
+static void arp_confirmed(struct sr_arpcache* cache, struct sr_arp_entry* e,
+                          time_t now)
+{
+    e->created = now;
+    e->state = SR_ARP_VALID;
+    __atomic_store_n(&e->hit, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->seen, 0, __ATOMIC_RELAXED);
+    if(cache->wheel)
+    {
+        sr_timer_arm(cache->wheel, &e->timer, sr_timer_wheel_now(cache->wheel),
+                     SR_ARP_TIMEOUT_MS - SR_ARP_REFRESH_MS);
+    }
+} /* -- arp_confirmed -- */
+
+/*---------------------------------------------------------------------
+ * Method: arp_timer_fired(..)
+ * Scope: Local
+ *
+ * An entry reached its refresh point or timed out.  At the refresh
+ * point an entry its host was seen sending through is confirmed again;
+ * any other in use is refreshed, and every entry is given the rest of
+ * its life.  Only a new confirmation, through sr_arpcache_insert, saves
+ * it from being removed at the end of it.
+ *
+ *---------------------------------------------------------------------*/
+
+static void arp_timer_fired(struct sr_timer* timer, void* arg)
+{
+    struct sr_arpcache* cache = (struct sr_arpcache*)arg;
+    struct sr_arp_entry* e = (struct sr_arp_entry*)
+        ((char*)timer - offsetof(struct sr_arp_entry, timer));
+
+    if(e->state == SR_ARP_VALID)
+    {
+        if(__atomic_load_n(&e->seen, __ATOMIC_RELAXED))
+        {
+            arp_confirmed(cache, e, time(0));
+            return;
+        }
+        e->state = SR_ARP_EXPIRING;
+        if(__atomic_load_n(&e->hit, __ATOMIC_RELAXED) && cache->refresh)
+        {
+            cache->refresh(cache->ctx, e);
+            cache->refreshes++;
+        }
+        sr_timer_arm(cache->wheel, &e->timer, sr_timer_wheel_now(cache->wheel),
+                     SR_ARP_REFRESH_MS);
+        return;
+    }
+
+    cache->expired++;
+    sr_arpcache_remove(cache, e->if_index, e->ip);
+} /* -- arp_timer_fired -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_arpcache_create(..)
+ * Scope: Global
+ *
+ * Allocate a cache holding at most capacity mappings.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_arpcache* sr_arpcache_create(unsigned int capacity)
+{
+    struct sr_arpcache* cache;
+    uint32_t size = 2, i;
+
+    if(capacity == 0)
+    { capacity = SR_ARP_DEFAULT_CAPACITY; }
+    while(size < 2 * capacity)
+    { size <<= 1; }
+
+    cache = (struct sr_arpcache*)calloc(1, sizeof(struct sr_arpcache));
+    assert(cache);
+    cache->entries = (struct sr_arp_entry*)calloc(capacity,
+            sizeof(struct sr_arp_entry));
+    cache->index = (uint32_t*)calloc(size, sizeof(uint32_t));
+    assert(cache->entries && cache->index);
+    cache->index_mask = size - 1;
+    cache->capacity = capacity;
+
+    for(i = 0; i < capacity; i++)
+    { cache->entries[i].lru_next = i + 1 < capacity ? i + 1 : SR_ARP_NIL; }
+    cache->free_list = 0;
+    cache->lru_head = cache->lru_tail = SR_ARP_NIL;
+    for(i = 0; i < capacity; i++)
+    { sr_timer_init(&cache->entries[i].timer, arp_timer_fired, cache); }
+
+    return cache;
+} /* -- sr_arpcache_create -- */
+
+void sr_arpcache_destroy(struct sr_arpcache* cache)
+{
+    unsigned int i;
+
+    if(cache == 0)
+    { return; }
+    for(i = 0; cache->wheel && i < cache->capacity; i++)
+    { sr_timer_cancel(cache->wheel, &cache->entries[i].timer); }
+    free(cache->entries);
+    free(cache->index);
+    free(cache);
+} /* -- sr_arpcache_destroy -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_arpcache_set_aging(..)
+ * Scope: Global
+ *
+ * Age entries on wheel from now on, calling refresh(ctx, entry) for the
+ * ones in use shortly before they time out.  Must be called before the
+ * first insert.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_arpcache_set_aging(struct sr_arpcache* cache,
+        struct sr_timer_wheel* wheel,
+        void (*refresh)(void* ctx, const struct sr_arp_entry* entry),
+        void* ctx)
+{
+    assert(cache->count == 0);
+    cache->wheel = wheel;
+    cache->refresh = refresh;
+    cache->ctx = ctx;
+} /* -- sr_arpcache_set_aging -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_arpcache_lookup(..)
+ * Scope: Global
+ *
+ * Return the mapping for ip on interface if_index, or 0, marking it as
+ * the most recently used and as in use for aging.
+ *
+ *---------------------------------------------------------------------*/
+
+/* -- entry n was used: move it to the front of the LRU list -- */
+static struct sr_arp_entry* arp_touch(struct sr_arpcache* cache, uint32_t n)
+{
+    if(cache->lru_head != n)
+    {
+        arp_lru_unlink(cache, n);
+        arp_lru_push(cache, n);
+    }
+    __atomic_store_n(&cache->entries[n].hit, 1, __ATOMIC_RELAXED);
+    return &cache->entries[n];
+} /* -- arp_touch -- */
+
+struct sr_arp_entry* sr_arpcache_lookup(struct sr_arpcache* cache,
+        int if_index, uint32_t ip)
+{
+    uint32_t slot = arp_slot(cache, if_index, ip);
+
+    if(cache->index[slot] == 0)
+    { return 0; }
+    return arp_touch(cache, cache->index[slot] - 1);
+} /* -- sr_arpcache_lookup -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_arpcache_lookup_hint(..)
+ * Scope: Global
+ *
+ * sr_arpcache_lookup, trying the slot in *hint (entry number + 1, 0 for
+ * none) first and leaving the slot found there for next time.  *hint
+ * may be shared with other threads, as sr_rt_adj is, so it is read and
+ * written atomically.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_arp_entry* sr_arpcache_lookup_hint(struct sr_arpcache* cache,
+        int if_index, uint32_t ip, uint32_t* hint)
+{
+    uint32_t n = __atomic_load_n(hint, __ATOMIC_RELAXED) - 1;
+    struct sr_arp_entry* e;
+
+    if(n < cache->capacity)
+    {
+        e = &cache->entries[n];
+        if(e->used && e->ip == ip && e->if_index == if_index)
+        { return arp_touch(cache, n); }
+    }
+    if((e = sr_arpcache_lookup(cache, if_index, ip)) != 0)
+    { __atomic_store_n(hint, e - cache->entries + 1, __ATOMIC_RELAXED); }
+    return e;
+} /* -- sr_arpcache_lookup_hint -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_arpcache_insert(..)
+ * Scope: Global
+ *
+ * Record that ip on interface if_index, whose own address is if_mac,
+ * is at mac as of now, adding the mapping if it is new.  A full cache
+ * makes room by evicting its least recently used entry, passing over
+ * those a worker read since they were last passed over.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_arp_entry* sr_arpcache_insert(struct sr_arpcache* cache,
+        int if_index, uint32_t ip, const unsigned char* mac,
+        const unsigned char* if_mac, time_t now)
+{
+    struct sr_ethernet_hdr eth;
+    struct sr_arp_entry* e;
+    uint32_t slot = arp_slot(cache, if_index, ip);
+    uint32_t n, i;
+
+    arp_write_begin(cache);
+    if(cache->index[slot])
+    {
+        n = cache->index[slot] - 1;
+        if(cache->lru_head != n)
+        {
+            arp_lru_unlink(cache, n);
+            arp_lru_push(cache, n);
+        }
+    }
+    else
+    {
+        if(cache->free_list == SR_ARP_NIL)
+        {
+            for(i = 0; i < cache->count; i++)
+            {
+                e = &cache->entries[cache->lru_tail];
+                if(!__atomic_load_n(&e->ref, __ATOMIC_RELAXED))
+                { break; }
+                __atomic_store_n(&e->ref, 0, __ATOMIC_RELAXED);
+                n = cache->lru_tail;
+                arp_lru_unlink(cache, n);
+                arp_lru_push(cache, n);
+            }
+            n = cache->lru_tail;
+            e = &cache->entries[n];
+            arp_release(cache, arp_slot(cache, e->if_index, e->ip), n);
+            cache->evictions++;
+
+            /* -- the deletion may have shifted our probe run -- */
+            slot = arp_slot(cache, if_index, ip);
+        }
+        n = cache->free_list;
+        cache->free_list = cache->entries[n].lru_next;
+        cache->count++;
+
+        e = &cache->entries[n];
+        __atomic_store_n(&e->ip, ip, __ATOMIC_RELAXED);
+        __atomic_store_n(&e->if_index, if_index, __ATOMIC_RELAXED);
+        __atomic_store_n(&e->ref, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&e->used, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&cache->index[slot], n + 1, __ATOMIC_RELAXED);
+        arp_lru_push(cache, n);
+    }
+
+    e = &cache->entries[n];
+    memcpy(e->mac, mac, 6);
+    memcpy(eth.ether_dhost, mac, ETHER_ADDR_LEN);
+    memcpy(eth.ether_shost, if_mac, ETHER_ADDR_LEN);
+    eth.ether_type = htons(ETHERTYPE_IP);
+    for(i = 0; i < sizeof(e->hdr); i++)
+    { __atomic_store_n(&e->hdr[i], ((uint8_t*)&eth)[i], __ATOMIC_RELAXED); }
+    arp_write_end(cache);
+
+    arp_confirmed(cache, e, now);
+    return e;
+} /* -- sr_arpcache_insert -- */
+
+/*---------------------------------------------------------------------
+ * Method: arp_read(..)
+ * Scope: Local
+ *
+ * The entry number of ip on if_index, or SR_ARP_NIL, copying its
+ * header to hdr; what sr_arpcache_lookup_hint does, for any thread.
+ * Everything the packet thread may be changing is read atomically, and
+ * the answer stands only if no write section overlapped the reading.
+ *
+ *---------------------------------------------------------------------*/
+
+static uint32_t arp_read(struct sr_arpcache* cache, int if_index,
+                         uint32_t ip, uint32_t* hint, uint8_t* hdr)
+{
+    const struct sr_arp_entry* e;
+    uint32_t seq = __atomic_load_n(&cache->seq, __ATOMIC_ACQUIRE);
+    uint32_t n = SR_ARP_NIL, i, k;
+
+    if(seq & 1)
+    { return SR_ARP_NIL; }
+
+    if(hint)
+    { n = __atomic_load_n(hint, __ATOMIC_RELAXED) - 1; }
+    if(n >= cache->capacity ||
+       !__atomic_load_n(&cache->entries[n].used, __ATOMIC_RELAXED) ||
+       __atomic_load_n(&cache->entries[n].ip, __ATOMIC_RELAXED) != ip ||
+       __atomic_load_n(&cache->entries[n].if_index, __ATOMIC_RELAXED) != if_index)
+    {
+        /* -- the probe of arp_slot, bounded: the index may be shifting -- */
+        n = SR_ARP_NIL;
+        i = arp_hash(if_index, ip) & cache->index_mask;
+        for(k = 0; k <= cache->index_mask; k++)
+        {
+            n = __atomic_load_n(&cache->index[i], __ATOMIC_RELAXED) - 1;
+            if(n >= cache->capacity)
+            { return SR_ARP_NIL; }
+            e = &cache->entries[n];
+            if(__atomic_load_n(&e->ip, __ATOMIC_RELAXED) == ip &&
+               __atomic_load_n(&e->if_index, __ATOMIC_RELAXED) == if_index)
+            { break; }
+            i = (i + 1) & cache->index_mask;
+        }
+        if(k > cache->index_mask)
+        { return SR_ARP_NIL; }
+    }
+
+    e = &cache->entries[n];
+    for(i = 0; i < sizeof(e->hdr); i++)
+    { hdr[i] = __atomic_load_n(&e->hdr[i], __ATOMIC_RELAXED); }
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&cache->seq, __ATOMIC_RELAXED) != seq)
+    { return SR_ARP_NIL; }
+    if(hint)
+    { __atomic_store_n(hint, n + 1, __ATOMIC_RELAXED); }
+    return n;
+} /* -- arp_read -- */
+
+/* -- set flag, unless it is already: entries are shared between workers -- */
+static void arp_mark(uint8_t* flag)
+{
+    if(!__atomic_load_n(flag, __ATOMIC_RELAXED))
+    { __atomic_store_n(flag, 1, __ATOMIC_RELAXED); }
+} /* -- arp_mark -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_arpcache_read(..)
+ * Scope: Global
+ *
+ * sr_arpcache_lookup_hint for a forwarding worker: copy the Ethernet
+ * header to send to ip on if_index with to hdr, and mark the entry as
+ * in use.  hint may be 0.  Returns 0, or -1 if there is no mapping or
+ * the packet thread was changing the cache; either way the packet
+ * thread should look again.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_arpcache_read(struct sr_arpcache* cache, int if_index, uint32_t ip,
+        uint32_t* hint, uint8_t* hdr)
+{
+    uint32_t n = arp_read(cache, if_index, ip, hint, hdr);
+
+    if(n == SR_ARP_NIL)
+    { return -1; }
+    /* -- the slot may have been reused since; that costs a refresh -- */
+    arp_mark(&cache->entries[n].hit);
+    arp_mark(&cache->entries[n].ref);
+    return 0;
+} /* -- sr_arpcache_read -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_arpcache_confirm(..)
+ * Scope: Global
+ *
+ * A frame from mac with ip as its source came in on if_index.  If ip
+ * has a mapping there, to mac, mark it seen: at its refresh point it
+ * is confirmed again rather than refreshed.  Never adds a mapping, so
+ * never evicts one; for what traffic other than ARP says about its
+ * sender.  Safe on any thread.  Returns 1 if the mapping was marked.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_arpcache_confirm(struct sr_arpcache* cache, int if_index,
+        uint32_t ip, const unsigned char* mac)
+{
+    uint8_t hdr[sizeof(struct sr_ethernet_hdr)];
+    uint32_t n = arp_read(cache, if_index, ip, 0, hdr);
+
+    if(n == SR_ARP_NIL || memcmp(hdr, mac, ETHER_ADDR_LEN) != 0)
+    { return 0; }
+    arp_mark(&cache->entries[n].seen);
+    return 1;
+} /* -- sr_arpcache_confirm -- */
+
+
+/*---------------------------------------------------------------------
+ * Method: sr_arpcache_remove(..)
+ * Scope: Global
+ *
+ * Forget the mapping for ip on if_index.  Returns 1 if there was one.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_arpcache_remove(struct sr_arpcache* cache, int if_index, uint32_t ip)
+{
+    uint32_t slot = arp_slot(cache, if_index, ip);
+
+    if(cache->index[slot] == 0)
+    { return 0; }
+    arp_write_begin(cache);
+    arp_release(cache, slot, cache->index[slot] - 1);
+    arp_write_end(cache);
+    return 1;
+} /* -- sr_arpcache_remove -- */
+
+/* -- print the entries, most recently used first -- */
+void sr_arpcache_print(struct sr_arpcache* cache)
+{
+    struct sr_arp_entry* e;
+    struct in_addr addr;
+    uint32_t n;
+
+    printf("ARP cache: %u of %u entries, %lu evicted, %lu refreshed, "
+           "%lu expired\n", cache->count, cache->capacity, cache->evictions,
+           cache->refreshes, cache->expired);
+    for(n = cache->lru_head; n != SR_ARP_NIL; n = e->lru_next)
+    {
+        e = &cache->entries[n];
+        addr.s_addr = e->ip;
+        printf("  %-15s %02x:%02x:%02x:%02x:%02x:%02x if %d age %lds\n",
+               inet_ntoa(addr), e->mac[0], e->mac[1], e->mac[2], e->mac[3],
+               e->mac[4], e->mac[5], e->if_index,
+               (long)(time(0) - e->created));
+    }
+} /* -- sr_arpcache_print -- */
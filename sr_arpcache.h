@@ -0,0 +1,135 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_arpcache.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * ARP cache shared by all interfaces, mapping (interface, IP address) to
+ * an Ethernet address.
+ *
+ * Entries live in a slab allocated once at the configured capacity.  An
+ * open addressing hash table with linear probing indexes them, and is
+ * kept at most half full so a lookup touches one or two slots.  Entries
+ * are also kept on an LRU list; when the cache is full, inserting a new
+ * mapping evicts the least recently used one.  Removal uses backward
+ * shift deletion, so the index never fills up with tombstones.
+ *
+ * Each entry is also the adjacency of its host: hdr is the Ethernet
+ * header every IP packet to it is sent with, rewritten in place when
+ * the host's address changes.  A route keeps the slot of its gateway's
+ * entry as a hint, which sr_arpcache_lookup_hint tries before hashing.
+ *
+ * The cache is changed only on the packet thread, but forwarding
+ * workers read it too, through sr_arpcache_read.  Every change to the
+ * index or to which host an entry holds, or its header, is made inside
+ * a write section of the cache's sequence count; a reader that saw the
+ * count change, or odd, under it takes its answer as a miss.  Workers
+ * cannot move an entry on the LRU list, so they set its ref bit and
+ * eviction gives such an entry a second chance.
+ *
+ * Given a timer wheel, the cache also ages its entries.  A mapping is
+ * good for SR_ARP_TIMEOUT_MS after it was last confirmed.  Shortly
+ * before that, one that was looked up since is refreshed through the
+ * refresh callback, which should send a unicast ARP request; the reply
+ * confirms it again before anyone misses.  One that was not looked up,
+ * or whose refresh went unanswered, is removed when it times out.
+ * Other traffic from a host, marked by sr_arpcache_confirm, confirms
+ * its mapping at the refresh point instead; but only ARP adds one.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_ARPCACHE_H
+#define SR_ARPCACHE_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include <time.h>
+
+#include "sr_protocol.h"
+#include "sr_timer.h"
+
+#define SR_ARP_DEFAULT_CAPACITY 4096
+#define SR_ARP_NIL 0xffffffffU /* end of an entry list */
+
+#define SR_ARP_TIMEOUT_MS 15000 /* life of a mapping after confirmation */
+#define SR_ARP_REFRESH_MS 2000  /* refresh this long before timing out */
+
+/* -- sr_arp_entry.state -- */
+#define SR_ARP_VALID    0 /* confirmed, not yet due for refresh */
+#define SR_ARP_EXPIRING 1 /* in the last SR_ARP_REFRESH_MS of its life */
+
+/* ----------------------------------------------------------------------------
+ * struct sr_arp_entry
+ *
+ * One mapping.  Pointers to an entry stay valid until the next insert
+ * or remove, either of which may reuse its slot.  Workers set hit, ref
+ * and seen at any time, so they are only accessed atomically.
+ *
+ * -------------------------------------------------------------------------- */
+
+struct sr_arp_entry
+{
+    uint32_t ip;             /* network byte order */
+    int if_index;            /* sr_if.index the host is reached through */
+    uint8_t hdr[sizeof(struct sr_ethernet_hdr)]; /* to mac from if_index */
+    unsigned char mac[6];
+    uint8_t used;            /* slot holds a mapping */
+    uint8_t state;           /* SR_ARP_* */
+    uint8_t hit;             /* looked up since last confirmed */
+    uint8_t ref;             /* read by a worker since last passed over */
+    uint8_t seen;            /* traffic from the host since confirmed */
+    time_t created;          /* when the mapping was last confirmed */
+    struct sr_timer timer;   /* refresh or expiry */
+    uint32_t lru_prev;       /* towards the most recently used */
+    uint32_t lru_next;       /* towards the least recently used, or free */
+};
+
+struct sr_arpcache
+{
+    struct sr_arp_entry* entries; /* capacity slots */
+    uint32_t* index;              /* entry number + 1, 0 for empty */
+    uint32_t index_mask;          /* index size - 1, a power of two */
+    unsigned int capacity;
+    unsigned int count;
+    uint32_t free_list;
+    uint32_t lru_head;            /* most recently used */
+    uint32_t lru_tail;            /* next to be evicted */
+    unsigned long evictions;
+    uint32_t seq;                 /* odd while the packet thread writes */
+
+    /* -- aging, off unless sr_arpcache_set_aging gave a wheel -- */
+    struct sr_timer_wheel* wheel;
+    void (*refresh)(void* ctx, const struct sr_arp_entry* entry);
+    void* ctx;
+    unsigned long refreshes;
+    unsigned long expired;
+};
+
+struct sr_arpcache* sr_arpcache_create(unsigned int capacity);
+void sr_arpcache_destroy(struct sr_arpcache* cache);
+void sr_arpcache_set_aging(struct sr_arpcache* cache,
+        struct sr_timer_wheel* wheel,
+        void (*refresh)(void* ctx, const struct sr_arp_entry* entry),
+        void* ctx);
+
+struct sr_arp_entry* sr_arpcache_lookup(struct sr_arpcache* cache,
+        int if_index, uint32_t ip);
+struct sr_arp_entry* sr_arpcache_lookup_hint(struct sr_arpcache* cache,
+        int if_index, uint32_t ip, uint32_t* hint);
+struct sr_arp_entry* sr_arpcache_insert(struct sr_arpcache* cache,
+        int if_index, uint32_t ip, const unsigned char* mac,
+        const unsigned char* if_mac, time_t now);
+int sr_arpcache_read(struct sr_arpcache* cache, int if_index, uint32_t ip,
+        uint32_t* hint, uint8_t* hdr);
+int sr_arpcache_confirm(struct sr_arpcache* cache, int if_index,
+        uint32_t ip, const unsigned char* mac);
+int sr_arpcache_remove(struct sr_arpcache* cache, int if_index, uint32_t ip);
+void sr_arpcache_print(struct sr_arpcache* cache);
+
+#endif /* -- SR_ARPCACHE_H -- */
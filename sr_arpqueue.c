@@ -0,0 +1,304 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_arpqueue.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Packets waiting for ARP, queued per next hop, see sr_arpqueue.h.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stddef.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sr_arpqueue.h"
+
+static uint32_t arpq_bucket(int if_index, uint32_t ip)
+{
+    uint32_t h = ip ^ ((uint32_t)if_index * 0x9e3779b1);
+
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    return h & (SR_ARPQ_BUCKETS - 1);
+} /* -- arpq_bucket -- */
+
+/* -- the link pointing at the request for (if_index, ip), or at the end -- */
+static struct sr_arpreq** arpq_find(struct sr_arpqueue* queue, int if_index,
+                                    uint32_t ip)
+{
+    struct sr_arpreq** link = &queue->buckets[arpq_bucket(if_index, ip)];
+
+    while(*link && ((*link)->ip != ip || (*link)->if_index != if_index))
+    { link = &(*link)->hnext; }
+    return link;
+} /* -- arpq_find -- */
+
+/* -- unhook the request at link and stop its timer; its packets stay -- */
+static void arpq_detach(struct sr_arpqueue* queue, struct sr_arpreq** link)
+{
+    struct sr_arpreq* req = *link;
+
+    *link = req->hnext;
+    sr_timer_cancel(queue->wheel, &req->timer);
+    queue->requests--;
+    queue->npackets -= req->npackets;
+    queue->nbytes -= req->nbytes;
+} /* -- arpq_detach -- */
+
+static void arpq_free(struct sr_arpreq* req)
+{
+    struct sr_pbuf* pb;
+
+    while((pb = req->head) != 0)
+    {
+        req->head = pb->next;
+        pb->next = 0;
+        sr_pbuf_put(pb);
+    }
+    free(req);
+} /* -- arpq_free -- */
+
+/* -- wait for a reply to try number tries, doubling from the first -- */
+static unsigned int arpq_backoff(unsigned int tries)
+{
+    unsigned int ms = SR_ARPQ_RETRY_MS;
+
+    while(--tries && ms < SR_ARPQ_RETRY_MAX_MS)
+    { ms <<= 1; }
+    return ms < SR_ARPQ_RETRY_MAX_MS ? ms : SR_ARPQ_RETRY_MAX_MS;
+} /* -- arpq_backoff -- */
+
+/*---------------------------------------------------------------------
+ * Method: arpq_timer_fired(..)
+ * Scope: Local
+ *
+ * No reply in time: ask again and wait longer, or once every try is
+ * spent, report each waiting packet as unreachable and drop them all.
+ *
+ *---------------------------------------------------------------------*/
+
+static void arpq_timer_fired(struct sr_timer* timer, void* arg)
+{
+    struct sr_arpqueue* queue = (struct sr_arpqueue*)arg;
+    struct sr_arpreq* req = (struct sr_arpreq*)
+        ((char*)timer - offsetof(struct sr_arpreq, timer));
+    struct sr_pbuf* pb;
+
+    if(req->tries < SR_ARPQ_MAX_TRIES)
+    {
+        req->tries++;
+        queue->send(queue->ctx, req);
+        sr_timer_arm(queue->wheel, &req->timer,
+                     sr_timer_wheel_now(queue->wheel),
+                     arpq_backoff(req->tries));
+        return;
+    }
+
+    arpq_detach(queue, arpq_find(queue, req->if_index, req->ip));
+    queue->timeouts++;
+    for(pb = req->head; pb; pb = pb->next)
+    {
+        queue->failed++;
+        if(queue->unreachable)
+        { queue->unreachable(queue->ctx, req, pb); }
+    }
+    arpq_free(req);
+} /* -- arpq_timer_fired -- */
+
+/* -- a new request for (if_index, ip), linked in at link -- */
+static struct sr_arpreq* arpq_open(struct sr_arpqueue* queue,
+        struct sr_arpreq** link, int if_index, uint32_t ip)
+{
+    struct sr_arpreq* req;
+
+    req = (struct sr_arpreq*)calloc(1, sizeof(struct sr_arpreq));
+    assert(req);
+    req->ip = ip;
+    req->if_index = if_index;
+    req->tail = &req->head;
+    req->queue = queue;
+    sr_timer_init(&req->timer, arpq_timer_fired, queue);
+    *link = req;
+    queue->requests++;
+    return req;
+} /* -- arpq_open -- */
+
+/* -- send the first ARP request of req and wait for the reply -- */
+static void arpq_start(struct sr_arpqueue* queue, struct sr_arpreq* req)
+{
+    req->tries = 1;
+    queue->send(queue->ctx, req);
+    sr_timer_arm(queue->wheel, &req->timer, sr_timer_wheel_now(queue->wheel),
+                 arpq_backoff(req->tries));
+} /* -- arpq_start -- */
+
+struct sr_arpqueue* sr_arpqueue_create(struct sr_timer_wheel* wheel,
+        void (*send)(void* ctx, const struct sr_arpreq* req),
+        void (*transmit)(void* ctx, const struct sr_arpreq* req,
+                         struct sr_pbuf* pb, const unsigned char* mac),
+        void (*unreachable)(void* ctx, const struct sr_arpreq* req,
+                            struct sr_pbuf* pb),
+        void* ctx)
+{
+    struct sr_arpqueue* queue;
+
+    assert(wheel && send && transmit);
+    queue = (struct sr_arpqueue*)calloc(1, sizeof(struct sr_arpqueue));
+    assert(queue);
+    queue->wheel = wheel;
+    queue->send = send;
+    queue->transmit = transmit;
+    queue->unreachable = unreachable;
+    queue->ctx = ctx;
+    return queue;
+} /* -- sr_arpqueue_create -- */
+
+void sr_arpqueue_destroy(struct sr_arpqueue* queue)
+{
+    struct sr_arpreq* req;
+    unsigned int i;
+
+    if(queue == 0)
+    { return; }
+    for(i = 0; i < SR_ARPQ_BUCKETS; i++)
+    {
+        while((req = queue->buckets[i]) != 0)
+        {
+            arpq_detach(queue, &queue->buckets[i]);
+            arpq_free(req);
+        }
+    }
+    free(queue);
+} /* -- sr_arpqueue_destroy -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_arpqueue_add(..)
+ * Scope: Global
+ *
+ * Queue the frame in pb until ip on if_index is resolved, sending the
+ * first ARP request if there is none outstanding.  Returns 1 if it was
+ * queued, taking a reference of its own, or 0 if it was dropped for
+ * being over a limit.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_arpqueue_add(struct sr_arpqueue* queue, int if_index, uint32_t ip,
+        struct sr_pbuf* pb)
+{
+    struct sr_arpreq** link = arpq_find(queue, if_index, ip);
+    struct sr_arpreq* req = *link;
+    unsigned int len = pb->len;
+
+    if(queue->npackets >= SR_ARPQ_TOTAL_PACKETS ||
+       queue->nbytes + len > SR_ARPQ_TOTAL_BYTES ||
+       (req && (req->npackets >= SR_ARPQ_QUEUE_PACKETS ||
+                req->nbytes + len > SR_ARPQ_QUEUE_BYTES)))
+    {
+        queue->dropped++;
+        return 0;
+    }
+
+    sr_pbuf_hold(pb);
+    pb->next = 0;
+
+    if(req == 0)
+    { req = arpq_open(queue, link, if_index, ip); }
+
+    *req->tail = pb;
+    req->tail = &pb->next;
+    req->npackets++;
+    req->nbytes += len;
+    queue->npackets++;
+    queue->nbytes += len;
+    queue->queued++;
+
+    if(req->tries)
+    { queue->coalesced++; }
+    else
+    { arpq_start(queue, req); }
+    return 1;
+} /* -- sr_arpqueue_add -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_arpqueue_probe(..)
+ * Scope: Global
+ *
+ * Start resolving ip on if_index with nothing queued yet, retrying as
+ * for a packet.  Returns 1 if a request was opened, 0 if one is already
+ * outstanding or too many are.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_arpqueue_probe(struct sr_arpqueue* queue, int if_index, uint32_t ip)
+{
+    struct sr_arpreq** link = arpq_find(queue, if_index, ip);
+
+    if(*link || queue->requests >= SR_ARPQ_MAX_PROBES)
+    { return 0; }
+    arpq_start(queue, arpq_open(queue, link, if_index, ip));
+    queue->probes++;
+    return 1;
+} /* -- sr_arpqueue_probe -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_arpqueue_resolve(..)
+ * Scope: Global
+ *
+ * ip on if_index is at mac: transmit the packets waiting for it, in
+ * the order they arrived, and close its request.  Returns the number
+ * of packets transmitted.
+ *
+ *---------------------------------------------------------------------*/
+
+unsigned int sr_arpqueue_resolve(struct sr_arpqueue* queue, int if_index,
+        uint32_t ip, const unsigned char* mac)
+{
+    struct sr_arpreq** link;
+    struct sr_arpreq* req;
+    struct sr_pbuf* pb;
+    unsigned int n = 0;
+
+    if(queue->requests == 0)
+    { return 0; }
+    link = arpq_find(queue, if_index, ip);
+    if((req = *link) == 0)
+    { return 0; }
+
+    arpq_detach(queue, link);
+    for(pb = req->head; pb; pb = pb->next, n++)
+    { queue->transmit(queue->ctx, req, pb, mac); }
+    queue->sent += n;
+    arpq_free(req);
+    return n;
+} /* -- sr_arpqueue_resolve -- */
+
+void sr_arpqueue_print(struct sr_arpqueue* queue)
+{
+    struct sr_arpreq* req;
+    struct in_addr addr;
+    unsigned int i;
+
+    printf("ARP queue: %u requests, %u packets, %u bytes; %lu queued "
+           "(%lu behind a request in flight), %lu sent, %lu dropped, "
+           "%lu failed in %lu timeouts; %lu probes\n", queue->requests,
+           queue->npackets, queue->nbytes, queue->queued, queue->coalesced,
+           queue->sent, queue->dropped, queue->failed, queue->timeouts,
+           queue->probes);
+    for(i = 0; i < SR_ARPQ_BUCKETS; i++)
+    {
+        for(req = queue->buckets[i]; req; req = req->hnext)
+        {
+            addr.s_addr = req->ip;
+            printf("  %-15s if %d tries %u, %u packets\n", inet_ntoa(addr),
+                   req->if_index, req->tries, req->npackets);
+        }
+    }
+} /* -- sr_arpqueue_print -- */
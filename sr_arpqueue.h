@@ -0,0 +1,114 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_arpqueue.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Packets waiting for ARP, queued per next hop.
+ *
+ * The first packet to miss the ARP cache for a next hop (interface, IP
+ * address) opens a request for it and sends one ARP request.  Later
+ * packets to the same next hop join the request's queue without sending
+ * another, so there is never more than one request in flight per next
+ * hop.  Unanswered, it is retried after SR_ARPQ_RETRY_MS, the wait
+ * doubling each time up to SR_ARPQ_RETRY_MAX_MS, SR_ARPQ_MAX_TRIES times
+ * in all; after that its packets are handed to the unreachable callback,
+ * which should answer them with ICMP host unreachable, and are dropped.
+ * When the mapping is learned, sr_arpqueue_resolve sends the packets of
+ * that one request and nothing else.  sr_arpqueue_probe opens a request
+ * with no packets, to resolve a next hop before traffic needs it.
+ *
+ * Packets are packet buffers the queue holds a reference to, chained
+ * through sr_pbuf.next.  Memory is bounded by a packet and byte limit
+ * on each queue and another on all queues together; a packet over
+ * either limit is dropped on arrival.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_ARPQUEUE_H
+#define SR_ARPQUEUE_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include "sr_pbuf.h"
+#include "sr_timer.h"
+
+#define SR_ARPQ_MAX_TRIES     5
+#define SR_ARPQ_RETRY_MS      1000          /* first wait for a reply */
+#define SR_ARPQ_RETRY_MAX_MS  4000
+#define SR_ARPQ_QUEUE_PACKETS 64            /* per next hop */
+#define SR_ARPQ_QUEUE_BYTES   (64 * 1024)
+#define SR_ARPQ_TOTAL_PACKETS 1024          /* all next hops */
+#define SR_ARPQ_TOTAL_BYTES   (1024 * 1024)
+#define SR_ARPQ_MAX_PROBES    1024          /* requests open for probes */
+#define SR_ARPQ_BUCKETS       256           /* a power of two */
+
+/* ----------------------------------------------------------------------------
+ * struct sr_arpreq
+ *
+ * An outstanding ARP request and the packets waiting on its answer.
+ *
+ * -------------------------------------------------------------------------- */
+
+struct sr_arpreq
+{
+    uint32_t ip;             /* next hop, network byte order */
+    int if_index;            /* sr_if.index the request goes out of */
+    unsigned int tries;      /* requests sent */
+    unsigned int npackets;
+    unsigned int nbytes;
+    struct sr_pbuf* head;    /* frames, Ethernet header first */
+    struct sr_pbuf** tail;
+    struct sr_timer timer;   /* next retry, or giving up */
+    struct sr_arpreq* hnext; /* bucket chain */
+    struct sr_arpqueue* queue;
+};
+
+struct sr_arpqueue
+{
+    struct sr_arpreq* buckets[SR_ARPQ_BUCKETS];
+    unsigned int requests;
+    unsigned int npackets;        /* queued on all requests */
+    unsigned int nbytes;
+    struct sr_timer_wheel* wheel;
+
+    /* -- supplied by the owner, ctx is passed back to each -- */
+    void (*send)(void* ctx, const struct sr_arpreq* req);
+    void (*transmit)(void* ctx, const struct sr_arpreq* req,
+                     struct sr_pbuf* pb, const unsigned char* mac);
+    void (*unreachable)(void* ctx, const struct sr_arpreq* req,
+                        struct sr_pbuf* pb);
+    void* ctx;
+
+    unsigned long queued;
+    unsigned long coalesced;      /* queued behind a request in flight */
+    unsigned long sent;           /* released by a reply */
+    unsigned long dropped;        /* over a limit on arrival */
+    unsigned long timeouts;       /* requests given up on */
+    unsigned long failed;         /* packets of those requests */
+    unsigned long probes;         /* requests opened with no packet */
+};
+
+struct sr_arpqueue* sr_arpqueue_create(struct sr_timer_wheel* wheel,
+        void (*send)(void* ctx, const struct sr_arpreq* req),
+        void (*transmit)(void* ctx, const struct sr_arpreq* req,
+                         struct sr_pbuf* pb, const unsigned char* mac),
+        void (*unreachable)(void* ctx, const struct sr_arpreq* req,
+                            struct sr_pbuf* pb),
+        void* ctx);
+void sr_arpqueue_destroy(struct sr_arpqueue* queue);
+
+int sr_arpqueue_add(struct sr_arpqueue* queue, int if_index, uint32_t ip,
+        struct sr_pbuf* pb);
+int sr_arpqueue_probe(struct sr_arpqueue* queue, int if_index, uint32_t ip);
+unsigned int sr_arpqueue_resolve(struct sr_arpqueue* queue, int if_index,
+        uint32_t ip, const unsigned char* mac);
+void sr_arpqueue_print(struct sr_arpqueue* queue);
+
+#endif /* -- SR_ARPQUEUE_H -- */
@@ -0,0 +1,257 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_bench.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Helpers shared by the benchmark drivers, see sr_bench.h.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sr_bench.h"
+#include "sr_router.h"
+#include "sr_rt.h"
+#include "sr_rcu.h"
+#include "sr_pbuf.h"
+
+static unsigned int mix_weight[33];
+static unsigned int mix_total;
+
+uint32_t bench_rand32(void)
+{
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+} /* -- bench_rand32 -- */
+
+uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+} /* -- bench_now_ns -- */
+
+/*---------------------------------------------------------------------
+ * Method: bench_parse_mix(..)
+ *
+ * Set the prefix length mix used by bench_gen_routes.  Weights of a
+ * range are spread evenly over its lengths.  Returns -1 if spec does not
+ * parse or gives no weight at all.
+ *
+ *---------------------------------------------------------------------*/
+
+int bench_parse_mix(const char* spec)
+{
+    unsigned int weight[33];
+    unsigned int first, last, w, len, total = 0;
+    const char* p = spec;
+    char* end;
+
+    memset(weight, 0, sizeof(weight));
+    while(*p)
+    {
+        first = last = strtoul(p, &end, 10);
+        if(end == p)
+        { return -1; }
+        p = end;
+        if(*p == '-')
+        {
+            last = strtoul(++p, &end, 10);
+            if(end == p)
+            { return -1; }
+            p = end;
+        }
+        if(*p++ != ':' || first > last || last > 32)
+        { return -1; }
+        w = strtoul(p, &end, 10);
+        if(end == p)
+        { return -1; }
+        p = end;
+        for(len = first; len <= last; len++)
+        {
+            weight[len] += w * 1000 / (last - first + 1);
+            total += w * 1000 / (last - first + 1);
+        }
+        if(*p == ',')
+        { p++; }
+        else if(*p)
+        { return -1; }
+    }
+    if(total == 0)
+    { return -1; }
+
+    memcpy(mix_weight, weight, sizeof(weight));
+    mix_total = total;
+    return 0;
+} /* -- bench_parse_mix -- */
+
+static int bench_prefix_len(void)
+{
+    unsigned int r = bench_rand32() % mix_total;
+    int len;
+
+    for(len = 0; len < 32 && r >= mix_weight[len]; len++)
+    { r -= mix_weight[len]; }
+    return len;
+} /* -- bench_prefix_len -- */
+
+void bench_gen_routes(struct bench_table* t, unsigned int n)
+{
+    unsigned int i;
+
+    if(mix_total == 0)
+    { bench_parse_mix(BENCH_DEFAULT_MIX); }
+
+    t->prefix = (uint32_t*)malloc((n ? n : 1) * sizeof(uint32_t));
+    t->len    = (uint8_t*)malloc(n ? n : 1);
+    assert(t->prefix && t->len);
+    for(i = 0; i < n; i++)
+    {
+        t->len[i] = bench_prefix_len();
+        t->prefix[i] = t->len[i] ?
+            bench_rand32() & (0xffffffffU << (32 - t->len[i])) : 0;
+    }
+    t->n = n;
+} /* -- bench_gen_routes -- */
+
+/*---------------------------------------------------------------------
+ * Method: bench_gen_dsts(..)
+ *
+ * Fill dst_nbo with destinations, most of them an address inside a
+ * randomly chosen route and BENCH_MISS_PCT percent uniformly random.
+ *
+ *---------------------------------------------------------------------*/
+
+void bench_gen_dsts(const struct bench_table* t, uint32_t* dst_nbo,
+                    unsigned int n)
+{
+    unsigned int i, r;
+    uint32_t host;
+
+    for(i = 0; i < n; i++)
+    {
+        if(t->n == 0 || (unsigned int)rand() % 100 < BENCH_MISS_PCT)
+        { dst_nbo[i] = htonl(bench_rand32()); continue; }
+        r = bench_rand32() % t->n;
+        host = t->len[r] ? ~(0xffffffffU << (32 - t->len[r])) : 0xffffffffU;
+        dst_nbo[i] = htonl(t->prefix[r] | (bench_rand32() & host));
+    }
+} /* -- bench_gen_dsts -- */
+
+/* -- zero an instance and give it what the forwarding path expects -- */
+void bench_init_instance(struct sr_instance* sr)
+{
+    memset(sr, 0, sizeof(struct sr_instance));
+    sr->sockfd = -1;
+    sr->fib_mode = SR_FIB_TRIE;
+    pthread_mutex_init(&sr->fib_lock, 0);
+    sr->rcu = (struct sr_rcu*)malloc(sizeof(struct sr_rcu));
+    assert(sr->rcu);
+    sr_rcu_init(sr->rcu);
+    sr->fwd_reader = sr_rcu_register(sr->rcu);
+    sr->pbufs = sr_pbuf_pool_create(0);
+    assert(sr->pbufs);
+} /* -- bench_init_instance -- */
+
+/* -- gateway behind interface if_index, 10.<index>.0.2 -- */
+uint32_t bench_gateway(unsigned int if_index)
+{
+    return htonl(0x0a000002 | (if_index & 0xff) << 16);
+} /* -- bench_gateway -- */
+
+/*---------------------------------------------------------------------
+ * Method: bench_publish(..)
+ *
+ * Publish the routes of t as sr's table using lookup structure mode.
+ * Route i leaves through interface eth<i % nifs> to bench_gateway.
+ *
+ *---------------------------------------------------------------------*/
+
+void bench_publish(struct sr_instance* sr, const struct bench_table* t,
+                   uint8_t mode, unsigned int nifs)
+{
+    struct sr_fib* fib;
+    struct sr_nexthop nh;
+    struct in_addr dest, mask, gw;
+    char name[SR_IFACE_NAMELEN];
+    unsigned int i, ifi;
+
+    sr_rt_write_lock(sr);
+    sr->fib_mode = mode;
+    fib = sr_fib_create(mode);
+    for(i = 0; i < t->n; i++)
+    {
+        ifi = i % nifs;
+        dest.s_addr = htonl(t->prefix[i]);
+        mask.s_addr = t->len[i] ? htonl(0xffffffffU << (32 - t->len[i])) : 0;
+        gw.s_addr   = bench_gateway(ifi);
+        snprintf(name, sizeof(name), "eth%u", ifi);
+        sr_nexthop_init(&nh, gw, name, ifi);
+        sr_fib_set(fib, dest, mask, &nh, 1, SR_RT_STATIC);
+    }
+    sr_rt_publish(sr, fib);
+    sr_rt_write_unlock(sr);
+} /* -- bench_publish -- */
+
+/* -- smallest time between two back to back clock reads -- */
+uint64_t bench_timer_overhead(void)
+{
+    uint64_t best = ~0ULL, t0, t1;
+    int i;
+
+    for(i = 0; i < 1000; i++)
+    {
+        t0 = bench_now_ns();
+        t1 = bench_now_ns();
+        if(t1 - t0 < best)
+        { best = t1 - t0; }
+    }
+    return best;
+} /* -- bench_timer_overhead -- */
+
+static int bench_lat_cmp(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+
+    return x < y ? -1 : x > y;
+} /* -- bench_lat_cmp -- */
+
+/*---------------------------------------------------------------------
+ * Method: bench_report(..)
+ *
+ * Print throughput and latency percentiles for n timed samples, each
+ * covering per_sample operations of the named unit.  Throughput counts
+ * only the timed work.  Sorts lat_ns.
+ *
+ *---------------------------------------------------------------------*/
+
+void bench_report(const char* label, const char* unit, uint32_t* lat_ns,
+                  unsigned int n, unsigned int per_sample)
+{
+    uint64_t sum = 0;
+    double ops, ns;
+    unsigned int i;
+
+    if(n == 0)
+    { return; }
+    for(i = 0; i < n; i++)
+    { sum += lat_ns[i]; }
+    qsort(lat_ns, n, sizeof(uint32_t), bench_lat_cmp);
+
+    ops = (double)n * per_sample;
+    ns  = sum ? sum / ops : 0;
+    printf("  %-10s %8.3f M%s/s %8.1f ns/%s   p50 %u p90 %u p99 %u "
+           "p99.9 %u max %u ns\n", label, ns ? 1e3 / ns : 0, unit, ns, unit,
+           lat_ns[n / 2], lat_ns[(uint64_t)n * 90 / 100],
+           lat_ns[(uint64_t)n * 99 / 100], lat_ns[(uint64_t)n * 999 / 1000],
+           lat_ns[n - 1]);
+} /* -- bench_report -- */
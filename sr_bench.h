@@ -0,0 +1,59 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_bench.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Helpers shared by the benchmark drivers built with "make bench":
+ * synthetic routing tables, a router instance that needs no VNS server,
+ * and latency reporting.
+ *
+ * Tables are drawn from a prefix length mix given as comma separated
+ * "len:weight" or "first-last:weight" terms, e.g. "16:10,24:90".
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_BENCH_H
+#define SR_BENCH_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+struct sr_instance;
+
+/* -- roughly the shape of an Internet backbone table -- */
+#define BENCH_DEFAULT_MIX "8-15:2,16:8,17-21:15,22:10,23:10,24:50,25-32:5"
+
+/* -- destinations that miss every route, in percent -- */
+#define BENCH_MISS_PCT 10
+
+struct bench_table
+{
+    uint32_t* prefix;   /* host byte order, masked */
+    uint8_t*  len;
+    unsigned int n;
+};
+
+uint32_t bench_rand32(void);
+uint64_t bench_now_ns(void);
+
+int  bench_parse_mix(const char* spec);
+void bench_gen_routes(struct bench_table* t, unsigned int n);
+void bench_gen_dsts(const struct bench_table* t, uint32_t* dst_nbo,
+                    unsigned int n);
+
+void bench_init_instance(struct sr_instance* sr);
+void bench_publish(struct sr_instance* sr, const struct bench_table* t,
+                   uint8_t mode, unsigned int nifs);
+uint32_t bench_gateway(unsigned int if_index);
+
+uint64_t bench_timer_overhead(void);
+void bench_report(const char* label, const char* unit, uint32_t* lat_ns,
+                  unsigned int n, unsigned int per_sample);
+
+#endif /* -- SR_BENCH_H -- */
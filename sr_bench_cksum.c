@@ -0,0 +1,378 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_bench_cksum.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * IP checksum microbenchmark.  Draws random IP headers, with and
+ * without options, and first checks them differentially: sr_cksum
+ * against a by the book RFC 1071 checksum, over every header and over
+ * random odd and even lengths of random bytes, and the incremental TTL
+ * update against decrementing the TTL and recomputing the checksum.
+ * Then times verifying and forwarding a header the way the router used
+ * to (a 16 bit loop, then zeroing and recomputing the checksum) and the
+ * way it does now (sr_cksum, then sr_ip_dec_ttl).
+ *
+ * The buffer checks are repeated for every checksum kernel the CPU has,
+ * and each kernel is timed over buffers the size of an echo request, a
+ * full Ethernet frame and a jumbo frame, in bytes per second.
+ *
+ * Built with "make bench".
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sr_bench.h"
+#include "sr_protocol.h"
+#include "sr_cksum.h"
+
+#define BENCH_HEADERS   (1U << 16)
+#define BENCH_ROUNDS    64
+#define BENCH_BATCH     64          /* headers per timed sample */
+#define BENCH_SLOT      64          /* bytes per header, 60 at most */
+#define BENCH_OPT_PCT   10          /* headers with options, in percent */
+#define BENCH_RAW_TESTS (1U << 20)
+#define BENCH_LONG_TESTS (1U << 12) /* buffers up to BENCH_LONG_MAX */
+#define BENCH_LONG_MAX  9216
+#define BENCH_BW_BATCH  64          /* buffers per timed sample */
+#define BENCH_BW_SAMPLES 4096
+
+static const char* kernels[] = { "avx2", "sse2", "scalar" };
+static const unsigned int bw_sizes[] = { 64, 576, 1500, 9000 };
+
+static uint8_t* hdrs;               /* as drawn */
+static uint8_t* work;               /* what each timed round changes */
+static unsigned int nhdrs;
+static uint32_t* lat;
+static volatile uint32_t sink;      /* keeps results from being dropped */
+
+static void usage(char* argv0)
+{
+    printf("IP checksum benchmark\n");
+    printf("Format: %s [-h] [-n headers] [-r rounds] [-s seed]\n", argv0);
+    printf("   defaults headers=%u rounds=%u\n", BENCH_HEADERS, BENCH_ROUNDS);
+} /* -- usage -- */
+
+/* -- RFC 1071 as written: 16 bit words in host order, carries folded -- */
+static uint16_t bench_ref_cksum(const uint8_t* p, unsigned int len)
+{
+    uint32_t sum = 0;
+    unsigned int i;
+
+    for(i = 0; i + 1 < len; i += 2)
+    { sum += (uint32_t)p[i] << 8 | p[i + 1]; }
+    if(len & 1)
+    { sum += (uint32_t)p[len - 1] << 8; }
+    while(sum >> 16)
+    { sum = (sum & 0xffff) + (sum >> 16); }
+    return htons((uint16_t)~sum);
+} /* -- bench_ref_cksum -- */
+
+/* -- processIP's check before sr_cksum, 1 if the header passes -- */
+static int bench_old_verify(const uint8_t* ip)
+{
+    uint32_t check = 0;
+    int i, byte_num = (((const struct ip*)ip)->ip_hl) * 2;
+
+    for(i = 0; i < byte_num; i++)
+    { check += ntohs(*(const uint16_t*)(ip + i * 2)); }
+    check = (check & 0xffff) + (check >> 16);
+    return check == 0xffff;
+} /* -- bench_old_verify -- */
+
+/* -- calculate_checksum before sr_cksum, length in 32 bit words -- */
+static uint16_t bench_old_cksum(uint8_t* start, unsigned long length)
+{
+    uint16_t* temp;
+    uint32_t check = 0;
+    int i = 0, byte_num = length * 2;
+
+    for(i = 0; i < byte_num; i++)
+    { check += ntohs(*(uint16_t*)(start + i * 2)); }
+    check = (check & 0xffff) + (check >> 16);
+    temp = (uint16_t*)(&check);
+    *temp = htons(*temp);
+    *temp = (*temp) ^ 0xffff;
+    return *temp;
+} /* -- bench_old_cksum -- */
+
+/*---------------------------------------------------------------------
+ * Method: bench_gen_headers(..)
+ *
+ * Random IPv4 headers with a TTL of at least 2, so they can be
+ * forwarded, and a correct checksum.  BENCH_OPT_PCT percent of them
+ * carry 4 to 40 bytes of random options.
+ *
+ *---------------------------------------------------------------------*/
+
+static void bench_gen_headers(void)
+{
+    struct ip* ip;
+    unsigned int i, j, hl;
+
+    for(i = 0; i < nhdrs; i++)
+    {
+        ip = (struct ip*)(hdrs + i * BENCH_SLOT);
+        hl = (unsigned int)rand() % 100 < BENCH_OPT_PCT ?
+            6 + (unsigned int)rand() % 10 : 5;
+        for(j = 0; j < BENCH_SLOT; j += 4)
+        {
+            uint32_t r = bench_rand32();
+            memcpy((uint8_t*)ip + j, &r, 4);
+        }
+        ip->ip_v = 4;
+        ip->ip_hl = hl;
+        ip->ip_ttl = 2 + (unsigned int)rand() % 254;
+        ip->ip_sum = 0;
+        ip->ip_sum = bench_ref_cksum((uint8_t*)ip, hl * 4);
+    }
+} /* -- bench_gen_headers -- */
+
+/*---------------------------------------------------------------------
+ * Method: bench_verify(..)
+ *
+ * Differential checks, see the top of the file.  Returns the number of
+ * disagreements, and counts in old_bad the headers the old checksum
+ * routine got wrong, for the record.
+ *
+ *---------------------------------------------------------------------*/
+
+static unsigned int bench_verify(unsigned int* old_bad)
+{
+    uint8_t a[BENCH_SLOT], b[BENCH_SLOT];
+    struct ip *ia = (struct ip*)a, *ib = (struct ip*)b;
+    unsigned int i, hl, bad = 0;
+
+    *old_bad = 0;
+    for(i = 0; i < nhdrs; i++)
+    {
+        memcpy(a, hdrs + i * BENCH_SLOT, BENCH_SLOT);
+        hl = ia->ip_hl * 4;
+
+        /* -- an intact header sums to 0, a damaged one does not -- */
+        if(sr_cksum(a, hl) != 0 || !bench_old_verify(a))
+        { bad++; }
+        a[bench_rand32() % hl] ^= 1 << (bench_rand32() % 8);
+        if(sr_cksum(a, hl) == 0 || sr_cksum(a, hl) != bench_ref_cksum(a, hl))
+        { bad++; }
+        memcpy(a, hdrs + i * BENCH_SLOT, BENCH_SLOT);
+
+        /* -- incremental against recomputed, down to a TTL of 0 -- */
+        memcpy(b, a, BENCH_SLOT);
+        while(ia->ip_ttl)
+        {
+            sr_ip_dec_ttl(ia);
+            ib->ip_ttl--;
+            ib->ip_sum = 0;
+            ib->ip_sum = bench_ref_cksum(b, hl);
+            if(memcmp(a, b, hl) != 0)
+            {
+                bad++;
+                memcpy(a, b, BENCH_SLOT);
+            }
+            ib->ip_sum = 0;
+            if(bench_old_cksum(b, ia->ip_hl) != ia->ip_sum)
+            { (*old_bad)++; }
+            ib->ip_sum = ia->ip_sum;
+        }
+    }
+
+    return bad;
+} /* -- bench_verify -- */
+
+/* -- tests random buffers of up to max bytes, at any alignment -- */
+static unsigned int bench_verify_raw(unsigned int tests, unsigned int max)
+{
+    static uint8_t raw[BENCH_LONG_MAX + 8];
+    unsigned int i, j, k, len, bad = 0;
+
+    for(i = 0; i < tests; i++)
+    {
+        len = bench_rand32() % max;
+        j = bench_rand32() % 8;
+        for(k = 0; k < len; k++)
+        { raw[j + k] = (uint8_t)bench_rand32(); }
+        if(i & 1)
+        { memset(raw + j, 0xff, len); }
+        if(sr_cksum(raw + j, len) != bench_ref_cksum(raw + j, len))
+        { bad++; }
+    }
+    return bad;
+} /* -- bench_verify_raw -- */
+
+/* -- time the current kernel over buffers of size bytes -- */
+static void bench_bandwidth(const char* kernel, unsigned int size)
+{
+    static uint8_t buf[BENCH_LONG_MAX * 2];
+    unsigned int i, j, off = 0;
+    char label[32];
+    uint64_t t0;
+
+    for(i = 0; i < sizeof(buf); i++)
+    { buf[i] = (uint8_t)bench_rand32(); }
+    for(i = 0; i < BENCH_BW_SAMPLES; i++)
+    {
+        t0 = bench_now_ns();
+        for(j = 0; j < BENCH_BW_BATCH; j++)
+        {
+            sink += sr_cksum(buf + off, size);
+            off = (off + size + 2) % (sizeof(buf) - size);
+        }
+        lat[i] = bench_now_ns() - t0;
+    }
+    snprintf(label, sizeof(label), "%s %u", kernel, size);
+    bench_report(label, "B", lat, BENCH_BW_SAMPLES, BENCH_BW_BATCH * size);
+} /* -- bench_bandwidth -- */
+
+/*---------------------------------------------------------------------
+ * Method: bench_run(..)
+ *
+ * Time rounds passes over the headers, BENCH_BATCH headers a sample:
+ * verifying them only, or verifying and forwarding them, the old way
+ * or the new.  Each round starts from the headers as drawn.
+ *
+ *---------------------------------------------------------------------*/
+
+static void bench_run(const char* label, int forward, int old,
+                      unsigned int rounds)
+{
+    unsigned int r, i, j, n = 0;
+    uint32_t pass = 0;
+    struct ip* ip;
+    uint8_t* p;
+    uint64_t t0;
+
+    for(r = 0; r < rounds; r++)
+    {
+        memcpy(work, hdrs, nhdrs * BENCH_SLOT);
+        for(i = 0; i + BENCH_BATCH <= nhdrs; i += BENCH_BATCH)
+        {
+            t0 = bench_now_ns();
+            for(j = i; j < i + BENCH_BATCH; j++)
+            {
+                p = work + j * BENCH_SLOT;
+                ip = (struct ip*)p;
+                if(old)
+                {
+                    if(!bench_old_verify(p))
+                    { continue; }
+                    pass++;
+                    if(forward)
+                    {
+                        ip->ip_ttl--;
+                        ip->ip_sum = 0;
+                        ip->ip_sum = bench_old_cksum(p, ip->ip_hl);
+                    }
+                }
+                else
+                {
+                    if(sr_cksum(p, ip->ip_hl * 4) != 0)
+                    { continue; }
+                    pass++;
+                    if(forward)
+                    { sr_ip_dec_ttl(ip); }
+                }
+            }
+            lat[n++] = bench_now_ns() - t0;
+        }
+    }
+    sink += pass;
+    if(pass != (uint64_t)n * BENCH_BATCH)
+    { fprintf(stderr, "%s: %u headers failed the check\n", label,
+              n * BENCH_BATCH - pass); }
+    bench_report(label, "pkt", lat, n, BENCH_BATCH);
+} /* -- bench_run -- */
+
+int main(int argc, char** argv)
+{
+    unsigned int rounds = BENCH_ROUNDS;
+    unsigned int seed = 1;
+    unsigned int bad, old_bad, i, k;
+    const char* best = sr_cksum_kernel();
+    int c;
+
+    nhdrs = BENCH_HEADERS;
+    while((c = getopt(argc, argv, "hn:r:s:")) != EOF)
+    {
+        switch(c)
+        {
+            case 'h':
+                usage(argv[0]);
+                exit(0);
+            case 'n':
+                nhdrs = atoi(optarg);
+                break;
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            case 's':
+                seed = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+    if(nhdrs < BENCH_BATCH || rounds == 0)
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    srand(seed);
+    hdrs = (uint8_t*)malloc(nhdrs * BENCH_SLOT);
+    work = (uint8_t*)malloc(nhdrs * BENCH_SLOT);
+    lat  = (uint32_t*)malloc(((uint64_t)rounds * (nhdrs / BENCH_BATCH) +
+                              BENCH_BW_SAMPLES) * sizeof(uint32_t));
+    assert(hdrs && work && lat);
+    bench_gen_headers();
+
+    printf("%u headers, %u%% with options, %u rounds, checksum kernel %s, "
+           "timer overhead %lu ns\n", nhdrs, BENCH_OPT_PCT, rounds,
+           sr_cksum_kernel(), (unsigned long)bench_timer_overhead());
+
+    if((bad = bench_verify(&old_bad)) != 0)
+    {
+        fprintf(stderr, "%u checksums differ from the reference\n", bad);
+        exit(1);
+    }
+    printf("  sr_cksum and the TTL update agree with RFC 1071; the old "
+           "routine got %u of the updated headers wrong\n", old_bad);
+
+    for(k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+    {
+        if(sr_cksum_use(kernels[k]) != 0)
+        {
+            printf("  %s: not supported here\n", kernels[k]);
+            continue;
+        }
+        bad = bench_verify_raw(BENCH_RAW_TESTS, 200) +
+              bench_verify_raw(BENCH_LONG_TESTS, BENCH_LONG_MAX);
+        if(bad != 0)
+        {
+            fprintf(stderr, "%s: %u checksums differ from the reference\n",
+                    kernels[k], bad);
+            exit(1);
+        }
+        for(i = 0; i < sizeof(bw_sizes) / sizeof(bw_sizes[0]); i++)
+        { bench_bandwidth(kernels[k], bw_sizes[i]); }
+    }
+
+    sr_cksum_use(best);
+
+    bench_run("verify old", 0, 1, rounds);
+    bench_run("verify new", 0, 0, rounds);
+    bench_run("fwd old", 1, 1, rounds);
+    bench_run("fwd new", 1, 0, rounds);
+
+    return 0;
+} /* -- main -- */
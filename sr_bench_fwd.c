@@ -0,0 +1,484 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_bench_fwd.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Forwarding benchmark.  Runs the router against a synthetic table with
+ * no VNS server: sr_send_packet is replaced by an in-memory sink that
+ * frames the packet the way sr_vns_comm.c does but never writes it.
+ *
+ * Two passes are timed packet by packet.  "resolve" is the route lookup
+ * half of processIP (longest prefix match, next hop selection, ARP
+ * lookup), "forward" is the whole of sr_handlepacket from a received
+ * frame to the send.  Every gateway is in the ARP cache, so each packet
+ * is forwarded at once.
+ *
+ * With -w, a third pass runs the same frames through forwarding workers
+ * the way the server read loop does, and reports the rate of the whole
+ * pipeline.  Each frame carries its number, and the sink checks that
+ * frames that went through the same worker come out in order; the run
+ * fails if any did not.
+ *
+ * The bench's frames are UDP.  Anything else the router sends, such as
+ * ICMP errors about frames that had no route, is counted apart from the
+ * packets forwarded.
+ *
+ * Built with "make bench".
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sr_bench.h"
+#include "sr_router.h"
+#include "sr_if.h"
+#include "sr_rt.h"
+#include "sr_rcu.h"
+#include "sr_arpcache.h"
+#include "sr_worker.h"
+#include "sr_protocol.h"
+#include "vnscommand.h"
+
+#define BENCH_ROUTES   200000
+#define BENCH_PACKETS  (1U << 20)
+#define BENCH_IFS      4
+#define BENCH_SOURCES  64
+#define BENCH_PKT_LEN  64
+#define BENCH_MAX_LEN  1514
+#define BENCH_SEQ_OFF  (sizeof(struct sr_ethernet_hdr) + sizeof(struct ip) + 8)
+#define BENCH_ORDER_BUCKETS 4096      /* per worker */
+
+static struct sr_instance sr;
+static struct bench_table table;
+static uint8_t* frames;           /* npackets templates of pkt_len bytes */
+static uint32_t* lat;
+static unsigned int npackets;
+static unsigned int pkt_len = BENCH_PKT_LEN;
+static unsigned int nsources = BENCH_SOURCES;
+
+/* -- what the fake send has seen -- */
+static uint8_t sink[sizeof(c_packet_header) + BENCH_MAX_LEN];
+static unsigned long tx_packets;
+static unsigned long tx_bytes;
+static unsigned long tx_other;     /* not a forwarded bench frame */
+
+/* -- last frame number sent per flow bucket, while checking order -- */
+static uint32_t* order_last;
+static unsigned int order_buckets;
+static unsigned long order_errors;
+
+static void usage(char* argv0)
+{
+    printf("Forwarding benchmark\n");
+    printf("Format: %s [-h] [-n routes] [-p packets] [-b frame bytes]\n",
+           argv0);
+    printf("           [-i interfaces] [-S source hosts] [-s seed]\n");
+    printf("           [-m prefix length mix, len[-len]:weight,...]\n");
+    printf("           [-F list|trie|dir248 route lookup structure]\n");
+    printf("           [-w forwarding worker threads]\n");
+    printf("   defaults routes=%u packets=%u bytes=%u interfaces=%u "
+           "sources=%u trie\n", BENCH_ROUTES, BENCH_PACKETS, BENCH_PKT_LEN,
+           BENCH_IFS, BENCH_SOURCES);
+    printf("   mix=%s\n", BENCH_DEFAULT_MIX);
+} /* -- usage -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_send_packet_if(..)
+ *
+ * Stands in for the one in sr_vns_comm.c: frames the packet for the
+ * server into a static buffer and counts it, as forwarded if it is one
+ * of the bench's UDP frames.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_send_packet_if(struct sr_instance* sr, uint8_t* buf, unsigned int len,
+                      struct sr_if* iface)
+{
+    c_packet_header* sr_pkt = (c_packet_header*)sink;
+
+    assert(sr);
+    assert(buf);
+    assert(iface);
+    if(len < sizeof(struct sr_ethernet_hdr) || len > BENCH_MAX_LEN)
+    { return -1; }
+
+    sr_pkt->mLen  = htonl(len + sizeof(c_packet_header));
+    sr_pkt->mType = htonl(VNSPACKET);
+    strncpy(sr_pkt->mInterfaceName, iface->name, 16);
+    memcpy(sink + sizeof(c_packet_header), buf, len);
+
+    /* -- ICMP errors, ARP requests: the router's own, with no number -- */
+    if(len < sizeof(struct sr_ethernet_hdr) + sizeof(struct ip) ||
+       ((struct sr_ethernet_hdr*)buf)->ether_type != htons(ETHERTYPE_IP) ||
+       ((struct ip*)(buf + sizeof(struct sr_ethernet_hdr)))->ip_p != IPPROTO_UDP)
+    {
+        tx_other++;
+        return 0;
+    }
+
+    /* -- buckets split along workers, so each sees one worker's frames -- */
+    if(order_last && len >= BENCH_SEQ_OFF + 4)
+    {
+        uint32_t seq, b;
+
+        memcpy(&seq, buf + BENCH_SEQ_OFF, 4);
+        b = flow_hash((struct ip*)(buf + sizeof(struct sr_ethernet_hdr)),
+                      len - sizeof(struct sr_ethernet_hdr)) % order_buckets;
+        if(seq + 1 <= order_last[b])
+        { order_errors++; }
+        order_last[b] = seq + 1;
+    }
+
+    tx_packets++;
+    tx_bytes += len;
+    return 0;
+} /* -- sr_send_packet_if -- */
+
+int sr_send_packet(struct sr_instance* sr, uint8_t* buf, unsigned int len,
+                   const char* iface)
+{
+    struct sr_if* if_rec = sr_get_interface(sr, iface);
+
+    return if_rec ? sr_send_packet_if(sr, buf, len, if_rec) : -1;
+} /* -- sr_send_packet -- */
+
+int sr_send_packet_nocopy(struct sr_instance* sr, uint8_t* buf,
+                          unsigned int len, struct sr_if* iface)
+{
+    return sr_send_packet_if(sr, buf, len, iface);
+} /* -- sr_send_packet_nocopy -- */
+
+int sr_send_flush(struct sr_instance* sr)
+{
+    return 0;
+} /* -- sr_send_flush -- */
+
+/* -- mac of interface i (role 0) or of the gateway behind it (role 1) -- */
+static void bench_mac(unsigned char* mac, unsigned int role, unsigned int i)
+{
+    mac[0] = 0x02;
+    mac[1] = 0;
+    mac[2] = 0;
+    mac[3] = 0;
+    mac[4] = role;
+    mac[5] = i;
+} /* -- bench_mac -- */
+
+/*---------------------------------------------------------------------
+ * Method: bench_topology(..)
+ *
+ * Interfaces eth0.. with 10.<i>.0.1/16, each with its gateway in the
+ * ARP cache.  Called again before each pass to confirm the gateways
+ * again.
+ *
+ *---------------------------------------------------------------------*/
+
+static void bench_topology(unsigned int nifs)
+{
+    unsigned char mac[ETHER_ADDR_LEN];
+    char name[SR_IFACE_NAMELEN];
+    unsigned int i;
+
+    for(i = 0; i < nifs; i++)
+    {
+        if(sr.if_count < (int)nifs)
+        {
+            snprintf(name, sizeof(name), "eth%u", i);
+            sr_add_interface(&sr, name);
+            bench_mac(mac, 0, i);
+            sr_set_ether_addr(&sr, mac);
+            sr_set_ether_ip(&sr, htonl(0x0a000001 | i << 16));
+            sr_set_ether_mask(&sr, htonl(0xffff0000));
+        }
+        bench_mac(mac, 1, i);
+        arp_cache_update(&sr, sr.if_array[i], mac, bench_gateway(i));
+    }
+} /* -- bench_topology -- */
+
+/*---------------------------------------------------------------------
+ * Method: bench_frames(..)
+ *
+ * Build npackets UDP frames arriving on eth0 from one of nsources hosts
+ * on its subnet, to destinations drawn from the table.
+ *
+ *---------------------------------------------------------------------*/
+
+static void bench_frames(void)
+{
+    struct sr_ethernet_hdr* eth;
+    struct ip* ips;
+    uint16_t* udp;
+    uint32_t* dsts;
+    uint8_t* f;
+    unsigned int i, src;
+
+    frames = (uint8_t*)calloc(npackets, pkt_len);
+    dsts   = (uint32_t*)malloc(npackets * sizeof(uint32_t));
+    assert(frames && dsts);
+    bench_gen_dsts(&table, dsts, npackets);
+
+    for(i = 0; i < npackets; i++)
+    {
+        f = frames + (size_t)i * pkt_len;
+        src = rand() % nsources;
+
+        eth = (struct sr_ethernet_hdr*)f;
+        bench_mac(eth->ether_dhost, 0, 0);
+        bench_mac(eth->ether_shost, 2, src);
+        eth->ether_shost[3] = src >> 8;
+        eth->ether_type = htons(ETHERTYPE_IP);
+
+        ips = (struct ip*)(f + sizeof(struct sr_ethernet_hdr));
+        ips->ip_v   = 4;
+        ips->ip_hl  = 5;
+        ips->ip_len = htons(pkt_len - sizeof(struct sr_ethernet_hdr));
+        ips->ip_ttl = 64;
+        ips->ip_p   = IPPROTO_UDP;
+        ips->ip_src.s_addr = htonl(0x0a000100 + src);
+        ips->ip_dst.s_addr = dsts[i];
+        ips->ip_sum = calculate_checksum((uint8_t*)ips, ips->ip_hl);
+
+        udp = (uint16_t*)(ips + 1);
+        udp[0] = htons(1024 + rand() % 60000);
+        udp[1] = htons(53);
+        udp[2] = htons(pkt_len - sizeof(struct sr_ethernet_hdr) -
+                       sizeof(struct ip));
+        if(pkt_len >= BENCH_SEQ_OFF + 4)
+        { memcpy(f + BENCH_SEQ_OFF, &i, 4); }
+    }
+    free(dsts);
+} /* -- bench_frames -- */
+
+/* -- the route lookup part of processIP, returns the egress or 0 -- */
+static struct sr_if* bench_resolve(uint8_t* frame)
+{
+    struct ip* ips = (struct ip*)(frame + sizeof(struct sr_ethernet_hdr));
+    const struct sr_nexthop* nh;
+    struct sr_rt* rt;
+    struct sr_if* ifs;
+    uint32_t next;
+
+    if((rt = sr_rt_lookup(&sr, ips->ip_dst.s_addr)) == 0)
+    { return 0; }
+    nh = sr_rt_select(rt, flow_hash(ips, pkt_len -
+                                    sizeof(struct sr_ethernet_hdr)));
+    if((ifs = sr_get_interface_by_index(&sr, nh->if_index)) == 0)
+    { return 0; }
+    if(nh->gw.s_addr == 0)
+    {
+        next = ips->ip_dst.s_addr;
+        return sr_arpcache_lookup(sr.arp_cache, ifs->index, next) ? ifs : 0;
+    }
+    return sr_arpcache_lookup_hint(sr.arp_cache, ifs->index, nh->gw.s_addr,
+            sr_rt_adj(rt, nh)) ? ifs : 0;
+} /* -- bench_resolve -- */
+
+static void bench_pass_resolve(void)
+{
+    unsigned int i, hits = 0;
+    uint64_t t0;
+
+    for(i = 0; i < npackets; i++)
+    {
+        t0 = bench_now_ns();
+        sr_rcu_read_lock(sr.rcu, sr.fwd_reader);
+        hits += bench_resolve(frames + (size_t)i * pkt_len) != 0;
+        sr_rcu_read_unlock(sr.fwd_reader);
+        lat[i] = bench_now_ns() - t0;
+    }
+    bench_report("resolve", "pkt", lat, npackets, 1);
+    printf("  %u of %u packets resolved to a next hop\n", hits, npackets);
+} /* -- bench_pass_resolve -- */
+
+static void bench_pass_forward(int report)
+{
+    uint8_t buf[BENCH_MAX_LEN];
+    unsigned long sent = tx_packets, other = tx_other;
+    unsigned int i;
+    uint64_t t0;
+
+    for(i = 0; i < npackets; i++)
+    {
+        memcpy(buf, frames + (size_t)i * pkt_len, pkt_len);
+        t0 = bench_now_ns();
+        sr_handlepacket(&sr, buf, pkt_len, sr.if_array[0]);
+        lat[i] = bench_now_ns() - t0;
+    }
+    if(report)
+    {
+        bench_report("forward", "pkt", lat, npackets, 1);
+        printf("  %lu of %u packets sent, %lu other frames\n",
+               tx_packets - sent, npackets, tx_other - other);
+    }
+} /* -- bench_pass_forward -- */
+
+/*---------------------------------------------------------------------
+ * Method: bench_pass_workers(..)
+ *
+ * Hand every frame to the workers as the server read loop does, sending
+ * what comes back after every BENCH_WORKER_BURST frames, and time it all
+ * until the last frame is back.  No more than BENCH_WORKER_WINDOW frames
+ * are out at once, so the rings never fill and this measures what the
+ * pipeline keeps up with rather than how fast frames can be dropped.
+ *
+ *---------------------------------------------------------------------*/
+
+#define BENCH_WORKER_BURST  64
+#define BENCH_WORKER_WINDOW (SR_WORKER_RING / 2)
+
+static void bench_pass_workers(void)
+{
+    struct sr_workers* ws = sr.workers;
+    unsigned long sent = tx_packets, other = tx_other, dropped = 0;
+    unsigned int i;
+    uint64_t t0, t;
+
+    order_buckets = ws->n * BENCH_ORDER_BUCKETS;
+    order_last = (uint32_t*)calloc(order_buckets, sizeof(uint32_t));
+    assert(order_last);
+
+    t0 = bench_now_ns();
+    for(i = 0; i < npackets; i++)
+    {
+        sr_dispatchpacket(&sr, frames + (size_t)i * pkt_len, pkt_len,
+                          sr.if_array[0]);
+        if(i % BENCH_WORKER_BURST == BENCH_WORKER_BURST - 1)
+        { sr_workers_drain(ws); }
+        while(ws->dispatched - ws->drained >= BENCH_WORKER_WINDOW)
+        {
+            if(sr_workers_drain(ws) == 0)
+            { sched_yield(); }
+        }
+    }
+    while(ws->drained < ws->dispatched)
+    {
+        if(sr_workers_drain(ws) == 0)
+        { sched_yield(); }
+    }
+    t = bench_now_ns() - t0;
+    dropped = npackets - ws->dispatched;
+
+    printf("  %-10s %8.3f Mpkt/s %8.1f ns/pkt   %u workers, %lu of %u "
+           "packets sent, %lu other frames, %lu dropped, %lu out of order\n",
+           "workers", (tx_packets - sent) * 1e3 / t,
+           (double)t / (tx_packets - sent), ws->n, tx_packets - sent, npackets,
+           tx_other - other, dropped, order_errors);
+    sr_workers_print(ws);
+    free(order_last);
+    order_last = 0;
+} /* -- bench_pass_workers -- */
+
+int main(int argc, char** argv)
+{
+    unsigned int routes = BENCH_ROUTES;
+    unsigned int nifs = BENCH_IFS;
+    unsigned int seed = 1;
+    unsigned int nworkers = 0;
+    int mode = SR_FIB_TRIE;
+    int c;
+
+    npackets = BENCH_PACKETS;
+    while((c = getopt(argc, argv, "hn:p:b:i:S:s:m:F:w:")) != EOF)
+    {
+        switch(c)
+        {
+            case 'h':
+                usage(argv[0]);
+                exit(0);
+            case 'n':
+                routes = atoi(optarg);
+                break;
+            case 'p':
+                npackets = atoi(optarg);
+                break;
+            case 'b':
+                pkt_len = atoi(optarg);
+                break;
+            case 'i':
+                nifs = atoi(optarg);
+                break;
+            case 'S':
+                nsources = atoi(optarg);
+                break;
+            case 's':
+                seed = atoi(optarg);
+                break;
+            case 'w':
+                nworkers = atoi(optarg);
+                break;
+            case 'm':
+                if(bench_parse_mix(optarg) < 0)
+                {
+                    usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'F':
+                if((mode = sr_rt_parse_fib_mode(optarg)) < 0)
+                {
+                    usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+    if(npackets == 0 || nifs == 0 || nifs > 64 ||
+       nsources == 0 || nsources > 65000 || pkt_len > BENCH_MAX_LEN ||
+       nworkers > SR_WORKER_MAX ||
+       pkt_len < sizeof(struct sr_ethernet_hdr) + sizeof(struct ip) + 8)
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    bench_init_instance(&sr);
+    sr.nworkers = nworkers;
+    sr_init(&sr);
+    srand(seed);
+    bench_gen_routes(&table, routes);
+    bench_topology(nifs);
+    bench_publish(&sr, &table, mode, nifs);
+    sr_rt_print_index_stats(&sr);
+
+    lat = (uint32_t*)malloc(npackets * sizeof(uint32_t));
+    assert(lat);
+    bench_frames();
+
+    printf("%u routes, %u packets of %u bytes, %u interfaces, "
+           "timer overhead %lu ns\n", routes, npackets, pkt_len, nifs,
+           (unsigned long)bench_timer_overhead());
+
+    /* -- first pass only warms up the caches -- */
+    bench_pass_forward(0);
+
+    bench_topology(nifs);
+    bench_pass_resolve();
+    bench_topology(nifs);
+    bench_pass_forward(1);
+    if(sr.workers)
+    {
+        bench_topology(nifs);
+        bench_pass_workers();
+    }
+
+    if(order_errors)
+    {
+        fprintf(stderr, "%lu frames left a worker out of order\n",
+                order_errors);
+        return 1;
+    }
+    return 0;
+} /* -- main -- */
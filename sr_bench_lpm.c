@@ -0,0 +1,201 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_bench_lpm.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Route lookup microbenchmark.  Builds a synthetic table, checks that
+ * the batched lookup agrees with the single one, and reports the rate
+ * and per call latency of sr_rt_lookup and of sr_rt_lookup_batch at
+ * several batch sizes.
+ *
+ * Built with "make bench".
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sr_bench.h"
+#include "sr_router.h"
+#include "sr_rt.h"
+#include "sr_rcu.h"
+
+#define BENCH_ROUTES  200000
+#define BENCH_LOOKUPS (1U << 22)
+#define BENCH_DSTS    (1U << 20)  /* destinations cycled through */
+#define BENCH_MAX_BATCH 64
+
+static const unsigned int bench_batch[] = { 1, 8, 32, 64 };
+
+static struct sr_instance sr;
+static struct bench_table table;
+static uint32_t* dsts;
+static uint32_t* lat;
+
+static void usage(char* argv0)
+{
+    printf("Route lookup benchmark\n");
+    printf("Format: %s [-h] [-n routes] [-l lookups] [-s seed]\n", argv0);
+    printf("           [-m prefix length mix, len[-len]:weight,...]\n");
+    printf("           [-F list|trie|dir248 run only this structure]\n");
+    printf("   defaults routes=%u lookups=%u, trie and dir248\n",
+           BENCH_ROUTES, BENCH_LOOKUPS);
+    printf("   mix=%s\n", BENCH_DEFAULT_MIX);
+} /* -- usage -- */
+
+/* -- number of destinations on which the batch and single lookups differ -- */
+static unsigned int bench_verify(void)
+{
+    struct sr_rt* out[BENCH_MAX_BATCH];
+    unsigned int i, j, bad = 0;
+
+    sr_rcu_read_lock(sr.rcu, sr.fwd_reader);
+    for(i = 0; i < BENCH_DSTS; i += BENCH_MAX_BATCH)
+    {
+        sr_rt_lookup_batch(&sr, dsts + i, BENCH_MAX_BATCH, out);
+        for(j = 0; j < BENCH_MAX_BATCH; j++)
+        {
+            if(out[j] != sr_rt_lookup(&sr, dsts[i + j]))
+            { bad++; }
+        }
+    }
+    sr_rcu_read_unlock(sr.fwd_reader);
+
+    return bad;
+} /* -- bench_verify -- */
+
+/*---------------------------------------------------------------------
+ * Method: bench_run(..)
+ *
+ * Time 'lookups' lookups, batch at a time, or one sr_rt_lookup at a
+ * time when batch is 0, and report them.  Each call is its own read
+ * section, as it would be on the forwarding path.
+ *
+ *---------------------------------------------------------------------*/
+
+static void bench_run(const char* label, unsigned int batch,
+                      unsigned int lookups)
+{
+    struct sr_rt* out[BENCH_MAX_BATCH];
+    unsigned int n, i = 0, j, step = batch ? batch : 1;
+    unsigned long found = 0;
+    uint64_t t0;
+
+    for(n = 0; n < lookups / step; n++)
+    {
+        t0 = bench_now_ns();
+        sr_rcu_read_lock(sr.rcu, sr.fwd_reader);
+        if(batch == 0)
+        { out[0] = sr_rt_lookup(&sr, dsts[i]); }
+        else
+        { sr_rt_lookup_batch(&sr, dsts + i, batch, out); }
+        sr_rcu_read_unlock(sr.fwd_reader);
+        lat[n] = bench_now_ns() - t0;
+
+        for(j = 0; j < step; j++)
+        { found += out[j] != 0; }
+        i = (i + step) & (BENCH_DSTS - 1);
+    }
+
+    if(found == 0 && table.n)
+    { fprintf(stderr, "no destination matched a route\n"); }
+    bench_report(label, "lookup", lat, n, step);
+} /* -- bench_run -- */
+
+static void bench_mode(uint8_t mode, const char* name, unsigned int lookups)
+{
+    char label[16];
+    unsigned int bad, b;
+
+    bench_publish(&sr, &table, mode, 4);
+    printf("== %s ==\n", name);
+    sr_rt_print_index_stats(&sr);
+
+    if((bad = bench_verify()) != 0)
+    {
+        fprintf(stderr, "%s: %u batch lookups differ from sr_rt_lookup\n",
+                name, bad);
+        exit(1);
+    }
+
+    bench_run("single", 0, lookups);
+    for(b = 0; b < sizeof(bench_batch) / sizeof(bench_batch[0]); b++)
+    {
+        snprintf(label, sizeof(label), "batch %u", bench_batch[b]);
+        bench_run(label, bench_batch[b], lookups);
+    }
+} /* -- bench_mode -- */
+
+int main(int argc, char** argv)
+{
+    unsigned int routes = BENCH_ROUTES;
+    unsigned int lookups = BENCH_LOOKUPS;
+    unsigned int seed = 1;
+    int mode = -1;
+    int c;
+
+    while((c = getopt(argc, argv, "hn:l:s:m:F:")) != EOF)
+    {
+        switch(c)
+        {
+            case 'h':
+                usage(argv[0]);
+                exit(0);
+            case 'n':
+                routes = atoi(optarg);
+                break;
+            case 'l':
+                lookups = atoi(optarg);
+                break;
+            case 's':
+                seed = atoi(optarg);
+                break;
+            case 'm':
+                if(bench_parse_mix(optarg) < 0)
+                {
+                    usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'F':
+                if((mode = sr_rt_parse_fib_mode(optarg)) < 0)
+                {
+                    usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    bench_init_instance(&sr);
+    srand(seed);
+    bench_gen_routes(&table, routes);
+    dsts = (uint32_t*)malloc(BENCH_DSTS * sizeof(uint32_t));
+    lat  = (uint32_t*)malloc((lookups ? lookups : 1) * sizeof(uint32_t));
+    assert(dsts && lat);
+    bench_gen_dsts(&table, dsts, BENCH_DSTS);
+
+    printf("%u routes, %u lookups per run, timer overhead %lu ns\n", routes,
+           lookups, (unsigned long)bench_timer_overhead());
+
+    /* -- the list is only timed on request, it scans every route -- */
+    if(mode == SR_FIB_LIST)
+    { bench_mode(SR_FIB_LIST, "list", lookups); }
+    if(mode < 0 || mode == SR_FIB_TRIE)
+    { bench_mode(SR_FIB_TRIE, "trie", lookups); }
+    if(mode < 0 || mode == SR_FIB_DIR248)
+    { bench_mode(SR_FIB_DIR248, "dir248", lookups); }
+
+    return 0;
+} /* -- main -- */
@@ -0,0 +1,245 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_cksum.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Internet checksum, see sr_cksum.h.
+ *
+ * Buffers of SR_CKSUM_SIMD_MIN bytes or more are summed by the widest
+ * kernel the CPU supports, picked once at startup: AVX2, SSE2, or the
+ * portable loop.  The vector kernels zero extend 32 bit words into 64
+ * bit lanes, so they never need to fold carries inside the loop, and
+ * leave whatever is left over (under one vector stride) to the portable
+ * loop.  Headers are shorter than that and skip the dispatch.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "sr_cksum.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SR_CKSUM_X86
+#include <immintrin.h>
+#endif
+
+#define SR_CKSUM_SIMD_MIN 64
+
+/* -- fold a 64 bit one's complement sum down to 16 bits -- */
+static uint16_t cksum_fold(uint64_t sum)
+{
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)sum;
+} /* -- cksum_fold -- */
+
+/*---------------------------------------------------------------------
+ * Method: cksum_scalar(..)
+ * Scope: Local
+ *
+ * Add the len bytes at p to sum, 32 bit words into a 64 bit
+ * accumulator, 16 bytes a round; an odd last byte is padded with a
+ * zero.  The carries are left for cksum_fold.
+ *
+ *---------------------------------------------------------------------*/
+
+static inline uint64_t cksum_scalar(uint64_t sum, const uint8_t* p,
+                                    unsigned int len)
+{
+    uint32_t w[4];
+    uint16_t h;
+    uint8_t tail[2];
+
+    while(len >= 16)
+    {
+        memcpy(w, p, 16);
+        sum += (uint64_t)w[0] + w[1] + w[2] + w[3];
+        p += 16;
+        len -= 16;
+    }
+    while(len >= 4)
+    {
+        memcpy(w, p, 4);
+        sum += w[0];
+        p += 4;
+        len -= 4;
+    }
+    if(len >= 2)
+    {
+        memcpy(&h, p, 2);
+        sum += h;
+        p += 2;
+        len -= 2;
+    }
+    if(len)
+    {
+        tail[0] = *p;
+        tail[1] = 0;
+        memcpy(&h, tail, 2);
+        sum += h;
+    }
+    return sum;
+} /* -- cksum_scalar -- */
+
+static uint64_t cksum_portable(const uint8_t* p, unsigned int len)
+{
+    return cksum_scalar(0, p, len);
+} /* -- cksum_portable -- */
+
+#ifdef SR_CKSUM_X86
+
+/* -- 32 bytes a round into four 64 bit lanes -- */
+__attribute__((target("sse2")))
+static uint64_t cksum_sse2(const uint8_t* p, unsigned int len)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i a0 = zero, a1 = zero, v, w;
+    uint64_t lanes[2];
+
+    while(len >= 32)
+    {
+        v = _mm_loadu_si128((const __m128i*)p);
+        w = _mm_loadu_si128((const __m128i*)(p + 16));
+        a0 = _mm_add_epi64(a0, _mm_unpacklo_epi32(v, zero));
+        a1 = _mm_add_epi64(a1, _mm_unpackhi_epi32(v, zero));
+        a0 = _mm_add_epi64(a0, _mm_unpacklo_epi32(w, zero));
+        a1 = _mm_add_epi64(a1, _mm_unpackhi_epi32(w, zero));
+        p += 32;
+        len -= 32;
+    }
+    _mm_storeu_si128((__m128i*)lanes, _mm_add_epi64(a0, a1));
+    return cksum_scalar(lanes[0] + lanes[1], p, len);
+} /* -- cksum_sse2 -- */
+
+/* -- 64 bytes a round into eight 64 bit lanes -- */
+__attribute__((target("avx2")))
+static uint64_t cksum_avx2(const uint8_t* p, unsigned int len)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i a0 = zero, a1 = zero, v, w;
+    uint64_t lanes[4];
+
+    while(len >= 64)
+    {
+        v = _mm256_loadu_si256((const __m256i*)p);
+        w = _mm256_loadu_si256((const __m256i*)(p + 32));
+        a0 = _mm256_add_epi64(a0, _mm256_unpacklo_epi32(v, zero));
+        a1 = _mm256_add_epi64(a1, _mm256_unpackhi_epi32(v, zero));
+        a0 = _mm256_add_epi64(a0, _mm256_unpacklo_epi32(w, zero));
+        a1 = _mm256_add_epi64(a1, _mm256_unpackhi_epi32(w, zero));
+        p += 64;
+        len -= 64;
+    }
+    _mm256_storeu_si256((__m256i*)lanes, _mm256_add_epi64(a0, a1));
+    return cksum_scalar(lanes[0] + lanes[1] + lanes[2] + lanes[3], p, len);
+} /* -- cksum_avx2 -- */
+
+#endif /* SR_CKSUM_X86 */
+
+struct cksum_kernel
+{
+    const char* name;
+    uint64_t (*sum)(const uint8_t* p, unsigned int len);
+    int (*usable)(void);
+};
+
+static int cksum_always(void)
+{ return 1; }
+
+#ifdef SR_CKSUM_X86
+static int cksum_has_sse2(void)
+{ return __builtin_cpu_supports("sse2"); }
+
+static int cksum_has_avx2(void)
+{ return __builtin_cpu_supports("avx2"); }
+#endif /* SR_CKSUM_X86 */
+
+/* -- widest first -- */
+static const struct cksum_kernel cksum_kernels[] =
+{
+#ifdef SR_CKSUM_X86
+    { "avx2", cksum_avx2, cksum_has_avx2 },
+    { "sse2", cksum_sse2, cksum_has_sse2 },
+#endif /* SR_CKSUM_X86 */
+    { "scalar", cksum_portable, cksum_always },
+};
+
+#define CKSUM_NKERNELS (sizeof(cksum_kernels) / sizeof(cksum_kernels[0]))
+
+static const struct cksum_kernel* cksum_kernel = 0;
+
+/* -- pick the widest kernel before main, and so before any thread -- */
+__attribute__((constructor))
+static void cksum_pick(void)
+{
+    unsigned int i;
+
+#ifdef SR_CKSUM_X86
+    __builtin_cpu_init();
+#endif /* SR_CKSUM_X86 */
+    for(i = 0; i < CKSUM_NKERNELS; i++)
+    {
+        if(cksum_kernels[i].usable())
+        {
+            cksum_kernel = &cksum_kernels[i];
+            return;
+        }
+    }
+} /* -- cksum_pick -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_cksum(..)
+ * Scope: Global
+ *
+ * The Internet checksum of len bytes at data, which need not be
+ * aligned; an odd last byte is padded with a zero.  Over a header that
+ * includes its own checksum, the result is 0 if the header is intact.
+ *
+ *---------------------------------------------------------------------*/
+
+uint16_t sr_cksum(const void* data, unsigned int len)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    uint64_t sum;
+
+    if(len < SR_CKSUM_SIMD_MIN)
+    { sum = cksum_scalar(0, p, len); }
+    else
+    { sum = cksum_kernel->sum(p, len); }
+    return (uint16_t)~cksum_fold(sum);
+} /* -- sr_cksum -- */
+
+const char* sr_cksum_kernel(void)
+{
+    return cksum_kernel->name;
+} /* -- sr_cksum_kernel -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_cksum_use(..)
+ * Scope: Global
+ *
+ * Sum with the named kernel ("avx2", "sse2" or "scalar") from now on,
+ * for benchmarks and tests; not safe while other threads checksum.
+ * Returns 0, or -1 if there is no such kernel or the CPU lacks it.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_cksum_use(const char* name)
+{
+    unsigned int i;
+
+    for(i = 0; i < CKSUM_NKERNELS; i++)
+    {
+        if(strcmp(cksum_kernels[i].name, name) == 0)
+        {
+            if(!cksum_kernels[i].usable())
+            { return -1; }
+            cksum_kernel = &cksum_kernels[i];
+            return 0;
+        }
+    }
+    return -1;
+} /* -- sr_cksum_use -- */
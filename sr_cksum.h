@@ -0,0 +1,71 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_cksum.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Internet checksum (RFC 1071) and its incremental update (RFC 1624).
+ *
+ * Checksums are kept in the byte order of the data they cover, as they
+ * are stored in the header: the one's complement sum comes out the same
+ * whichever order its 16 bit words are read in, as long as every word
+ * is read the same way.  So nothing is swapped, and a result goes into
+ * its header field as is.
+ *
+ * Every checksum in the router goes through sr_cksum: IP headers, ICMP
+ * messages and PWOSPF packets.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_CKSUM_H
+#define SR_CKSUM_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include <string.h>
+
+#include "sr_protocol.h"
+
+uint16_t sr_cksum(const void* data, unsigned int len);
+const char* sr_cksum_kernel(void);
+int sr_cksum_use(const char* name);
+
+/*---------------------------------------------------------------------
+ * Method: sr_cksum_adjust(..)
+ *
+ * The checksum after one 16 bit word it covers changed from old to new,
+ * by RFC 1624 equation 3: HC' = ~(~HC + ~m + m').  Unlike patching the
+ * checksum directly this never gives 0xffff for a sum of 0, so it agrees
+ * with recomputing the checksum from scratch.
+ *
+ *---------------------------------------------------------------------*/
+
+static inline uint16_t sr_cksum_adjust(uint16_t cksum, uint16_t old,
+                                       uint16_t new)
+{
+    uint32_t sum = (uint16_t)~cksum + (uint32_t)(uint16_t)~old + new;
+
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)~sum;
+} /* -- sr_cksum_adjust -- */
+
+/* -- decrement the TTL, patching the header checksum to match -- */
+static inline void sr_ip_dec_ttl(struct ip* ip)
+{
+    uint16_t old, new;
+
+    /* -- TTL shares its 16 bit word with the protocol -- */
+    memcpy(&old, &ip->ip_ttl, 2);
+    ip->ip_ttl--;
+    memcpy(&new, &ip->ip_ttl, 2);
+    ip->ip_sum = sr_cksum_adjust(ip->ip_sum, old, new);
+} /* -- sr_ip_dec_ttl -- */
+
+#endif /* -- SR_CKSUM_H -- */
@@ -0,0 +1,338 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_control.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Control socket, see sr_control.h.
+ *
+ * The commands reuse the router's own print functions, which write to
+ * stdout, so stdout is pointed at a memory stream while one runs.  That
+ * is safe because everything here runs on the packet thread, the only
+ * one that prints.  The reply is then written from the event loop as
+ * the client takes it, so a slow client never holds up forwarding, and
+ * one that takes too long is dropped.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "sr_control.h"
+#include "sr_router.h"
+#include "sr_if.h"
+#include "sr_rt.h"
+#include "sr_arpcache.h"
+#include "sr_arpqueue.h"
+#include "sr_pbuf.h"
+#include "sr_rxring.h"
+#include "sr_txq.h"
+#include "sr_worker.h"
+#include "sr_event.h"
+#include "sr_pwospf.h"
+#include "sr_dispatch.h"
+#include "sr_icmp.h"
+#include "sr_timer.h"
+
+#define CONTROL_TIMEOUT_MS 5000       /* to send a command and take the reply */
+#define CONTROL_REPLY_MAX  (4 << 20)  /* longest reply, cut off after that */
+
+/* -- one client, until it has its reply -- */
+struct control_conn
+{
+    struct sr_control* ctl;
+    int fd;
+    struct sr_event* ev;
+    struct sr_timer timer;            /* CONTROL_TIMEOUT_MS from accept */
+    unsigned int len;
+    char line[SR_CONTROL_LINE];
+    char* reply;                      /* malloc'd, 0 until the command ran */
+    size_t reply_len;
+    size_t sent;
+};
+
+static void control_help(struct sr_instance* sr);
+
+static void control_interfaces(struct sr_instance* sr)
+{
+    sr_print_if_list(sr);
+} /* -- control_interfaces -- */
+
+static void control_routes(struct sr_instance* sr)
+{
+    sr_print_routing_table(sr);
+} /* -- control_routes -- */
+
+static void control_arp(struct sr_instance* sr)
+{
+    sr_arpcache_print(sr->arp_cache);
+    sr_arpqueue_print(sr->arp_queue);
+} /* -- control_arp -- */
+
+static void control_neighbors(struct sr_instance* sr)
+{
+    pwospf_print_neighbors(sr);
+} /* -- control_neighbors -- */
+
+static void control_protocols(struct sr_instance* sr)
+{
+    sr_dispatch_print(sr->dispatch);
+} /* -- control_protocols -- */
+
+static void control_stats(struct sr_instance* sr)
+{
+    sr_event_loop_print(sr->loop);
+    if(sr->rx)
+    { sr_rxring_print(sr->rx); }
+    if(sr->txq)
+    { sr_txq_print(sr->txq); }
+    if(sr->pbufs)
+    { sr_pbuf_pool_print(sr->pbufs); }
+    if(sr->workers)
+    { sr_workers_print(sr->workers); }
+    if(sr->icmp)
+    { sr_icmp_print(sr->icmp); }
+} /* -- control_stats -- */
+
+static const struct
+{
+    const char* name;
+    const char* help;
+    void (*run)(struct sr_instance* sr);
+} control_commands[] =
+{
+    { "help",       "this list",                          control_help },
+    { "interfaces", "interfaces and their addresses",     control_interfaces },
+    { "routes",     "the routing table",                  control_routes },
+    { "arp",        "ARP cache and requests outstanding", control_arp },
+    { "neighbors",  "PWOSPF neighbors",                   control_neighbors },
+    { "protocols",  "what received frames are handed to", control_protocols },
+    { "stats",      "event loop, queue, buffer and ICMP counters", control_stats },
+};
+
+#define CONTROL_NCOMMANDS \
+    (sizeof(control_commands) / sizeof(control_commands[0]))
+
+static void control_help(struct sr_instance* sr)
+{
+    unsigned int i;
+
+    for(i = 0; i < CONTROL_NCOMMANDS; i++)
+    { printf("%-12s %s\n", control_commands[i].name, control_commands[i].help); }
+} /* -- control_help -- */
+
+/*---------------------------------------------------------------------
+ * Method: control_run(..)
+ * Scope: Local
+ *
+ * Run the command in line, leaving what it printed in conn's reply, cut
+ * off at CONTROL_REPLY_MAX.  Returns -1 if there was nothing to run or
+ * no memory for the reply.
+ *
+ *---------------------------------------------------------------------*/
+
+static int control_run(struct control_conn* conn, char* line)
+{
+    static const char cut[] = "... reply cut off\n";
+    struct sr_control* ctl = conn->ctl;
+    FILE* saved = stdout;
+    FILE* out;
+    unsigned int i;
+
+    line[strcspn(line, " \t\r\n")] = 0;
+    if(line[0] == 0)
+    { return -1; }
+
+    fflush(stdout);
+    if((out = open_memstream(&conn->reply, &conn->reply_len)) == 0)
+    { return -1; }
+    stdout = out;
+
+    for(i = 0; i < CONTROL_NCOMMANDS; i++)
+    {
+        if(strcmp(line, control_commands[i].name) == 0)
+        { break; }
+    }
+    if(i < CONTROL_NCOMMANDS)
+    {
+        control_commands[i].run(ctl->sr);
+        ctl->commands++;
+    }
+    else
+    { printf("unknown command '%s', try help\n", line); }
+
+    stdout = saved;
+    fclose(out);
+    if(conn->reply == 0)
+    { return -1; }
+    if(conn->reply_len > CONTROL_REPLY_MAX)
+    {
+        memcpy(conn->reply + CONTROL_REPLY_MAX - (sizeof(cut) - 1), cut,
+               sizeof(cut) - 1);
+        conn->reply_len = CONTROL_REPLY_MAX;
+    }
+    return 0;
+} /* -- control_run -- */
+
+static void control_conn_close(struct control_conn* conn)
+{
+    sr_timer_cancel(conn->ctl->sr->loop->wheel, &conn->timer);
+    sr_event_del(conn->ctl->sr->loop, conn->ev);
+    close(conn->fd);
+    free(conn->reply);
+    free(conn);
+} /* -- control_conn_close -- */
+
+/* -- the client took too long over its command or its reply -- */
+static void control_timeout(struct sr_timer* timer, void* arg)
+{
+    control_conn_close((struct control_conn*)arg);
+} /* -- control_timeout -- */
+
+/* -- the client can take more of its reply: write what it will take -- */
+static void control_write(struct sr_event* ev, void* arg)
+{
+    struct control_conn* conn = (struct control_conn*)arg;
+    ssize_t n;
+
+    n = write(conn->fd, conn->reply + conn->sent,
+              conn->reply_len - conn->sent);
+    if(n < 0 && (errno == EAGAIN || errno == EINTR))
+    { return; }
+    if(n > 0)
+    {
+        conn->sent += n;
+        if(conn->sent < conn->reply_len)
+        { return; }
+    }
+    control_conn_close(conn);
+} /* -- control_write -- */
+
+/* -- a client sent something: run its command once the line is whole -- */
+static void control_read(struct sr_event* ev, void* arg)
+{
+    struct control_conn* conn = (struct control_conn*)arg;
+    struct sr_event_loop* loop = conn->ctl->sr->loop;
+    ssize_t n;
+
+    n = read(conn->fd, conn->line + conn->len,
+             sizeof(conn->line) - 1 - conn->len);
+    if(n < 0 && (errno == EAGAIN || errno == EINTR))
+    { return; }
+    if(n > 0)
+    {
+        conn->len += n;
+        conn->line[conn->len] = 0;
+        if(strchr(conn->line, '\n') == 0 &&
+           conn->len < sizeof(conn->line) - 1)
+        { return; }
+    }
+    if(n >= 0 && control_run(conn, conn->line) == 0 && conn->reply_len > 0 &&
+       sr_event_mod(loop, conn->ev, EPOLLOUT, control_write) == 0)
+    {
+        /* -- most replies fit in the socket's buffer: try now -- */
+        control_write(conn->ev, conn);
+        return;
+    }
+    control_conn_close(conn);
+} /* -- control_read -- */
+
+static void control_accept(struct sr_event* ev, void* arg)
+{
+    struct sr_control* ctl = (struct sr_control*)arg;
+    struct control_conn* conn;
+    int fd;
+
+    if((fd = accept(ctl->fd, 0, 0)) < 0)
+    { return; }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    conn = (struct control_conn*)calloc(1, sizeof(struct control_conn));
+    assert(conn);
+    conn->ctl = ctl;
+    conn->fd = fd;
+    if((conn->ev = sr_event_add(ctl->sr->loop, fd, EPOLLIN, control_read,
+                                conn)) == 0)
+    {
+        close(fd);
+        free(conn);
+        return;
+    }
+    sr_timer_init(&conn->timer, control_timeout, conn);
+    sr_timer_arm(ctl->sr->loop->wheel, &conn->timer, sr_timer_now_ms(),
+                 CONTROL_TIMEOUT_MS);
+} /* -- control_accept -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_control_open(..)
+ * Scope: Global
+ *
+ * Listen on the Unix socket at path, replacing whatever socket a
+ * previous run left there, and serve it from sr's event loop.  Returns
+ * 0 if the socket could not be set up.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_control* sr_control_open(struct sr_instance* sr, const char* path)
+{
+    struct sr_control* ctl;
+    struct sockaddr_un addr;
+
+    assert(sr && sr->loop && path);
+    if(strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Control socket path too long: %s\n", path);
+        return 0;
+    }
+    ctl = (struct sr_control*)calloc(1, sizeof(struct sr_control));
+    assert(ctl);
+    ctl->sr = sr;
+    strncpy(ctl->path, path, sizeof(ctl->path) - 1);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+
+    ctl->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(ctl->fd < 0 ||
+       bind(ctl->fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+       listen(ctl->fd, 4) != 0)
+    {
+        perror("sr_control.c::sr_control_open");
+        if(ctl->fd >= 0)
+        { close(ctl->fd); }
+        free(ctl);
+        return 0;
+    }
+    if((ctl->ev = sr_event_add(sr->loop, ctl->fd, EPOLLIN, control_accept,
+                               ctl)) == 0)
+    {
+        close(ctl->fd);
+        unlink(path);
+        free(ctl);
+        return 0;
+    }
+
+    /* -- a client that hangs up early must not take the router with it -- */
+    signal(SIGPIPE, SIG_IGN);
+    return ctl;
+} /* -- sr_control_open -- */
+
+void sr_control_close(struct sr_control* ctl)
+{
+    if(ctl == 0)
+    { return; }
+    sr_event_del(ctl->sr->loop, ctl->ev);
+    close(ctl->fd);
+    unlink(ctl->path);
+    free(ctl);
+} /* -- sr_control_close -- */
@@ -0,0 +1,40 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_control.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Control socket.  A Unix stream socket, served from the packet
+ * thread's event loop, through which a local client can look at the
+ * running router without stopping it, e.g.
+ *
+ *     echo routes | nc -U /tmp/sr.ctl
+ *
+ * A client sends one command line and gets the router's printout back,
+ * after which the connection is closed.  "help" lists the commands.  A
+ * client that has not sent its command and taken the reply within a few
+ * seconds is cut off.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_CONTROL_H
+#define SR_CONTROL_H
+
+#define SR_CONTROL_LINE 128           /* longest command line */
+
+struct sr_instance;
+struct sr_event;
+
+struct sr_control
+{
+    struct sr_instance* sr;
+    int fd;                           /* listening */
+    struct sr_event* ev;
+    char path[108];
+    unsigned long commands;           /* run so far */
+};
+
+struct sr_control* sr_control_open(struct sr_instance* sr, const char* path);
+void sr_control_close(struct sr_control* ctl);
+
+#endif /* -- SR_CONTROL_H -- */
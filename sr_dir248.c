@@ -0,0 +1,448 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_dir248.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Compiles the routing table trie into a DIR-24-8 table, and brings one
+ * up to date with a trie after a change, see sr_dir248.h.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "sr_dir248.h"
+#include "sr_rt.h"
+#include "sr_lpm.h"
+
+/* -- drop a version's hold on a chunk or block, 1 if it was the last -- */
+static int dir248_drop(uint32_t* ref)
+{
+    return __atomic_sub_fetch(ref, 1, __ATOMIC_ACQ_REL) == 0;
+} /* -- dir248_drop -- */
+
+static void dir248_ids_push(struct dir248_ids* ids, uint32_t id)
+{
+    if(ids->n == ids->cap)
+    {
+        ids->cap = ids->cap ? ids->cap * 2 : 64;
+        ids->id = (uint32_t*)realloc(ids->id, ids->cap * sizeof(uint32_t));
+        assert(ids->id);
+    }
+    ids->id[ids->n++] = id;
+} /* -- dir248_ids_push -- */
+
+/* -- give rt a slot value in dir -- */
+static void dir248_route_add(struct sr_dir248* dir, struct sr_rt* rt)
+{
+    if(dir->free_routes.n)
+    { rt->dir = dir->free_routes.id[--dir->free_routes.n]; }
+    else
+    {
+        if(dir->route_max == dir->route_cap)
+        {
+            dir->route_cap = dir->route_cap ? dir->route_cap * 2 : 64;
+            dir->routes = (struct sr_rt**)realloc(dir->routes,
+                    dir->route_cap * sizeof(struct sr_rt*));
+            assert(dir->routes);
+        }
+        rt->dir = ++dir->route_max;
+    }
+    dir->routes[rt->dir - 1] = rt;
+    dir->nroutes++;
+} /* -- dir248_route_add -- */
+
+static void dir248_route_remove(struct sr_dir248* dir, const struct sr_rt* rt)
+{
+    dir->routes[rt->dir - 1] = 0;
+    dir248_ids_push(&dir->free_routes, rt->dir);
+    dir->nroutes--;
+} /* -- dir248_route_remove -- */
+
+/* -- slots of chunk c, copied first if another version holds them too -- */
+static uint32_t* dir248_chunk_own(struct sr_dir248* dir, uint32_t c)
+{
+    struct dir248_chunk* chunk = dir->tbl24[c];
+    struct dir248_chunk* copy;
+
+    if(__atomic_load_n(&chunk->ref, __ATOMIC_ACQUIRE) > 1)
+    {
+        copy = (struct dir248_chunk*)malloc(sizeof(struct dir248_chunk));
+        assert(copy);
+        memcpy(copy->slot, chunk->slot, sizeof(chunk->slot));
+        copy->ref = 1;
+        dir248_drop(&chunk->ref);
+        dir->tbl24[c] = copy;
+    }
+    return dir->tbl24[c]->slot;
+} /* -- dir248_chunk_own -- */
+
+/* -- give back overflow block b -- */
+static void dir248_block_free(struct sr_dir248* dir, uint32_t b)
+{
+    if(dir248_drop(&dir->tbllong[b]->ref))
+    { free(dir->tbllong[b]); }
+    dir->tbllong[b] = 0;
+    dir248_ids_push(&dir->free_blocks, b);
+    dir->nblocks--;
+} /* -- dir248_block_free -- */
+
+/* -- set tbl24 slots [first, first + count) to value, freeing blocks -- */
+static void dir248_fill(struct sr_dir248* dir, uint32_t first, uint32_t count,
+                        uint32_t value)
+{
+    uint32_t end = first + count, i;
+    uint32_t* slot;
+
+    while(first < end)
+    {
+        slot = dir248_chunk_own(dir, first >> DIR248_CHUNK_BITS);
+        for(i = first & (DIR248_CHUNK_SIZE - 1);
+            i < DIR248_CHUNK_SIZE && first < end; i++, first++)
+        {
+            if(slot[i] & DIR248_OVERFLOW)
+            { dir248_block_free(dir, slot[i] & ~DIR248_OVERFLOW); }
+            slot[i] = value;
+        }
+    }
+} /* -- dir248_fill -- */
+
+/* -- writable overflow block under tbl24 slot i24, made if need be -- */
+static uint32_t* dir248_block(struct sr_dir248* dir, uint32_t i24)
+{
+    uint32_t* slot = &dir->tbl24[i24 >> DIR248_CHUNK_BITS]->
+                     slot[i24 & (DIR248_CHUNK_SIZE - 1)];
+    struct dir248_block* block;
+    struct dir248_block* copy;
+    uint32_t b;
+    int i;
+
+    if(*slot & DIR248_OVERFLOW)
+    {
+        b = *slot & ~DIR248_OVERFLOW;
+        block = dir->tbllong[b];
+        if(__atomic_load_n(&block->ref, __ATOMIC_ACQUIRE) > 1)
+        {
+            copy = (struct dir248_block*)malloc(sizeof(struct dir248_block));
+            assert(copy);
+            memcpy(copy->slot, block->slot, sizeof(block->slot));
+            copy->ref = 1;
+            dir248_drop(&block->ref);
+            dir->tbllong[b] = copy;
+        }
+        return dir->tbllong[b]->slot;
+    }
+
+    if(dir->free_blocks.n)
+    { b = dir->free_blocks.id[--dir->free_blocks.n]; }
+    else
+    {
+        if(dir->block_max == dir->block_cap)
+        {
+            dir->block_cap = dir->block_cap ? dir->block_cap * 2 : 64;
+            dir->tbllong = (struct dir248_block**)realloc(dir->tbllong,
+                    dir->block_cap * sizeof(struct dir248_block*));
+            assert(dir->tbllong);
+        }
+        b = dir->block_max++;
+    }
+
+    /* -- the block inherits whatever covered the whole /24 -- */
+    block = (struct dir248_block*)malloc(sizeof(struct dir248_block));
+    assert(block);
+    block->ref = 1;
+    for(i = 0; i < DIR248_BLOCK_SIZE; i++)
+    { block->slot[i] = *slot; }
+    dir->tbllong[b] = block;
+    dir->nblocks++;
+
+    dir248_chunk_own(dir, i24 >> DIR248_CHUNK_BITS)
+        [i24 & (DIR248_CHUNK_SIZE - 1)] = DIR248_OVERFLOW | b;
+    return block->slot;
+} /* -- dir248_block -- */
+
+/* -- point the slots rt's prefix covers at it -- */
+static void dir248_paint(struct sr_dir248* dir, const struct sr_rt* rt)
+{
+    int len = sr_lpm_mask_len(rt->mask.s_addr);
+    uint32_t prefix = ntohl(rt->dest.s_addr & rt->mask.s_addr);
+    uint32_t* block;
+    uint32_t first, count, j;
+
+    if(len <= 24)
+    {
+        dir248_fill(dir, prefix >> 8, 1U << (24 - len), rt->dir);
+        return;
+    }
+    block = dir248_block(dir, prefix >> 8);
+    first = prefix & 0xff;
+    count = 1U << (32 - len);
+    for(j = 0; j < count; j++)
+    { block[first + j] = rt->dir; }
+} /* -- dir248_paint -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_dir248_build(..)
+ * Scope: Global
+ *
+ * Compile a DIR-24-8 table from the routes held in a trie, numbering
+ * them afresh.  The trie is walked in preorder, which reaches every
+ * prefix before the longer ones inside it, so painting in that order
+ * leaves each slot naming its longest match.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_dir248* sr_dir248_build(const struct sr_lpm* lpm)
+{
+    struct sr_dir248* dir;
+    struct sr_lpm_iter it;
+    struct sr_rt* rt;
+    unsigned int c;
+
+    dir = (struct sr_dir248*)calloc(1, sizeof(struct sr_dir248));
+    assert(dir);
+    for(c = 0; c < DIR248_CHUNKS; c++)
+    {
+        dir->tbl24[c] = (struct dir248_chunk*)calloc(1,
+                sizeof(struct dir248_chunk));
+        assert(dir->tbl24[c]);
+        dir->tbl24[c]->ref = 1;
+    }
+    dir->route_cap = lpm->routes ? lpm->routes : 1;
+    dir->routes = (struct sr_rt**)malloc(dir->route_cap *
+                                         sizeof(struct sr_rt*));
+    assert(dir->routes);
+
+    sr_lpm_iter_init(&it, lpm);
+    while((rt = sr_lpm_iter_next(&it)) != 0)
+    {
+        dir248_route_add(dir, rt);
+        dir248_paint(dir, rt);
+    }
+    assert(dir->nroutes == lpm->routes);
+
+    return dir;
+} /* -- sr_dir248_build -- */
+
+/* -- a version sharing all of base, which hands over its free numbers -- */
+static struct sr_dir248* dir248_derive(struct sr_dir248* base)
+{
+    struct sr_dir248* dir;
+    unsigned int i;
+
+    dir = (struct sr_dir248*)malloc(sizeof(struct sr_dir248));
+    assert(dir);
+    *dir = *base;
+    memset(&base->free_blocks, 0, sizeof(struct dir248_ids));
+    memset(&base->free_routes, 0, sizeof(struct dir248_ids));
+
+    for(i = 0; i < DIR248_CHUNKS; i++)
+    { __atomic_add_fetch(&dir->tbl24[i]->ref, 1, __ATOMIC_RELAXED); }
+    dir->tbllong = (struct dir248_block**)malloc((dir->block_cap ?
+            dir->block_cap : 1) * sizeof(struct dir248_block*));
+    dir->routes = (struct sr_rt**)malloc(dir->route_cap *
+                                         sizeof(struct sr_rt*));
+    assert(dir->tbllong && dir->routes);
+    for(i = 0; i < dir->block_max; i++)
+    {
+        if((dir->tbllong[i] = base->tbllong[i]) != 0)
+        { __atomic_add_fetch(&dir->tbllong[i]->ref, 1, __ATOMIC_RELAXED); }
+    }
+    memcpy(dir->routes, base->routes, dir->route_max * sizeof(struct sr_rt*));
+    return dir;
+} /* -- dir248_derive -- */
+
+static int dir248_edit_cmp(const void* a, const void* b)
+{
+    const struct sr_dir248_edit* ea = (const struct sr_dir248_edit*)a;
+    const struct sr_dir248_edit* eb = (const struct sr_dir248_edit*)b;
+
+    if(ea->prefix != eb->prefix)
+    { return ea->prefix < eb->prefix ? -1 : 1; }
+    return (ea->len > eb->len) - (ea->len < eb->len);
+} /* -- dir248_edit_cmp -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_dir248_update(..)
+ * Scope: Global
+ *
+ * The table for lpm, made from base, the table for base_lpm, given the
+ * n prefixes at which the two tries differ.  A route that replaced one
+ * for the same prefix takes over its number; for a prefix added or
+ * removed, the slots under it (under its /24, if longer) are painted
+ * again from lpm.  base stays as it was, but hands its free numbers
+ * over, so must not be updated again.  Edits that would repaint more
+ * than a quarter of tbl24 get the table built afresh instead.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_dir248* sr_dir248_update(struct sr_dir248* base,
+        const struct sr_lpm* base_lpm, const struct sr_lpm* lpm,
+        struct sr_dir248_edit* edits, unsigned int n)
+{
+    struct sr_dir248* dir;
+    struct sr_lpm_iter it;
+    struct sr_rt* old;
+    struct sr_rt* rt;
+    struct sr_rt* cover;
+    uint64_t slots = 0;
+    uint32_t mask;
+    unsigned int i, k = 0;
+    int len;
+
+    for(i = 0; i < n; i++)
+    { slots += edits[i].len <= 24 ? 1U << (24 - edits[i].len) : 1; }
+    if(slots > DIR248_TBL24_SIZE / 4)
+    { return sr_dir248_build(lpm); }
+
+    /* -- a prefix edited more than once is looked at once -- */
+    qsort(edits, n, sizeof(struct sr_dir248_edit), dir248_edit_cmp);
+    for(i = 0; i < n; i++)
+    {
+        if(k > 0 && dir248_edit_cmp(&edits[k - 1], &edits[i]) == 0)
+        { continue; }
+        edits[k++] = edits[i];
+    }
+    n = k;
+
+    /* -- number the routes first, so painting finds them all numbered -- */
+    dir = dir248_derive(base);
+    for(i = 0; i < n; i++)
+    {
+        mask = htonl(edits[i].len ? 0xffffffffU << (32 - edits[i].len) : 0);
+        old = sr_lpm_find(base_lpm, htonl(edits[i].prefix), mask);
+        rt  = sr_lpm_find(lpm, htonl(edits[i].prefix), mask);
+        if(old == rt || (old && rt))
+        {
+            if(old && rt)
+            {
+                rt->dir = old->dir;
+                dir->routes[rt->dir - 1] = rt;
+            }
+            edits[i].len = -1;
+            continue;
+        }
+        if(old)
+        { dir248_route_remove(dir, old); }
+        else
+        { dir248_route_add(dir, rt); }
+    }
+
+    for(i = 0; i < n; i++)
+    {
+        if((len = edits[i].len) < 0)
+        { continue; }
+        if(len > 24)
+        { len = 24; }
+        mask = len ? 0xffffffffU << (32 - len) : 0;
+        cover = sr_lpm_iter_init_within(&it, lpm, edits[i].prefix & mask, len);
+        dir248_fill(dir, (edits[i].prefix & mask) >> 8, 1U << (24 - len),
+                    cover ? cover->dir : 0);
+        while((rt = sr_lpm_iter_next(&it)) != 0)
+        {
+            if(sr_lpm_mask_len(rt->mask.s_addr) > len)
+            { dir248_paint(dir, rt); }
+        }
+    }
+
+    return dir;
+} /* -- sr_dir248_update -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_dir248_lookup_batch(..)
+ * Scope: Global
+ *
+ * sr_dir248_lookup for n destinations.  Each pass issues the prefetches
+ * for a group of lookups before reading any of them: first the tbl24
+ * slots, then the overflow slots those name, then the routes.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_dir248_lookup_batch(const struct sr_dir248* dir,
+                            const uint32_t* dst_nbo, unsigned int n,
+                            struct sr_rt** out)
+{
+    const uint32_t* at[DIR248_BATCH_LANES];
+    uint32_t dst[DIR248_BATCH_LANES];
+    uint32_t slot[DIR248_BATCH_LANES];
+    unsigned int first, lanes, i;
+
+    for(first = 0; first < n; first += lanes)
+    {
+        lanes = n - first;
+        if(lanes > DIR248_BATCH_LANES)
+        { lanes = DIR248_BATCH_LANES; }
+
+        for(i = 0; i < lanes; i++)
+        {
+            dst[i] = ntohl(dst_nbo[first + i]);
+            at[i] = &dir->tbl24[dst[i] >> (8 + DIR248_CHUNK_BITS)]->
+                    slot[(dst[i] >> 8) & (DIR248_CHUNK_SIZE - 1)];
+            __builtin_prefetch(at[i]);
+        }
+        for(i = 0; i < lanes; i++)
+        {
+            slot[i] = *at[i];
+            if(slot[i] & DIR248_OVERFLOW)
+            {
+                at[i] = &dir->tbllong[slot[i] & ~DIR248_OVERFLOW]->
+                        slot[dst[i] & 0xff];
+                __builtin_prefetch(at[i]);
+            }
+        }
+        for(i = 0; i < lanes; i++)
+        {
+            if(slot[i] & DIR248_OVERFLOW)
+            { slot[i] = *at[i]; }
+            out[first + i] = slot[i] ? dir->routes[slot[i] - 1] : 0;
+        }
+    }
+} /* -- sr_dir248_lookup_batch -- */
+
+/* -- free dir and the chunks and blocks no other version holds -- */
+void sr_dir248_destroy(struct sr_dir248* dir)
+{
+    unsigned int i;
+
+    if(dir == 0)
+    { return; }
+    for(i = 0; i < DIR248_CHUNKS; i++)
+    {
+        if(dir248_drop(&dir->tbl24[i]->ref))
+        { free(dir->tbl24[i]); }
+    }
+    for(i = 0; i < dir->block_max; i++)
+    {
+        if(dir->tbllong[i] && dir248_drop(&dir->tbllong[i]->ref))
+        { free(dir->tbllong[i]); }
+    }
+    free(dir->tbllong);
+    free(dir->routes);
+    free(dir->free_blocks.id);
+    free(dir->free_routes.id);
+    free(dir);
+} /* -- sr_dir248_destroy -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_dir248_footprint(..)
+ * Scope: Global
+ *
+ * Bytes allocated for the table, counting tbl24 in full even though the
+ * kernel only backs the pages that were written, and counting chunks and
+ * blocks shared with other versions as if they were its own.
+ *
+ *---------------------------------------------------------------------*/
+
+size_t sr_dir248_footprint(const struct sr_dir248* dir)
+{
+    if(dir == 0)
+    { return 0; }
+    return sizeof(struct sr_dir248) +
+           (size_t)DIR248_CHUNKS * sizeof(struct dir248_chunk) +
+           (size_t)dir->nblocks * sizeof(struct dir248_block) +
+           (size_t)dir->block_cap * sizeof(struct dir248_block*) +
+           (size_t)dir->route_cap * sizeof(struct sr_rt*);
+} /* -- sr_dir248_footprint -- */
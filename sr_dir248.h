@@ -0,0 +1,125 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_dir248.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * DIR-24-8 direct indexed forwarding table compiled from the routing
+ * table trie.
+ *
+ * tbl24 has one slot per /24 indexed by the top 24 bits of the
+ * destination.  A slot either names a route directly or, if some prefix
+ * longer than /24 falls inside it, points at a 256 entry overflow block
+ * indexed by the last octet.  A lookup is therefore one memory access,
+ * or two for addresses under a long prefix.
+ *
+ * A published table is read only.  A change to the routing table makes
+ * a new version with sr_dir248_update, which repaints only the prefixes
+ * that changed.  tbl24 is cut into chunks, and the chunks and overflow
+ * blocks are reference counted and shared between versions; a version
+ * copies just those it writes to, and frees those no other version holds.
+ *
+ * Slots name routes by a number kept in the route (sr_rt.dir), which a
+ * route keeps across versions, so a route that only changes its next
+ * hops takes over its predecessor's number without a slot changing.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_DIR248_H
+#define SR_DIR248_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include <stddef.h>
+#include <arpa/inet.h>
+
+struct sr_rt;
+struct sr_lpm;
+
+/* -- slot encoding: 0 no route, else route index + 1 or overflow block -- */
+#define DIR248_OVERFLOW   0x80000000U
+#define DIR248_TBL24_SIZE (1U << 24)
+#define DIR248_CHUNK_BITS 12          /* tbl24 slots per chunk, log 2 */
+#define DIR248_CHUNK_SIZE (1U << DIR248_CHUNK_BITS)
+#define DIR248_CHUNKS     (DIR248_TBL24_SIZE >> DIR248_CHUNK_BITS)
+#define DIR248_BLOCK_SIZE 256
+#define DIR248_BATCH_LANES 32 /* lookups prefetched ahead per pass */
+
+struct dir248_chunk
+{
+    uint32_t ref;             /* versions holding it */
+    uint32_t slot[DIR248_CHUNK_SIZE];
+};
+
+struct dir248_block
+{
+    uint32_t ref;
+    uint32_t slot[DIR248_BLOCK_SIZE];
+};
+
+/* -- numbers free for reuse, kept by the newest version only -- */
+struct dir248_ids
+{
+    uint32_t* id;
+    unsigned int n;
+    unsigned int cap;
+};
+
+/* -- a prefix sr_dir248_update is to repaint, host byte order -- */
+struct sr_dir248_edit
+{
+    uint32_t prefix;
+    int len;
+};
+
+struct sr_dir248
+{
+    struct dir248_chunk* tbl24[DIR248_CHUNKS]; /* by top bits of the /24 */
+    struct dir248_block** tbllong; /* by block number, 0 if free */
+    unsigned int nblocks;          /* in use */
+    unsigned int block_max;        /* numbers given out */
+    unsigned int block_cap;        /* tbllong's size */
+    struct dir248_ids free_blocks;
+    struct sr_rt** routes;         /* slot value - 1 -> route, 0 if free */
+    unsigned int nroutes;          /* in use */
+    unsigned int route_max;
+    unsigned int route_cap;
+    struct dir248_ids free_routes;
+};
+
+struct sr_dir248* sr_dir248_build(const struct sr_lpm* lpm);
+struct sr_dir248* sr_dir248_update(struct sr_dir248* base,
+        const struct sr_lpm* base_lpm, const struct sr_lpm* lpm,
+        struct sr_dir248_edit* edits, unsigned int n);
+void sr_dir248_destroy(struct sr_dir248* dir);
+void sr_dir248_lookup_batch(const struct sr_dir248* dir,
+                            const uint32_t* dst_nbo, unsigned int n,
+                            struct sr_rt** out);
+size_t sr_dir248_footprint(const struct sr_dir248* dir);
+
+/*---------------------------------------------------------------------
+ * Method: sr_dir248_lookup(..)
+ *
+ * Return the longest prefix match for dst (network byte order) or 0.
+ *
+ *---------------------------------------------------------------------*/
+
+static inline
+struct sr_rt* sr_dir248_lookup(const struct sr_dir248* dir, uint32_t dst_nbo)
+{
+    uint32_t dst  = ntohl(dst_nbo);
+    uint32_t slot = dir->tbl24[dst >> (8 + DIR248_CHUNK_BITS)]->
+                    slot[(dst >> 8) & (DIR248_CHUNK_SIZE - 1)];
+
+    if(slot & DIR248_OVERFLOW)
+    { slot = dir->tbllong[slot & ~DIR248_OVERFLOW]->slot[dst & 0xff]; }
+    return slot ? dir->routes[slot - 1] : 0;
+} /* -- sr_dir248_lookup -- */
+
+#endif /* -- SR_DIR248_H -- */
@@ -0,0 +1,136 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_dispatch.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Dispatch tables for received frames, see sr_dispatch.h.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <arpa/inet.h>
+
+#include "sr_dispatch.h"
+#include "sr_if.h"
+
+struct sr_dispatch* sr_dispatch_create(void)
+{
+    struct sr_dispatch* d;
+
+    d = (struct sr_dispatch*)calloc(1, sizeof(struct sr_dispatch));
+    assert(d);
+    return d;
+} /* -- sr_dispatch_create -- */
+
+void sr_dispatch_destroy(struct sr_dispatch* d)
+{
+    free(d);
+} /* -- sr_dispatch_destroy -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_dispatch_ether(..)
+ * Scope: Global
+ *
+ * Hand frames of ethertype type (host byte order) to fn, or to nobody
+ * if fn is 0.  Returns 0, or -1 if another type already has its slot.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_dispatch_ether(struct sr_dispatch* d, uint16_t type, sr_dispatch_fn fn)
+{
+    uint16_t type_nbo = htons(type);
+    unsigned int i = sr_dispatch_ether_slot(type_nbo);
+
+    if(d->ether[i].fn && d->ether[i].type != type_nbo)
+    {
+        fprintf(stderr, "Ethertype 0x%04x shares a dispatch slot with "
+                "0x%04x\n", type, ntohs(d->ether[i].type));
+        return -1;
+    }
+    d->ether[i].type = fn ? type_nbo : 0;
+    d->ether[i].fn = fn;
+    return 0;
+} /* -- sr_dispatch_ether -- */
+
+/* -- hand IP packets of protocol proto to fn, see SR_DISPATCH_* for flags -- */
+int sr_dispatch_ip(struct sr_dispatch* d, uint8_t proto, sr_dispatch_fn fn,
+                   unsigned int flags)
+{
+    d->ip[proto].fn = fn;
+    d->ip[proto].flags = fn ? flags : 0;
+    return 0;
+} /* -- sr_dispatch_ip -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_dispatch_set_local(..)
+ * Scope: Global
+ *
+ * Make the addresses of the interfaces in if_list the router's own,
+ * replacing those there were.  Interfaces without an address yet are
+ * left out.  Returns 0, or -1 if there were more addresses than the
+ * table keeps half full, in which case the rest are left out.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_dispatch_set_local(struct sr_dispatch* d, struct sr_if* if_list)
+{
+    struct sr_if* ifs;
+    unsigned int i;
+
+    memset(d->local, 0, sizeof(d->local));
+    d->nlocal = 0;
+    for(ifs = if_list; ifs; ifs = ifs->next)
+    {
+        if(ifs->ip == 0 || sr_dispatch_local(d, ifs->ip))
+        { continue; }
+        if(d->nlocal >= SR_DISPATCH_LOCAL_SLOTS / 2)
+        {
+            fprintf(stderr, "Too many local addresses, %s left out\n",
+                    ifs->name);
+            return -1;
+        }
+        i = sr_dispatch_local_slot(ifs->ip);
+        while(d->local[i].ip != 0)
+        { i = (i + 1) & (SR_DISPATCH_LOCAL_SLOTS - 1); }
+        d->local[i].iface = ifs;
+        d->local[i].ip = ifs->ip;
+        d->nlocal++;
+    }
+    return 0;
+} /* -- sr_dispatch_set_local -- */
+
+void sr_dispatch_print(struct sr_dispatch* d)
+{
+    struct in_addr ip;
+    unsigned int i;
+
+    printf("Ethertypes handled:");
+    for(i = 0; i < SR_DISPATCH_ETHER_SLOTS; i++)
+    {
+        if(d->ether[i].fn)
+        { printf(" 0x%04x", ntohs(d->ether[i].type)); }
+    }
+    printf("\nIP protocols handled:");
+    for(i = 0; i < 256; i++)
+    {
+        if(d->ip[i].fn)
+        {
+            printf(" %u%s", i,
+                   d->ip[i].flags & SR_DISPATCH_ANY_DST ? " (any destination)" : "");
+        }
+    }
+    printf("\nLocal addresses:");
+    for(i = 0; i < SR_DISPATCH_LOCAL_SLOTS; i++)
+    {
+        if(d->local[i].ip)
+        {
+            ip.s_addr = d->local[i].ip;
+            printf(" %s (%s)", inet_ntoa(ip), d->local[i].iface->name);
+        }
+    }
+    printf("\n");
+} /* -- sr_dispatch_print -- */
@@ -0,0 +1,122 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_dispatch.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Where a received frame goes.  Handlers are registered by ethertype
+ * and by IP protocol number, and looked up in small direct-indexed
+ * tables, so a frame finds its handler with one load however many
+ * protocols the router speaks.  The router's own addresses are kept in
+ * a hash alongside, for the "is this for us" test every IP packet
+ * takes.
+ *
+ * The ethertype table has SR_DISPATCH_ETHER_SLOTS slots picked by the
+ * two bytes of the type xored together, which comes out the same in
+ * either byte order, so frames are looked up by their type as it is on
+ * the wire.  Two types that share a slot cannot both be registered.
+ *
+ * Tables are filled in before packets flow, and only read after that,
+ * by the packet thread and forwarding workers alike.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_DISPATCH_H
+#define SR_DISPATCH_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#define SR_DISPATCH_ETHER_SLOTS 256
+#define SR_DISPATCH_LOCAL_BITS  7
+#define SR_DISPATCH_LOCAL_SLOTS (1 << SR_DISPATCH_LOCAL_BITS)
+
+#define SR_DISPATCH_ANY_DST 0x01     /* IP: for us whatever the destination */
+
+struct sr_instance;
+struct sr_if;
+
+/* -- takes the frame, Ethernet header and all, as sr_handlepacket does -- */
+typedef void (*sr_dispatch_fn)(struct sr_instance* sr, uint8_t* packet,
+                               struct sr_if* iface, unsigned int length);
+
+struct sr_dispatch_ip
+{
+    sr_dispatch_fn fn;                /* 0 if nothing takes the protocol */
+    unsigned int flags;               /* SR_DISPATCH_* */
+};
+
+struct sr_dispatch
+{
+    struct
+    {
+        uint16_t type;                /* network byte order */
+        sr_dispatch_fn fn;
+    } ether[SR_DISPATCH_ETHER_SLOTS];
+
+    struct sr_dispatch_ip ip[256];
+
+    /* -- open addressing, an address of 0 marks a free slot -- */
+    struct
+    {
+        uint32_t ip;                  /* network byte order */
+        struct sr_if* iface;
+    } local[SR_DISPATCH_LOCAL_SLOTS];
+    unsigned int nlocal;
+};
+
+struct sr_dispatch* sr_dispatch_create(void);
+void sr_dispatch_destroy(struct sr_dispatch* d);
+
+int sr_dispatch_ether(struct sr_dispatch* d, uint16_t type, sr_dispatch_fn fn);
+int sr_dispatch_ip(struct sr_dispatch* d, uint8_t proto, sr_dispatch_fn fn,
+                   unsigned int flags);
+int sr_dispatch_set_local(struct sr_dispatch* d, struct sr_if* if_list);
+void sr_dispatch_print(struct sr_dispatch* d);
+
+static inline unsigned int sr_dispatch_ether_slot(uint16_t type)
+{
+    return (type ^ type >> 8) & (SR_DISPATCH_ETHER_SLOTS - 1);
+} /* -- sr_dispatch_ether_slot -- */
+
+/* -- handler for the ethertype as it is in the frame, or 0 -- */
+static inline sr_dispatch_fn sr_dispatch_ether_fn(const struct sr_dispatch* d,
+                                                  uint16_t type_nbo)
+{
+    unsigned int i = sr_dispatch_ether_slot(type_nbo);
+
+    return d->ether[i].type == type_nbo ? d->ether[i].fn : 0;
+} /* -- sr_dispatch_ether_fn -- */
+
+static inline const struct sr_dispatch_ip*
+sr_dispatch_ip_entry(const struct sr_dispatch* d, uint8_t proto)
+{
+    return &d->ip[proto];
+} /* -- sr_dispatch_ip_entry -- */
+
+static inline unsigned int sr_dispatch_local_slot(uint32_t ip)
+{
+    return (ip * 0x9e3779b1) >> (32 - SR_DISPATCH_LOCAL_BITS);
+} /* -- sr_dispatch_local_slot -- */
+
+/* -- our interface with address ip (network byte order), or 0 -- */
+static inline struct sr_if* sr_dispatch_local(const struct sr_dispatch* d,
+                                              uint32_t ip)
+{
+    unsigned int i = sr_dispatch_local_slot(ip);
+
+    while(d->local[i].ip != 0)
+    {
+        if(d->local[i].ip == ip)
+        { return d->local[i].iface; }
+        i = (i + 1) & (SR_DISPATCH_LOCAL_SLOTS - 1);
+    }
+    return 0;
+} /* -- sr_dispatch_local -- */
+
+#endif /* -- SR_DISPATCH_H -- */
@@ -0,0 +1,274 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_event.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Event loop of the packet thread, see sr_event.h.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "sr_event.h"
+
+/* -- set the timerfd to the wheel's next timer, if that moved -- */
+static int event_set_timer(struct sr_event_loop* loop)
+{
+    struct itimerspec its;
+    uint64_t at = sr_timer_wheel_next(loop->wheel);
+
+    if(at == loop->tfd_at)
+    { return 0; }
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = at / 1000;
+    its.it_value.tv_nsec = (at % 1000) * 1000000;
+    if(timerfd_settime(loop->tfd, TFD_TIMER_ABSTIME, &its, 0) != 0)
+    {
+        perror("timerfd_settime(..):sr_event.c::event_set_timer");
+        return -1;
+    }
+    loop->tfd_at = at;
+    return 0;
+} /* -- event_set_timer -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_event_loop_create(..)
+ * Scope: Global
+ *
+ * A loop with no events yet, whose timerfd follows wheel.  Returns 0 if
+ * the epoll instance or the timerfd could not be made.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_event_loop* sr_event_loop_create(struct sr_timer_wheel* wheel)
+{
+    struct sr_event_loop* loop;
+    struct epoll_event ee;
+
+    assert(wheel);
+    loop = (struct sr_event_loop*)calloc(1, sizeof(struct sr_event_loop));
+    assert(loop);
+    loop->wheel = wheel;
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    loop->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(loop->epfd < 0 || loop->tfd < 0)
+    {
+        perror("sr_event.c::sr_event_loop_create");
+        goto fail;
+    }
+
+    /* -- the timerfd is told apart by its null data pointer -- */
+    memset(&ee, 0, sizeof(ee));
+    ee.events = EPOLLIN;
+    ee.data.ptr = 0;
+    if(epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->tfd, &ee) != 0)
+    {
+        perror("epoll_ctl(..):sr_event.c::sr_event_loop_create");
+        goto fail;
+    }
+    return loop;
+
+fail:
+    if(loop->epfd >= 0)
+    { close(loop->epfd); }
+    if(loop->tfd >= 0)
+    { close(loop->tfd); }
+    free(loop);
+    return 0;
+} /* -- sr_event_loop_create -- */
+
+/* -- frees the events, but leaves their descriptors to their owners -- */
+void sr_event_loop_destroy(struct sr_event_loop* loop)
+{
+    struct sr_event* ev;
+
+    if(loop == 0)
+    { return; }
+    while((ev = loop->events) != 0)
+    {
+        loop->events = ev->next;
+        free(ev);
+    }
+    close(loop->epfd);
+    close(loop->tfd);
+    free(loop);
+} /* -- sr_event_loop_destroy -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_event_add(..)
+ * Scope: Global
+ *
+ * Watch fd for events (EPOLLIN and so on), calling fn with arg when it
+ * is ready, or only recording that it is if fn is 0.  Returns the event,
+ * or 0 if epoll would not take fd.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_event* sr_event_add(struct sr_event_loop* loop, int fd,
+                              uint32_t events, sr_event_fn fn, void* arg)
+{
+    struct sr_event* ev;
+    struct epoll_event ee;
+
+    ev = (struct sr_event*)calloc(1, sizeof(struct sr_event));
+    assert(ev);
+    ev->fd = fd;
+    ev->fn = fn;
+    ev->arg = arg;
+
+    memset(&ee, 0, sizeof(ee));
+    ee.events = events;
+    ee.data.ptr = ev;
+    if(epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ee) != 0)
+    {
+        perror("epoll_ctl(..):sr_event.c::sr_event_add");
+        free(ev);
+        return 0;
+    }
+    ev->next = loop->events;
+    loop->events = ev;
+    return ev;
+} /* -- sr_event_add -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_event_del(..)
+ * Scope: Global
+ *
+ * Stop watching ev's descriptor, which the caller still owns.  May be
+ * called from any callback; ev is only freed once the wait that is
+ * running the callbacks has finished with it.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_event_del(struct sr_event_loop* loop, struct sr_event* ev)
+{
+    if(ev == 0 || ev->fd < 0)
+    { return; }
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, ev->fd, 0);
+    ev->fd = -1;
+    ev->revents = 0;
+} /* -- sr_event_del -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_event_mod(..)
+ * Scope: Global
+ *
+ * Watch ev's descriptor for events instead, calling fn from now on.
+ * May be called from any callback.  Returns 0, or -1 if epoll would
+ * not take the change.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_event_mod(struct sr_event_loop* loop, struct sr_event* ev,
+                 uint32_t events, sr_event_fn fn)
+{
+    struct epoll_event ee;
+
+    if(ev == 0 || ev->fd < 0)
+    { return -1; }
+    memset(&ee, 0, sizeof(ee));
+    ee.events = events;
+    ee.data.ptr = ev;
+    if(epoll_ctl(loop->epfd, EPOLL_CTL_MOD, ev->fd, &ee) != 0)
+    {
+        perror("epoll_ctl(..):sr_event.c::sr_event_mod");
+        return -1;
+    }
+    ev->fn = fn;
+    return 0;
+} /* -- sr_event_mod -- */
+
+/* -- free the events deleted since the last sweep -- */
+static void event_sweep(struct sr_event_loop* loop)
+{
+    struct sr_event** link = &loop->events;
+    struct sr_event* ev;
+
+    while((ev = *link) != 0)
+    {
+        if(ev->fd < 0)
+        {
+            *link = ev->next;
+            free(ev);
+        }
+        else
+        { link = &ev->next; }
+    }
+} /* -- event_sweep -- */
+
+/* -- fire the timers that are due, returns how many -- */
+unsigned int sr_event_loop_timers(struct sr_event_loop* loop)
+{
+    return sr_timer_wheel_run(loop->wheel, sr_timer_now_ms());
+} /* -- sr_event_loop_timers -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_event_loop_wait(..)
+ * Scope: Global
+ *
+ * Sleep until a descriptor is ready or the next timer is due, then run
+ * the callbacks of the ready events and the timers that came due.  The
+ * ready mask of every event is set afresh.  Returns how many events
+ * were ready, 0 if only timers were, or -1 on an error.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_event_loop_wait(struct sr_event_loop* loop)
+{
+    struct epoll_event ready[SR_EVENT_MAX];
+    struct sr_event* ev;
+    uint64_t expirations;
+    ssize_t ret;
+    int i, n, found = 0;
+
+    for(ev = loop->events; ev; ev = ev->next)
+    { ev->revents = 0; }
+    if(event_set_timer(loop) != 0)
+    { return -1; }
+
+    loop->waits++;
+    n = epoll_wait(loop->epfd, ready, SR_EVENT_MAX, -1);
+    if(n < 0)
+    {
+        if(errno == EINTR)
+        { return 0; }
+        perror("epoll_wait(..):sr_event.c::sr_event_loop_wait");
+        return -1;
+    }
+
+    for(i = 0; i < n; i++)
+    {
+        ev = (struct sr_event*)ready[i].data.ptr;
+        if(ev == 0)
+        {
+            ret = read(loop->tfd, &expirations, sizeof(expirations));
+            (void)ret;
+            loop->tfd_at = 0;
+            loop->timer_wakeups++;
+            continue;
+        }
+        if(ev->fd < 0)
+        { continue; }   /* deleted by an earlier callback */
+        ev->revents = ready[i].events;
+        found++;
+        if(ev->fn)
+        { ev->fn(ev, ev->arg); }
+    }
+    sr_event_loop_timers(loop);
+    event_sweep(loop);
+    return found;
+} /* -- sr_event_loop_wait -- */
+
+void sr_event_loop_print(struct sr_event_loop* loop)
+{
+    printf("Event loop: slept %lu times, %lu of them until a timer, "
+           "%u timers armed\n", loop->waits, loop->timer_wakeups,
+           loop->wheel->pending);
+} /* -- sr_event_loop_print -- */
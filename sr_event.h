@@ -0,0 +1,73 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_event.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Event loop of the packet thread.  Every descriptor the thread waits on
+ * is registered with one epoll instance, and so is a timerfd that stands
+ * for the timer wheel: it is set to the time the earliest timer fires,
+ * and to nothing when no timer is armed, so an idle router sleeps until
+ * a frame, a command or a timer is really due.
+ *
+ * An event's callback runs on the loop's thread when its descriptor is
+ * ready.  An event without one only has its ready mask recorded, for the
+ * owner to look at after sr_event_loop_wait returns.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_EVENT_H
+#define SR_EVENT_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include <sys/epoll.h>
+
+#include "sr_timer.h"
+
+#define SR_EVENT_MAX 16               /* ready descriptors taken per wait */
+
+struct sr_event;
+typedef void (*sr_event_fn)(struct sr_event* ev, void* arg);
+
+struct sr_event
+{
+    int fd;
+    uint32_t revents;                 /* found ready by the last wait */
+    sr_event_fn fn;                   /* 0 if the owner checks revents */
+    void* arg;
+    struct sr_event* next;
+};
+
+struct sr_event_loop
+{
+    int epfd;
+    int tfd;                          /* timerfd for the wheel */
+    uint64_t tfd_at;                  /* ms it is set to, 0 if disarmed */
+    struct sr_timer_wheel* wheel;
+    struct sr_event* events;
+
+    unsigned long waits;              /* times the thread went to sleep */
+    unsigned long timer_wakeups;      /* of those, ended by the timerfd */
+};
+
+struct sr_event_loop* sr_event_loop_create(struct sr_timer_wheel* wheel);
+void sr_event_loop_destroy(struct sr_event_loop* loop);
+
+struct sr_event* sr_event_add(struct sr_event_loop* loop, int fd,
+                              uint32_t events, sr_event_fn fn, void* arg);
+void sr_event_del(struct sr_event_loop* loop, struct sr_event* ev);
+int  sr_event_mod(struct sr_event_loop* loop, struct sr_event* ev,
+                  uint32_t events, sr_event_fn fn);
+
+unsigned int sr_event_loop_timers(struct sr_event_loop* loop);
+int  sr_event_loop_wait(struct sr_event_loop* loop);
+void sr_event_loop_print(struct sr_event_loop* loop);
+
+#endif /* -- SR_EVENT_H -- */
@@ -0,0 +1,230 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_icmp.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Rate limited ICMP errors, see sr_icmp.h.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <arpa/inet.h>
+
+#include "sr_icmp.h"
+#include "sr_router.h"
+#include "sr_protocol.h"
+#include "sr_if.h"
+#include "sr_pbuf.h"
+#include "sr_cksum.h"
+#include "sr_timer.h"
+
+struct sr_icmp* sr_icmp_create(void)
+{
+    struct sr_icmp* icmp;
+
+    icmp = (struct sr_icmp*)calloc(1, sizeof(struct sr_icmp));
+    assert(icmp);
+    return icmp;
+} /* -- sr_icmp_create -- */
+
+void sr_icmp_destroy(struct sr_icmp* icmp)
+{
+    free(icmp);
+} /* -- sr_icmp_destroy -- */
+
+/* -- credit in b at now_ms, a new bucket starting full -- */
+static uint32_t icmp_bucket_credit(const struct sr_icmp_bucket* b,
+                                   unsigned int rate, unsigned int burst,
+                                   uint64_t now_ms)
+{
+    uint64_t credit;
+
+    if(b->stamp == 0)
+    { return burst * 1000; }
+    credit = b->credit + (now_ms - b->stamp) * rate;
+    return credit > burst * 1000 ? burst * 1000 : credit;
+} /* -- icmp_bucket_credit -- */
+
+/* -- bucket of source src (network byte order) -- */
+static unsigned int icmp_src_slot(uint32_t src)
+{
+    return (src * 0x9e3779b1) >> (32 - SR_ICMP_SRC_BITS);
+} /* -- icmp_src_slot -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_icmp_rate_ok(..)
+ * Scope: Global
+ *
+ * Whether an error may be sent to src (network byte order) at now_ms,
+ * taking a token from its bucket and the global one if so.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_icmp_rate_ok(struct sr_icmp* icmp, uint32_t src, uint64_t now_ms)
+{
+    struct sr_icmp_bucket* one = &icmp->src[icmp_src_slot(src)];
+    uint32_t one_credit, all_credit;
+
+    one_credit = icmp_bucket_credit(one, SR_ICMP_SRC_RATE, SR_ICMP_SRC_BURST,
+                                    now_ms);
+    all_credit = icmp_bucket_credit(&icmp->all, SR_ICMP_RATE, SR_ICMP_BURST,
+                                    now_ms);
+    if(one_credit < 1000)
+    {
+        icmp->src_limited++;
+        return 0;
+    }
+    if(all_credit < 1000)
+    {
+        icmp->limited++;
+        return 0;
+    }
+
+    one->credit = one_credit - 1000;
+    one->stamp = now_ms;
+    icmp->all.credit = all_credit - 1000;
+    icmp->all.stamp = now_ms;
+    return 1;
+} /* -- sr_icmp_rate_ok -- */
+
+/*---------------------------------------------------------------------
+ * Method: icmp_answerable(..)
+ * Scope: Local
+ *
+ * Whether the packet orig, with a header of hl bytes, that came in on
+ * iface in frame may be answered with an error at all.
+ *
+ *---------------------------------------------------------------------*/
+
+static int icmp_answerable(const uint8_t* frame, unsigned int length,
+                           const struct ip* orig, unsigned int hl,
+                           const struct sr_if* iface)
+{
+    unsigned int etherhl = sizeof(struct sr_ethernet_hdr);
+    uint32_t src = ntohl(orig->ip_src.s_addr);
+    uint32_t dst = ntohl(orig->ip_dst.s_addr);
+    uint32_t host = ~ntohl(iface->mask);
+    const uint8_t* data = frame + etherhl + hl;
+
+    /* -- to a link broadcast or multicast address -- */
+    if(frame[0] & 0x01)
+    { return 0; }
+
+    /* -- to an IP multicast or broadcast address, the subnet's included -- */
+    if(dst >= 0xe0000000 ||
+       (host > 1 && (dst & host) == host &&
+        (dst & ~host) == (ntohl(iface->ip) & ~host)))
+    { return 0; }
+
+    /* -- from no one in particular: 0, loopback, multicast or class E -- */
+    if(src == 0 || (src >> 24) == 127 || src >= 0xe0000000)
+    { return 0; }
+
+    /* -- a fragment other than the first -- */
+    if(ntohs(orig->ip_off) & IP_OFFMASK)
+    { return 0; }
+
+    /* -- an ICMP error itself, anything but an echo taken as one -- */
+    if(orig->ip_p == IPPROTO_ICMP &&
+       (length < etherhl + hl + 1 ||
+        (data[0] != ICMP_ECHO && data[0] != ICMP_ECHOREPLY)))
+    { return 0; }
+
+    return 1;
+} /* -- icmp_answerable -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_icmp_error(..)
+ * Scope: Global
+ *
+ * Send the error type/code about the IP packet in frame, which came in
+ * on iface, back to where it came from.  next_mtu goes in the header
+ * for fragmentation needed and should be 0 otherwise.  Returns 0 if the
+ * error was queued, -1 if it was not to be sent, was rate limited or
+ * found no buffer.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_icmp_error(struct sr_instance* sr, const uint8_t* frame,
+                  unsigned int length, struct sr_if* iface, uint8_t type,
+                  uint8_t code, uint16_t next_mtu)
+{
+    struct sr_icmp* icmp = sr->icmp;
+    unsigned int etherhl = sizeof(struct sr_ethernet_hdr);
+    const struct sr_ethernet_hdr* orig_eth = (const struct sr_ethernet_hdr*)frame;
+    const struct ip* orig = (const struct ip*)(frame + etherhl);
+    struct sr_ethernet_hdr* eth;
+    struct ip* ip;
+    struct sr_pbuf* pb;
+    uint8_t* packet;
+    uint8_t* hdr;
+    unsigned int hl, quote;
+
+    if(icmp == 0 || length < etherhl + sizeof(struct ip))
+    { return -1; }
+    hl = orig->ip_hl * 4;
+    if(hl < sizeof(struct ip) || length < etherhl + hl)
+    { return -1; }
+    if(!icmp_answerable(frame, length, orig, hl, iface))
+    {
+        icmp->suppressed++;
+        return -1;
+    }
+    if(!sr_icmp_rate_ok(icmp, orig->ip_src.s_addr, sr_timer_now_ms()))
+    { return -1; }
+    if((pb = sr_pbuf_alloc(sr->pbufs)) == 0)
+    {
+        icmp->no_buffer++;
+        return -1;
+    }
+
+    /* -- the header and the start of its data, not the link's padding -- */
+    quote = length - etherhl;
+    if(ntohs(orig->ip_len) >= hl && ntohs(orig->ip_len) < quote)
+    { quote = ntohs(orig->ip_len); }
+    if(quote > hl + SR_ICMP_QUOTE)
+    { quote = hl + SR_ICMP_QUOTE; }
+
+    packet = sr_pbuf_data(pb);
+    pb->len = etherhl + sizeof(struct ip) + 8 + quote;
+    memset(packet, 0, etherhl + sizeof(struct ip) + 8);
+    eth = (struct sr_ethernet_hdr*)packet;
+    ip = (struct ip*)(packet + etherhl);
+    hdr = packet + etherhl + sizeof(struct ip);
+
+    memcpy(eth->ether_dhost, orig_eth->ether_shost, ETHER_ADDR_LEN);
+    memcpy(eth->ether_shost, iface->addr, ETHER_ADDR_LEN);
+    eth->ether_type = htons(ETHERTYPE_IP);
+
+    ip->ip_v = 4;
+    ip->ip_hl = sizeof(struct ip) / 4;
+    ip->ip_len = htons(sizeof(struct ip) + 8 + quote);
+    ip->ip_ttl = INIT_TTL;
+    ip->ip_p = IPPROTO_ICMP;
+    ip->ip_src.s_addr = iface->ip;
+    ip->ip_dst = orig->ip_src;
+    ip->ip_sum = sr_cksum(ip, sizeof(struct ip));
+
+    hdr[0] = type;
+    hdr[1] = code;
+    *(uint16_t*)(hdr + 6) = htons(next_mtu);
+    memcpy(hdr + 8, orig, quote);
+    *(uint16_t*)(hdr + 2) = sr_cksum(hdr, 8 + quote);
+
+    sr_send_packet_nocopy(sr, packet, pb->len, iface);
+    sr_pbuf_put(pb);
+    icmp->sent++;
+    return 0;
+} /* -- sr_icmp_error -- */
+
+void sr_icmp_print(struct sr_icmp* icmp)
+{
+    printf("ICMP errors: %lu sent, %lu not to be answered, %lu limited per "
+           "source, %lu limited in all, %lu without a buffer\n", icmp->sent,
+           icmp->suppressed, icmp->src_limited, icmp->limited,
+           icmp->no_buffer);
+} /* -- sr_icmp_print -- */
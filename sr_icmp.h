@@ -0,0 +1,81 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_icmp.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * ICMP errors the router sends about packets it cannot deliver: time
+ * exceeded, destination unreachable (net, host, protocol, port) and
+ * fragmentation needed.  The error goes back out of the interface the
+ * packet came in on, to the Ethernet address it came from, quoting the
+ * packet's IP header and the first 8 bytes of its data.
+ *
+ * No error is sent about an ICMP error, a fragment other than the
+ * first, a packet sent to a broadcast or multicast address (link or
+ * IP), or one whose source does not name a single host (RFC 1812
+ * 4.3.2.7).
+ *
+ * Errors are rate limited by two token buckets, one for all errors and
+ * one per source, so a flood of bad packets from one host neither eats
+ * the packet thread nor crowds out errors to everyone else.  Sources
+ * share SR_ICMP_SRC_SLOTS buckets picked by a hash of the address, so
+ * sources that collide share a limit too; switching between them gets
+ * no new tokens.  An error is sent only if both buckets have a token.
+ *
+ * Replies are built in a pooled buffer and queued from there.  Like the
+ * rest of the router's input path this runs on the packet thread only,
+ * so nothing here is locked.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_ICMP_H
+#define SR_ICMP_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#define SR_ICMP_RATE      200         /* errors a second, all sources */
+#define SR_ICMP_BURST     100
+#define SR_ICMP_SRC_RATE  20          /* errors a second to one source */
+#define SR_ICMP_SRC_BURST 10
+#define SR_ICMP_SRC_BITS  8
+#define SR_ICMP_SRC_SLOTS (1 << SR_ICMP_SRC_BITS)
+#define SR_ICMP_QUOTE     8           /* data bytes quoted past the header */
+
+struct sr_instance;
+struct sr_if;
+
+/* -- credit is kept in 1/1000 tokens, as in arp_rate_ok -- */
+struct sr_icmp_bucket
+{
+    uint64_t stamp;                   /* ms it was last topped up, 0 never */
+    uint32_t credit;
+};
+
+struct sr_icmp
+{
+    struct sr_icmp_bucket all;
+    struct sr_icmp_bucket src[SR_ICMP_SRC_SLOTS];  /* by a hash of the source */
+
+    unsigned long sent;
+    unsigned long suppressed;         /* not to be answered, see above */
+    unsigned long src_limited;        /* the source's bucket was empty */
+    unsigned long limited;            /* the global bucket was */
+    unsigned long no_buffer;          /* the pool was empty */
+};
+
+struct sr_icmp* sr_icmp_create(void);
+void sr_icmp_destroy(struct sr_icmp* icmp);
+void sr_icmp_print(struct sr_icmp* icmp);
+
+int sr_icmp_rate_ok(struct sr_icmp* icmp, uint32_t src, uint64_t now_ms);
+int sr_icmp_error(struct sr_instance* sr, const uint8_t* frame,
+                  unsigned int length, struct sr_if* iface, uint8_t type,
+                  uint8_t code, uint16_t next_mtu);
+
+#endif /* -- SR_ICMP_H -- */
@@ -24,6 +24,7 @@
 
 #include "sr_if.h"
 #include "sr_router.h"
+#include "sr_dispatch.h"
 #include "pwospf_protocol.h"
 
 /*--------------------------------------------------------------------- 
@@ -55,6 +56,37 @@ struct sr_if* sr_get_interface(struct sr_instance* sr, const char* name)
     return 0;
 } /* -- sr_get_interface -- */
 
+/*--------------------------------------------------------------------- 
+ * Method: sr_get_interface_by_index
+ * Scope: Global
+ *
+ * Return the interface with the given index, or 0 for SR_IF_NONE or an
+ * index out of range.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_if* sr_get_interface_by_index(struct sr_instance* sr, int index)
+{
+    if(index < 0 || index >= sr->if_count)
+    { return 0; }
+    return sr->if_array[index];
+} /* -- sr_get_interface_by_index -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_get_interface_index
+ * Scope: Global
+ *
+ * Given an interface name return its index or SR_IF_NONE.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_get_interface_index(struct sr_instance* sr, const char* name)
+{
+    struct sr_if* iface = sr_get_interface(sr, name);
+
+    return iface ? iface->index : SR_IF_NONE;
+} /* -- sr_get_interface_index -- */
+
 /*--------------------------------------------------------------------- 
  * Method: sr_add_interface(..)
  * Scope: Global
@@ -66,19 +98,29 @@ struct sr_if* sr_get_interface(struct sr_instance* sr, const char* name)
 void sr_add_interface(struct sr_instance* sr, const char* name)
 {
     struct sr_if* if_walker = 0;
+    struct sr_if* iface = 0;
 
     /* -- REQUIRES -- */
     assert(name);
     assert(sr);
 
+    iface = (struct sr_if*)calloc(1, sizeof(struct sr_if));
+    assert(iface);
+    iface->helloint = OSPF_DEFAULT_HELLOINT;
+    iface->mtu = SR_IF_DEFAULT_MTU;
+    strncpy(iface->name,name,SR_IFACE_NAMELEN);
+
+    /* -- give it the next index -- */
+    sr->if_array = (struct sr_if**)realloc(sr->if_array,
+            (sr->if_count + 1) * sizeof(struct sr_if*));
+    assert(sr->if_array);
+    iface->index = sr->if_count;
+    sr->if_array[sr->if_count++] = iface;
+
     /* -- empty list special case -- */
     if(sr->if_list == 0)
     {
-        sr->if_list = (struct sr_if*)malloc(sizeof(struct sr_if));
-        sr->if_list->next = 0;
-        sr->if_list->helloint = OSPF_DEFAULT_HELLOINT;
-        sr->if_list->neighbors = 0;
-        strncpy(sr->if_list->name,name,SR_IFACE_NAMELEN);
+        sr->if_list = iface;
         return;
     }
 
@@ -87,12 +129,7 @@ void sr_add_interface(struct sr_instance* sr, const char* name)
     while(if_walker->next)
     {if_walker = if_walker->next; }
 
-    if_walker->next = (struct sr_if*)malloc(sizeof(struct sr_if));
-    if_walker = if_walker->next;
-    if_walker->helloint = OSPF_DEFAULT_HELLOINT;
-    if_walker->neighbors = 0;
-    strncpy(if_walker->name,name,SR_IFACE_NAMELEN);
-    if_walker->next = 0;
+    if_walker->next = iface;
 } /* -- sr_add_interface -- */ 
 
 /*--------------------------------------------------------------------- 
@@ -169,6 +206,10 @@ void sr_set_ether_ip(struct sr_instance* sr, uint32_t ip_nbo)
         sr->RID = ip_nbo;
     }
 
+    /* -- packets to it are now for us -- */
+    if(sr->dispatch)
+    { sr_dispatch_set_local(sr->dispatch, sr->if_list); }
+
 } /* -- sr_set_ether_ip -- */
 
 /*--------------------------------------------------------------------- 
@@ -226,4 +267,6 @@ void sr_print_if(struct sr_if* iface)
     Debug("\n");
     Debug("  mask %s\n",inet_ntoa(mask_addr));
     Debug("  ip address %s\n",inet_ntoa(ip_addr));
+    Debug("  ARP requests %lu sent, %lu rate limited\n",iface->arp_sent,
+          iface->arp_limited);
 } /* -- sr_print_if -- */
@@ -25,6 +25,8 @@
 #endif
 
 #define SR_IFACE_NAMELEN 32
+#define SR_IF_NONE       (-1) /* index of an interface we do not have */
+#define SR_IF_DEFAULT_MTU 1500 /* largest IP packet an interface sends */
 
 struct sr_instance;
 
@@ -35,14 +37,6 @@ struct sr_instance;
  *
  * -------------------------------------------------------------------------- */
 
-struct if_arp
-{
-    unsigned char m_addr[6];
-    unsigned long p_addr;
-    struct if_arp* next;
-    time_t created_time;
-};
-
 struct neighbor_router
 {
     uint32_t neighbor_RID;
@@ -56,14 +50,23 @@ struct sr_if
     unsigned char addr[6];
     uint32_t ip;
     uint32_t speed;
-    struct if_arp* arp_cache;
     uint32_t mask;
     uint16_t helloint;
     struct neighbor_router* neighbors;
+    int index; /* dense, position in sr->if_array */
+    uint16_t mtu; /* bigger packets with IP_DF set are refused */
+
+    /* -- ARP requests sent out of this interface, see arp_rate_ok -- */
+    uint32_t arp_credit;       /* token bucket, in 1/1000 requests */
+    uint64_t arp_stamp;        /* ms it was last topped up, 0 never */
+    unsigned long arp_sent;
+    unsigned long arp_limited; /* suppressed by the rate limit */
     struct sr_if* next;
 };
 
 struct sr_if* sr_get_interface(struct sr_instance* sr, const char* name);
+struct sr_if* sr_get_interface_by_index(struct sr_instance* sr, int index);
+int sr_get_interface_index(struct sr_instance* sr, const char* name);
 void sr_add_interface(struct sr_instance*, const char*);
 void sr_set_ether_addr(struct sr_instance*, const unsigned char*);
 void sr_set_ether_ip(struct sr_instance*, uint32_t ip_nbo);
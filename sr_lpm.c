@@ -0,0 +1,588 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_lpm.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Persistent Patricia trie for longest prefix match, see sr_lpm.h.
+ *
+ * Invariants: a node without a route (glue) always has two children, and
+ * every ancestor of a node belonging to the version being edited belongs
+ * to that version too, since edits copy the whole path from the root.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <arpa/inet.h>
+
+#include "sr_lpm.h"
+
+static uint32_t lpm_last_gen = 0;
+
+/* -- mask with the top len bits set, host byte order -- */
+static inline uint32_t lpm_mask(int len)
+{
+    return len == 0 ? 0 : 0xffffffffU << (32 - len);
+}
+
+/* -- bit i of x counting from the most significant bit -- */
+static inline int lpm_bit(uint32_t x, int i)
+{
+    return (x >> (31 - i)) & 1;
+}
+
+/* -- number of leading bits a and b have in common -- */
+static inline int lpm_common(uint32_t a, uint32_t b)
+{
+    uint32_t diff = a ^ b;
+    return diff == 0 ? 32 : __builtin_clz(diff);
+}
+
+static void lpm_garbage_push(struct sr_lpm_garbage* g, void* ptr)
+{
+    if(g->n == g->cap)
+    {
+        g->cap = g->cap ? g->cap * 2 : 16;
+        g->ptr = (void**)realloc(g->ptr, g->cap * sizeof(void*));
+        assert(g->ptr);
+    }
+    g->ptr[g->n++] = ptr;
+}
+
+static void lpm_garbage_free(struct sr_lpm_garbage* g)
+{
+    free(g->ptr);
+    memset(g, 0, sizeof(struct sr_lpm_garbage));
+}
+
+static struct sr_lpm_node* lpm_node_new(struct sr_lpm* lpm, uint32_t prefix,
+                                        int len, struct sr_rt* rt)
+{
+    struct sr_lpm_node* node;
+
+    node = (struct sr_lpm_node*)malloc(sizeof(struct sr_lpm_node));
+    assert(node);
+    node->prefix   = prefix & lpm_mask(len);
+    node->len      = len;
+    node->gen      = lpm->gen;
+    node->rt_gen   = lpm->gen;
+    node->rt       = rt;
+    node->child[0] = 0;
+    node->child[1] = 0;
+
+    lpm->nodes++;
+    if(rt)
+    { lpm->routes++; }
+
+    return node;
+}
+
+/*---------------------------------------------------------------------
+ * Method: lpm_cow(..)
+ * Scope: Local
+ *
+ * Return a copy of node this version may modify.  Nodes this version
+ * already owns are returned as they are; anything else is copied and
+ * the original recorded as replaced.
+ *
+ *---------------------------------------------------------------------*/
+
+static struct sr_lpm_node* lpm_cow(struct sr_lpm* lpm, struct sr_lpm_node* node)
+{
+    struct sr_lpm_node* copy;
+
+    if(node->gen == lpm->gen)
+    { return node; }
+
+    copy = (struct sr_lpm_node*)malloc(sizeof(struct sr_lpm_node));
+    assert(copy);
+    *copy = *node;
+    copy->gen = lpm->gen;
+    lpm_garbage_push(&lpm->replaced_nodes, node);
+
+    return copy;
+}
+
+/* -- unlink bookkeeping for a node cut out of this version -- */
+static void lpm_drop_node(struct sr_lpm* lpm, struct sr_lpm_node* node)
+{
+    lpm->nodes--;
+    if(node->gen == lpm->gen)
+    { free(node); }
+    else
+    { lpm_garbage_push(&lpm->replaced_nodes, node); }
+}
+
+/* -- release a node's route; the node itself is left untouched -- */
+static void lpm_release_rt(struct sr_lpm* lpm, const struct sr_lpm_node* node)
+{
+    if(node->rt == 0)
+    { return; }
+    if(node->rt_gen == lpm->gen)
+    { lpm->free_rt(node->rt); }
+    else
+    { lpm_garbage_push(&lpm->replaced_rts, node->rt); }
+    lpm->routes--;
+}
+
+/* -- release the route of a node this version owns -- */
+static void lpm_drop_rt(struct sr_lpm* lpm, struct sr_lpm_node* node)
+{
+    lpm_release_rt(lpm, node);
+    node->rt = 0;
+}
+
+static void lpm_free_all(struct sr_lpm* lpm, struct sr_lpm_node* node)
+{
+    if(node == 0)
+    { return; }
+    lpm_free_all(lpm, node->child[0]);
+    lpm_free_all(lpm, node->child[1]);
+    if(node->rt)
+    { lpm->free_rt(node->rt); }
+    free(node);
+}
+
+/* -- free what this version allocated, leaving shared nodes alone -- */
+static void lpm_free_private(struct sr_lpm* lpm, struct sr_lpm_node* node)
+{
+    if(node == 0 || node->gen != lpm->gen)
+    { return; }
+    lpm_free_private(lpm, node->child[0]);
+    lpm_free_private(lpm, node->child[1]);
+    if(node->rt && node->rt_gen == lpm->gen)
+    { lpm->free_rt(node->rt); }
+    free(node);
+}
+
+/*---------------------------------------------------------------------
+ * Method: sr_lpm_mask_len(..)
+ * Scope: Global
+ *
+ * Return the prefix length of a network byte order mask, or -1 if the
+ * mask is not a contiguous run of leading ones.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_lpm_mask_len(uint32_t mask_nbo)
+{
+    uint32_t mask = ntohl(mask_nbo);
+    int len = (mask == 0) ? 0 : __builtin_popcount(mask);
+
+    if(lpm_mask(len) != mask)
+    { return -1; }
+    return len;
+} /* -- sr_lpm_mask_len -- */
+
+struct sr_lpm* sr_lpm_create(void (*free_rt)(struct sr_rt*))
+{
+    struct sr_lpm* lpm = (struct sr_lpm*)calloc(1, sizeof(struct sr_lpm));
+
+    assert(lpm);
+    assert(free_rt);
+    lpm->gen = ++lpm_last_gen;
+    lpm->free_rt = free_rt;
+    return lpm;
+} /* -- sr_lpm_create -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_lpm_derive(..)
+ * Scope: Global
+ *
+ * Start a new version sharing every node and route with base.  Versions
+ * must be derived and edited by one writer at a time.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_lpm* sr_lpm_derive(const struct sr_lpm* base)
+{
+    struct sr_lpm* lpm = sr_lpm_create(base->free_rt);
+
+    lpm->root   = base->root;
+    lpm->nodes  = base->nodes;
+    lpm->routes = base->routes;
+    return lpm;
+} /* -- sr_lpm_derive -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_lpm_hand_over(..)
+ * Scope: Global
+ *
+ * Called once next, derived from base, has replaced base for good.  From
+ * then on destroying base frees only what next no longer uses.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_lpm_hand_over(struct sr_lpm* base, struct sr_lpm* next)
+{
+    assert(!base->shared);
+
+    base->shared     = 1;
+    base->dead_nodes = next->replaced_nodes;
+    base->dead_rts   = next->replaced_rts;
+    memset(&next->replaced_nodes, 0, sizeof(struct sr_lpm_garbage));
+    memset(&next->replaced_rts, 0, sizeof(struct sr_lpm_garbage));
+} /* -- sr_lpm_hand_over -- */
+
+void sr_lpm_destroy(struct sr_lpm* lpm)
+{
+    unsigned int i;
+
+    if(lpm == 0)
+    { return; }
+
+    if(lpm->shared)
+    {
+        for(i = 0; i < lpm->dead_nodes.n; i++)
+        { free(lpm->dead_nodes.ptr[i]); }
+        for(i = 0; i < lpm->dead_rts.n; i++)
+        { lpm->free_rt((struct sr_rt*)lpm->dead_rts.ptr[i]); }
+    }
+    else
+    { lpm_free_all(lpm, lpm->root); }
+
+    lpm_garbage_free(&lpm->dead_nodes);
+    lpm_garbage_free(&lpm->dead_rts);
+    lpm_garbage_free(&lpm->replaced_nodes);
+    lpm_garbage_free(&lpm->replaced_rts);
+    free(lpm);
+} /* -- sr_lpm_destroy -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_lpm_discard(..)
+ * Scope: Global
+ *
+ * Throw away a derived version that was never published.  Its base is
+ * left exactly as it was.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_lpm_discard(struct sr_lpm* lpm)
+{
+    if(lpm == 0)
+    { return; }
+
+    lpm_free_private(lpm, lpm->root);
+    lpm_garbage_free(&lpm->replaced_nodes);
+    lpm_garbage_free(&lpm->replaced_rts);
+    free(lpm);
+} /* -- sr_lpm_discard -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_lpm_insert(..)
+ * Scope: Global
+ *
+ * Add dest/mask -> rt to the trie, replacing and releasing any route
+ * already held for exactly that prefix.
+ *
+ * Returns 0 on success, -1 if mask is not contiguous.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_lpm_insert(struct sr_lpm* lpm, uint32_t dest_nbo, uint32_t mask_nbo,
+                  struct sr_rt* rt)
+{
+    struct sr_lpm_node** link;
+    struct sr_lpm_node* node;
+    struct sr_lpm_node* fresh;
+    struct sr_lpm_node* glue;
+    uint32_t key;
+    int len, common;
+
+    /* -- REQUIRES -- */
+    assert(lpm);
+    assert(rt);
+
+    if((len = sr_lpm_mask_len(mask_nbo)) < 0)
+    { return -1; }
+    key = ntohl(dest_nbo) & lpm_mask(len);
+
+    link = &lpm->root;
+    while((node = *link) != 0)
+    {
+        common = lpm_common(key, node->prefix);
+        if(common > len)       { common = len; }
+        if(common > node->len) { common = node->len; }
+
+        if(common == node->len)
+        {
+            node = *link = lpm_cow(lpm, node);
+            if(len == node->len)
+            {
+                lpm_drop_rt(lpm, node);
+                node->rt     = rt;
+                node->rt_gen = lpm->gen;
+                lpm->routes++;
+                return 0;
+            }
+            link = &node->child[lpm_bit(key, node->len)];
+            continue;
+        }
+
+        if(common == len)
+        {
+            /* -- new prefix covers node, push node below it -- */
+            fresh = lpm_node_new(lpm, key, len, rt);
+            fresh->child[lpm_bit(node->prefix, len)] = node;
+            *link = fresh;
+            return 0;
+        }
+
+        /* -- prefixes diverge, join them under a glue node -- */
+        fresh = lpm_node_new(lpm, key, len, rt);
+        glue  = lpm_node_new(lpm, key, common, 0);
+        glue->child[lpm_bit(key, common)] = fresh;
+        glue->child[lpm_bit(node->prefix, common)] = node;
+        *link = glue;
+        return 0;
+    }
+
+    *link = lpm_node_new(lpm, key, len, rt);
+    return 0;
+} /* -- sr_lpm_insert -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_lpm_find(..)
+ * Scope: Global
+ *
+ * Return the route held for exactly dest/mask, or 0.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_rt* sr_lpm_find(const struct sr_lpm* lpm, uint32_t dest_nbo,
+                          uint32_t mask_nbo)
+{
+    const struct sr_lpm_node* node;
+    uint32_t key;
+    int len;
+
+    if((len = sr_lpm_mask_len(mask_nbo)) < 0)
+    { return 0; }
+    key = ntohl(dest_nbo) & lpm_mask(len);
+
+    node = lpm->root;
+    while(node && node->len <= len)
+    {
+        if((key ^ node->prefix) & lpm_mask(node->len))
+        { return 0; }
+        if(node->len == len)
+        { return node->rt; }
+        node = node->child[lpm_bit(key, node->len)];
+    }
+    return 0;
+} /* -- sr_lpm_find -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_lpm_remove(..)
+ * Scope: Global
+ *
+ * Remove and release the route held for exactly dest/mask.  Glue nodes
+ * left with a single child are collapsed.
+ *
+ * Returns 1 if a route was removed, 0 if there was none.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_lpm_remove(struct sr_lpm* lpm, uint32_t dest_nbo, uint32_t mask_nbo)
+{
+    struct sr_lpm_node** plink = 0;
+    struct sr_lpm_node** link;
+    struct sr_lpm_node* node;
+    struct sr_lpm_node* parent;
+    struct sr_lpm_node* child;
+    uint32_t key;
+    int len;
+
+    if(sr_lpm_find(lpm, dest_nbo, mask_nbo) == 0)
+    { return 0; }
+    len = sr_lpm_mask_len(mask_nbo);
+    key = ntohl(dest_nbo) & lpm_mask(len);
+
+    /* -- copy the path down to the parent of the target -- */
+    link = &lpm->root;
+    while((node = *link)->len != len)
+    {
+        node = *link = lpm_cow(lpm, node);
+        plink = link;
+        link = &node->child[lpm_bit(key, node->len)];
+    }
+
+    if(node->child[0] && node->child[1])
+    {
+        /* -- still needed to branch, keep it as glue -- */
+        node = *link = lpm_cow(lpm, node);
+        lpm_drop_rt(lpm, node);
+        return 1;
+    }
+
+    /* -- node may still be shared, unlink it without writing to it -- */
+    child = node->child[0] ? node->child[0] : node->child[1];
+    lpm_release_rt(lpm, node);
+    lpm_drop_node(lpm, node);
+    *link = child;
+
+    if(child == 0 && plink)
+    {
+        parent = *plink;
+        if(parent->rt == 0)
+        {
+            *plink = parent->child[0] ? parent->child[0] : parent->child[1];
+            lpm_drop_node(lpm, parent);
+        }
+    }
+    return 1;
+} /* -- sr_lpm_remove -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_lpm_lookup(..)
+ * Scope: Global
+ *
+ * Return the route with the longest prefix covering dst, or 0 if none.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_rt* sr_lpm_lookup(const struct sr_lpm* lpm, uint32_t dst_nbo)
+{
+    const struct sr_lpm_node* node;
+    struct sr_rt* best = 0;
+    uint32_t dst = ntohl(dst_nbo);
+
+    node = lpm->root;
+    while(node)
+    {
+        if((dst ^ node->prefix) & lpm_mask(node->len))
+        { break; }
+        if(node->rt)
+        { best = node->rt; }
+        if(node->len == 32)
+        { break; }
+        node = node->child[lpm_bit(dst, node->len)];
+    }
+
+    return best;
+} /* -- sr_lpm_lookup -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_lpm_lookup_batch(..)
+ * Scope: Global
+ *
+ * sr_lpm_lookup for n destinations, storing each result in out.  Up to
+ * SR_LPM_BATCH_LANES walks run side by side, each taking one step per
+ * round and prefetching the node it steps to, so the cache misses of
+ * one lane are overlapped with the work of the others.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_lpm_lookup_batch(const struct sr_lpm* lpm, const uint32_t* dst_nbo,
+                         unsigned int n, struct sr_rt** out)
+{
+    const struct sr_lpm_node* lane[SR_LPM_BATCH_LANES];
+    const struct sr_lpm_node* node;
+    uint32_t dst[SR_LPM_BATCH_LANES];
+    unsigned int first, lanes, active, i;
+
+    for(first = 0; first < n; first += lanes)
+    {
+        lanes = n - first;
+        if(lanes > SR_LPM_BATCH_LANES)
+        { lanes = SR_LPM_BATCH_LANES; }
+
+        for(i = 0; i < lanes; i++)
+        {
+            dst[i] = ntohl(dst_nbo[first + i]);
+            lane[i] = lpm->root;
+            out[first + i] = 0;
+        }
+
+        active = lpm->root ? lanes : 0;
+        while(active)
+        {
+            active = 0;
+            for(i = 0; i < lanes; i++)
+            {
+                if((node = lane[i]) == 0)
+                { continue; }
+                if((dst[i] ^ node->prefix) & lpm_mask(node->len))
+                { lane[i] = 0; continue; }
+                if(node->rt)
+                { out[first + i] = node->rt; }
+                if(node->len == 32)
+                { lane[i] = 0; continue; }
+                node = node->child[lpm_bit(dst[i], node->len)];
+                if(node)
+                {
+                    __builtin_prefetch(node);
+                    active++;
+                }
+                lane[i] = node;
+            }
+        }
+    }
+} /* -- sr_lpm_lookup_batch -- */
+
+void sr_lpm_iter_init(struct sr_lpm_iter* it, const struct sr_lpm* lpm)
+{
+    it->depth = 0;
+    if(lpm && lpm->root)
+    { it->stack[it->depth++] = lpm->root; }
+} /* -- sr_lpm_iter_init -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_lpm_iter_init_within(..)
+ * Scope: Global
+ *
+ * Walk only the routes whose prefix lies within prefix/len (host byte
+ * order), that one included, in the same order.  Returns the longest
+ * route covering all of prefix/len, which may be the one at prefix/len
+ * itself, or 0 if none does.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_rt* sr_lpm_iter_init_within(struct sr_lpm_iter* it,
+        const struct sr_lpm* lpm, uint32_t prefix, int len)
+{
+    const struct sr_lpm_node* node = lpm ? lpm->root : 0;
+    struct sr_rt* cover = 0;
+
+    it->depth = 0;
+    while(node)
+    {
+        if(node->len >= len)
+        {
+            /* -- the first node at least as long is the subtree's root -- */
+            if(((prefix ^ node->prefix) & lpm_mask(len)) == 0)
+            {
+                it->stack[it->depth++] = node;
+                if(node->len == len && node->rt)
+                { cover = node->rt; }
+            }
+            break;
+        }
+        if((prefix ^ node->prefix) & lpm_mask(node->len))
+        { break; }
+        if(node->rt)
+        { cover = node->rt; }
+        node = node->child[lpm_bit(prefix, node->len)];
+    }
+    return cover;
+} /* -- sr_lpm_iter_init_within -- */
+
+struct sr_rt* sr_lpm_iter_next(struct sr_lpm_iter* it)
+{
+    const struct sr_lpm_node* node;
+
+    while(it->depth > 0)
+    {
+        node = it->stack[--it->depth];
+        if(node->child[1])
+        { it->stack[it->depth++] = node->child[1]; }
+        if(node->child[0])
+        { it->stack[it->depth++] = node->child[0]; }
+        if(node->rt)
+        { return node->rt; }
+    }
+    return 0;
+} /* -- sr_lpm_iter_next -- */
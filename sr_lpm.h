@@ -0,0 +1,117 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_lpm.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Path compressed binary (Patricia) trie used to answer longest prefix
+ * match queries over the routing table.  Every node stores the prefix it
+ * covers and the number of significant bits, so a lookup visits at most
+ * one node per distinct prefix length on the path to the destination
+ * rather than every entry in the table.
+ *
+ * The trie is persistent.  sr_lpm_derive starts a new version that
+ * shares every node with its base; edits then copy only the nodes on the
+ * path from the root to the change.  Once the new version is published
+ * and the base retired, sr_lpm_hand_over tells the base which of its
+ * nodes and routes the successor dropped so the base frees just those.
+ *
+ * The trie owns the routes it holds and releases them with the free_rt
+ * function given at creation.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_LPM_H
+#define SR_LPM_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+struct sr_rt;
+
+/* -- lookups sr_lpm_lookup_batch walks side by side -- */
+#define SR_LPM_BATCH_LANES 16
+
+/* ----------------------------------------------------------------------------
+ * struct sr_lpm_node
+ *
+ * Node in the trie.  prefix is kept in host byte order and masked to len
+ * bits.  rt is 0 for the glue nodes created where two prefixes diverge.
+ * gen is the version that allocated the node (and set rt, for rt_gen);
+ * only nodes of the version being edited may be changed in place.
+ *
+ * -------------------------------------------------------------------------- */
+
+struct sr_lpm_node
+{
+    uint32_t prefix;
+    uint8_t  len;
+    uint32_t gen;
+    uint32_t rt_gen;
+    struct sr_rt* rt;
+    struct sr_lpm_node* child[2];
+};
+
+/* -- growable array of pointers a version must free -- */
+struct sr_lpm_garbage
+{
+    void** ptr;
+    unsigned int n;
+    unsigned int cap;
+};
+
+struct sr_lpm
+{
+    struct sr_lpm_node* root;
+    unsigned int nodes;  /* nodes reachable, glue included */
+    unsigned int routes; /* nodes carrying a route */
+    uint32_t gen;
+    void (*free_rt)(struct sr_rt*);
+    uint8_t shared; /* successor shares our nodes, free only the dead */
+    struct sr_lpm_garbage replaced_nodes; /* base nodes we copied or cut */
+    struct sr_lpm_garbage replaced_rts;   /* base routes we dropped */
+    struct sr_lpm_garbage dead_nodes;     /* ours, dropped by successor */
+    struct sr_lpm_garbage dead_rts;
+};
+
+/* ----------------------------------------------------------------------------
+ * struct sr_lpm_iter
+ *
+ * Preorder walk over the routes in a trie, which visits them sorted by
+ * prefix with shorter prefixes first.
+ *
+ * -------------------------------------------------------------------------- */
+
+struct sr_lpm_iter
+{
+    const struct sr_lpm_node* stack[66];
+    int depth;
+};
+
+struct sr_lpm* sr_lpm_create(void (*free_rt)(struct sr_rt*));
+struct sr_lpm* sr_lpm_derive(const struct sr_lpm* base);
+void sr_lpm_hand_over(struct sr_lpm* base, struct sr_lpm* next);
+void sr_lpm_destroy(struct sr_lpm* lpm);
+void sr_lpm_discard(struct sr_lpm* lpm);
+
+int  sr_lpm_insert(struct sr_lpm* lpm, uint32_t dest_nbo, uint32_t mask_nbo,
+                   struct sr_rt* rt);
+int  sr_lpm_remove(struct sr_lpm* lpm, uint32_t dest_nbo, uint32_t mask_nbo);
+struct sr_rt* sr_lpm_find(const struct sr_lpm* lpm, uint32_t dest_nbo,
+                          uint32_t mask_nbo);
+struct sr_rt* sr_lpm_lookup(const struct sr_lpm* lpm, uint32_t dst_nbo);
+void sr_lpm_lookup_batch(const struct sr_lpm* lpm, const uint32_t* dst_nbo,
+                         unsigned int n, struct sr_rt** out);
+int  sr_lpm_mask_len(uint32_t mask_nbo);
+
+void sr_lpm_iter_init(struct sr_lpm_iter* it, const struct sr_lpm* lpm);
+struct sr_rt* sr_lpm_iter_init_within(struct sr_lpm_iter* it,
+        const struct sr_lpm* lpm, uint32_t prefix, int len);
+struct sr_rt* sr_lpm_iter_next(struct sr_lpm_iter* it);
+
+#endif /* -- SR_LPM_H -- */
@@ -32,6 +32,14 @@
 #include "sr_dumper.h"
 #include "sr_router.h"
 #include "sr_rt.h"
+#include "sr_rcu.h"
+#include "sr_pbuf.h"
+#include "sr_rxring.h"
+#include "sr_txq.h"
+#include "sr_worker.h"
+#include "sr_event.h"
+#include "sr_control.h"
+#include "sr_icmp.h"
 
 extern char* optarg;
 
@@ -45,12 +53,14 @@ extern char* optarg;
 #define DEFAULT_SERVER "171.67.71.18"
 #define DEFAULT_RTABLE "rtable"
 #define DEFAULT_TOPO 0
+#define RT_CHECK_PROBES 100000
 
 static void usage(char* );
 static void sr_init_instance(struct sr_instance* );
 static void sr_destroy_instance(struct sr_instance* );
 static void sr_set_user(struct sr_instance* );
-static void sr_load_rt_wrap(struct sr_instance* sr, char* rtable);
+static void sr_load_rt_wrap(struct sr_instance* sr, char* rtable,
+                            char* snapshot);
 
 /*-----------------------------------------------------------------------------
  *---------------------------------------------------------------------------*/
@@ -67,11 +77,18 @@ int main(int argc, char **argv)
     unsigned int port = DEFAULT_PORT;
     unsigned int topo = DEFAULT_TOPO;
     char *logfile = 0;
+    char *snapshot = 0;
+    unsigned int arp_capacity = 0;
+    unsigned int pbuf_count = 0;
+    unsigned int nworkers = 0;
+    char *control = 0;
+    int check_rt = 0;
+    int fib_mode = SR_FIB_TRIE;
     struct sr_instance sr;
 
      printf("Using %s\n", VERSION_INFO);
 
-     while ((c = getopt(argc, argv, "ha:s:v:p:u:t:r:l:T:")) != EOF)
+     while ((c = getopt(argc, argv, "ha:s:v:p:u:t:r:l:T:cF:W:A:B:w:C:")) != EOF)
     {
         switch (c)
         {
@@ -106,16 +123,58 @@ int main(int argc, char **argv)
             case 'T':
                 template = optarg;
                 break;
+            case 'c':
+                check_rt = 1;
+                break;
+            case 'A':
+                arp_capacity = atoi((char *) optarg);
+                break;
+            case 'B':
+                pbuf_count = atoi((char *) optarg);
+                break;
+            case 'w':
+                nworkers = atoi((char *) optarg);
+                if(nworkers > SR_WORKER_MAX)
+                {
+                    usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'W':
+                snapshot = optarg;
+                break;
+            case 'C':
+                control = optarg;
+                break;
+            case 'F':
+                if((fib_mode = sr_rt_parse_fib_mode(optarg)) < 0)
+                {
+                    usage(argv[0]);
+                    exit(1);
+                }
+                break;
         } /* switch */
     } /* -- while -- */
 
     /* -- zero out sr instance -- */
     sr_init_instance(&sr);
+    sr.fib_mode = fib_mode;
+    sr.arp_capacity = arp_capacity;
+    sr.nworkers = nworkers;
+
+    /* -- packet buffers, before any packet is read -- */
+    if((sr.pbufs = sr_pbuf_pool_create(pbuf_count)) == 0)
+    {
+        fprintf(stderr,"Error allocating packet buffers\n");
+        exit(1);
+    }
 
     /* -- set up routing table from file -- */
     if(template == NULL) {
         sr.template[0] = '\0';
-        sr_load_rt_wrap(&sr, rtable);
+        sr_load_rt_wrap(&sr, rtable, snapshot);
+        if(check_rt)
+        { sr_rt_check_lookup(&sr, RT_CHECK_PROBES); }
     }
     else
         strncpy(sr.template, template, 30);
@@ -155,12 +214,21 @@ int main(int argc, char **argv)
 
     if(template != NULL) { /* we've recv'd the rtable now, so read it in */
         Debug("Connected to new instantiation of topology template %s\n", template);
-        sr_load_rt_wrap(&sr, "rtable.vrhost");
+        sr_load_rt_wrap(&sr, "rtable.vrhost", snapshot);
+        if(check_rt)
+        { sr_rt_check_lookup(&sr, RT_CHECK_PROBES); }
     }
 
     /* call router init (for arp subsystem etc.) */
     sr_init(&sr);
 
+    /* -- served from the same loop as the server, see sr_control.h -- */
+    if(control && (sr.control = sr_control_open(&sr, control)) == 0)
+    {
+        fprintf(stderr,"Error opening control socket %s\n", control);
+        exit(1);
+    }
+
     /* -- whizbang main loop ;-) */
     while( sr_read_from_server(&sr) == 1);
 
@@ -180,7 +248,13 @@ static void usage(char* argv0)
     printf("Format: %s [-h] [-v host] [-s server] [-p port] \n",argv0);
     printf("           [-T template_name] [-u username] [-a auth_key_filename]\n");
     printf("           [-t topo id] [-r routing table] \n");
-    printf("           [-l log file] \n");
+    printf("           [-l log file] [-c check route lookup] \n");
+    printf("           [-F list|trie|dir248 route lookup structure] \n");
+    printf("           [-W write routing table snapshot to file] \n");
+    printf("           [-A ARP cache entries] [-B packet buffers] \n");
+    printf("           [-w forwarding worker threads, up to %d] \n",
+            SR_WORKER_MAX);
+    printf("           [-C control socket path] \n");
     printf("   defaults server=%s port=%d host=%s  \n",
             DEFAULT_SERVER, DEFAULT_PORT, DEFAULT_HOST );
 } /* -- usage -- */
@@ -227,6 +301,32 @@ static void sr_destroy_instance(struct sr_instance* sr)
         sr_dump_close(sr->logfile);
     }
 
+    if(sr->control)
+    {
+        sr_control_close(sr->control);
+        sr->control = 0;
+    }
+
+    /* -- workers first, they hold packet buffers -- */
+    if(sr->workers)
+    {
+        sr_workers_print(sr->workers);
+        sr_workers_destroy(sr->workers);
+        sr->workers = 0;
+    }
+
+    /* -- how well reads and sends were batched, and buffers held up -- */
+    if(sr->loop)
+    { sr_event_loop_print(sr->loop); }
+    if(sr->rx)
+    { sr_rxring_print(sr->rx); }
+    if(sr->txq)
+    { sr_txq_print(sr->txq); }
+    if(sr->pbufs)
+    { sr_pbuf_pool_print(sr->pbufs); }
+    if(sr->icmp)
+    { sr_icmp_print(sr->icmp); }
+
     fprintf(stderr,"sr_destroy_instance leaking memory\n");
 } /* -- sr_destroy_instance -- */
 
@@ -247,7 +347,31 @@ static void sr_init_instance(struct sr_instance* sr)
     sr->host[0] = 0;
     sr->topo_id = 0;
     sr->if_list = 0;
-    sr->routing_table = 0;
+    sr->if_array = 0;
+    sr->if_count = 0;
+    sr->fib = 0;
+    sr->fib_mode = SR_FIB_TRIE;
+    pthread_mutex_init(&sr->fib_lock, 0);
+    sr->ospf_routes = 0;
+    sr->arp_cache = 0;
+    sr->arp_capacity = 0;
+    sr->pbufs = 0;
+    sr->rx = 0;
+    sr->txq = 0;
+    sr->nworkers = 0;
+    sr->workers = 0;
+    sr->timers = 0;
+    sr->loop = 0;
+    sr->server_ev = 0;
+    sr->control = 0;
+    sr->reclaim = 0;
+    sr->dispatch = 0;
+    sr->icmp = 0;
+    sr->ospf_subsys = 0;
+    sr->rcu = (struct sr_rcu*)malloc(sizeof(struct sr_rcu));
+    assert(sr->rcu);
+    sr_rcu_init(sr->rcu);
+    sr->fwd_reader = sr_rcu_register(sr->rcu);
     sr->logfile = 0;
     sr->hw_init = 0;
 } /* -- sr_init_instance -- */
@@ -269,50 +393,36 @@ static void sr_init_instance(struct sr_instance* sr)
 
 int sr_verify_routing_table(struct sr_instance* sr)
 {
-    struct sr_rt* rt_walker = 0;
-    struct sr_if* if_walker = 0;
-    int ret = 0;
-
     /* -- REQUIRES --*/
     assert(sr);
 
-    if( (sr->if_list == 0) || (sr->routing_table == 0))
+    if( (sr->if_list == 0) || (sr_fib_size(sr_rt_table(sr)) == 0))
     {
         return 0; /* assume empty */
     }
 
-    rt_walker = sr->routing_table;
-
-    while(rt_walker)
-    {
-        /* -- check to see if interface exists -- */
-        if_walker = sr->if_list;
-        while(if_walker)
-        {
-            if( strncmp(if_walker->name,rt_walker->interface,SR_IFACE_NAMELEN)
-                    == 0)
-            { break; }
-            if_walker = if_walker->next;
-        }
-        if(if_walker == 0)
-        { ret++; } /* -- interface not found! -- */
-
-        rt_walker = rt_walker->next;
-    } /* -- while -- */
-
-    return ret;
+    /* -- resolve each entry's interface, counting the ones not found -- */
+    return sr_rt_bind_interfaces(sr);
 } /* -- sr_verify_routing_table -- */
 
-static void sr_load_rt_wrap(struct sr_instance* sr, char* rtable) {
+static void sr_load_rt_wrap(struct sr_instance* sr, char* rtable,
+                            char* snapshot) {
     if(sr_load_rt(sr, rtable) != 0) {
         fprintf(stderr,"Error setting up routing table from file %s\n",
                 rtable);
         exit(1);
     }
 
+    if(snapshot && sr_rt_save_snapshot(sr, snapshot) != 0) {
+        fprintf(stderr,"Error writing routing table snapshot %s\n",
+                snapshot);
+        exit(1);
+    }
+
 
     printf("Loading routing table\n");
     printf("---------------------------------------------\n");
     sr_print_routing_table(sr);
     printf("---------------------------------------------\n");
+    sr_rt_print_index_stats(sr);
 }
@@ -0,0 +1,264 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_pbuf.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Packet buffer pool, see sr_pbuf.h.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "sr_pbuf.h"
+
+/* -- free buffers of the pool this thread last allocated from -- */
+static __thread struct
+{
+    struct sr_pbuf_pool* pool;
+    struct sr_pbuf* head;
+    unsigned int n;
+} pbuf_cache;
+
+/* -- move up to n buffers from the thread cache to the pool -- */
+static void pbuf_cache_drain(unsigned int n)
+{
+    struct sr_pbuf_pool* pool = pbuf_cache.pool;
+    struct sr_pbuf* pb;
+
+    pthread_mutex_lock(&pool->lock);
+    while(n-- && (pb = pbuf_cache.head) != 0)
+    {
+        pbuf_cache.head = pb->next;
+        pbuf_cache.n--;
+        pb->next = pool->free_list;
+        pool->free_list = pb;
+        pool->nfree++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+} /* -- pbuf_cache_drain -- */
+
+/* -- move up to half a cache of buffers from the pool, returns how many -- */
+static unsigned int pbuf_cache_refill(struct sr_pbuf_pool* pool)
+{
+    struct sr_pbuf* pb;
+    unsigned int n = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while(n < SR_PBUF_CACHE / 2 && (pb = pool->free_list) != 0)
+    {
+        pool->free_list = pb->next;
+        pb->next = pbuf_cache.head;
+        pbuf_cache.head = pb;
+        n++;
+    }
+    pool->nfree -= n;
+    if(pool->nfree < pool->low_water)
+    { pool->low_water = pool->nfree; }
+    pthread_mutex_unlock(&pool->lock);
+
+    pbuf_cache.n += n;
+    return n;
+} /* -- pbuf_cache_refill -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pbuf_pool_create(..)
+ * Scope: Global
+ *
+ * Allocate a pool of count buffers, 0 for the default.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_pbuf_pool* sr_pbuf_pool_create(unsigned int count)
+{
+    struct sr_pbuf_pool* pool;
+    void* slab;
+    unsigned int i;
+
+    if(count == 0)
+    { count = SR_PBUF_DEFAULT_COUNT; }
+
+    pool = (struct sr_pbuf_pool*)calloc(1, sizeof(struct sr_pbuf_pool));
+    assert(pool);
+    if(posix_memalign(&slab, SR_PBUF_ALIGN, count * sizeof(struct sr_pbuf)))
+    {
+        free(pool);
+        return 0;
+    }
+    pool->slab = (struct sr_pbuf*)slab;
+    pool->count = count;
+    pthread_mutex_init(&pool->lock, 0);
+
+    for(i = count; i-- > 0; )
+    {
+        pool->slab[i].pool = pool;
+        pool->slab[i].next = pool->free_list;
+        pool->free_list = &pool->slab[i];
+    }
+    pool->nfree = pool->low_water = count;
+    return pool;
+} /* -- sr_pbuf_pool_create -- */
+
+/* -- every buffer must have been put back -- */
+void sr_pbuf_pool_destroy(struct sr_pbuf_pool* pool)
+{
+    if(pool == 0)
+    { return; }
+    if(pbuf_cache.pool == pool)
+    {
+        pbuf_cache.pool = 0;
+        pbuf_cache.head = 0;
+        pbuf_cache.n = 0;
+    }
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->slab);
+    free(pool);
+} /* -- sr_pbuf_pool_destroy -- */
+
+void sr_pbuf_pool_print(struct sr_pbuf_pool* pool)
+{
+    printf("Packet buffers: %u of %u bytes, %u free in the pool, "
+           "at least %u free so far, %lu allocations found it empty\n",
+           pool->count, SR_PBUF_SIZE, pool->nfree, pool->low_water,
+           pool->exhausted);
+} /* -- sr_pbuf_pool_print -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pbuf_alloc(..)
+ * Scope: Global
+ *
+ * A buffer with one reference and no data, or 0 if the pool is empty.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_pbuf* sr_pbuf_alloc(struct sr_pbuf_pool* pool)
+{
+    struct sr_pbuf* pb;
+
+    if(pool == 0)
+    { return 0; }
+    if(pbuf_cache.pool != pool)
+    {
+        sr_pbuf_thread_flush();
+        pbuf_cache.pool = pool;
+    }
+    if(pbuf_cache.head == 0 && pbuf_cache_refill(pool) == 0)
+    {
+        __atomic_add_fetch(&pool->exhausted, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    pb = pbuf_cache.head;
+    pbuf_cache.head = pb->next;
+    pbuf_cache.n--;
+
+    pb->next = 0;
+    pb->refcnt = 1;
+    pb->off = SR_PBUF_HEADROOM;
+    pb->len = 0;
+    pb->if_index = -1;
+    pb->out_index = -1;
+    pb->ready = 0;
+    return pb;
+} /* -- sr_pbuf_alloc -- */
+
+void sr_pbuf_hold(struct sr_pbuf* pb)
+{
+    __atomic_add_fetch(&pb->refcnt, 1, __ATOMIC_RELAXED);
+} /* -- sr_pbuf_hold -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pbuf_put(..)
+ * Scope: Global
+ *
+ * Drop a reference, freeing the buffer with the last one.  It goes to
+ * this thread's cache if the cache belongs to its pool, else straight
+ * back to the pool.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_pbuf_put(struct sr_pbuf* pb)
+{
+    struct sr_pbuf_pool* pool = pb->pool;
+
+    if(__atomic_sub_fetch(&pb->refcnt, 1, __ATOMIC_ACQ_REL) != 0)
+    { return; }
+
+    if(pbuf_cache.pool == 0)
+    { pbuf_cache.pool = pool; }
+    if(pbuf_cache.pool == pool)
+    {
+        if(pbuf_cache.n >= SR_PBUF_CACHE)
+        { pbuf_cache_drain(SR_PBUF_CACHE / 2); }
+        pb->next = pbuf_cache.head;
+        pbuf_cache.head = pb;
+        pbuf_cache.n++;
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pb->next = pool->free_list;
+    pool->free_list = pb;
+    pool->nfree++;
+    pthread_mutex_unlock(&pool->lock);
+} /* -- sr_pbuf_put -- */
+
+/* -- give this thread's cached buffers back, e.g. before it exits -- */
+void sr_pbuf_thread_flush(void)
+{
+    if(pbuf_cache.pool == 0)
+    { return; }
+    pbuf_cache_drain(pbuf_cache.n);
+    pbuf_cache.pool = 0;
+} /* -- sr_pbuf_thread_flush -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pbuf_of(..)
+ * Scope: Global
+ *
+ * The buffer of pool that data points into, or 0 if it is not in one.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_pbuf* sr_pbuf_of(struct sr_pbuf_pool* pool, const void* data)
+{
+    uintptr_t p = (uintptr_t)data;
+    uintptr_t base;
+
+    if(pool == 0)
+    { return 0; }
+    base = (uintptr_t)pool->slab;
+    if(p < base || p >= base + pool->count * sizeof(struct sr_pbuf))
+    { return 0; }
+    return &pool->slab[(p - base) / sizeof(struct sr_pbuf)];
+} /* -- sr_pbuf_of -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_pbuf_claim(..)
+ * Scope: Global
+ *
+ * A reference to a buffer holding the len bytes at data: the buffer
+ * they are already the data of, or else a new one they are copied
+ * into after the headroom.  Returns 0 if a copy was needed and could not be made.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_pbuf* sr_pbuf_claim(struct sr_pbuf_pool* pool, const uint8_t* data,
+                              unsigned int len)
+{
+    struct sr_pbuf* pb = sr_pbuf_of(pool, data);
+
+    if(pb && data == sr_pbuf_data(pb) && len == pb->len)
+    {
+        sr_pbuf_hold(pb);
+        return pb;
+    }
+    if(len > SR_PBUF_SIZE - SR_PBUF_HEADROOM || (pb = sr_pbuf_alloc(pool)) == 0)
+    { return 0; }
+    memcpy(sr_pbuf_data(pb), data, len);
+    pb->len = len;
+    return pb;
+} /* -- sr_pbuf_claim -- */
@@ -0,0 +1,104 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_pbuf.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Packet buffer pool.  Buffers of SR_PBUF_SIZE bytes are carved out of
+ * one cache aligned slab when the pool is created; nothing is allocated
+ * afterwards.  Each thread keeps up to SR_PBUF_CACHE free buffers to
+ * itself, so allocating and freeing touch the shared free list, under
+ * its lock, only once every SR_PBUF_CACHE / 2 buffers.
+ *
+ * Buffers are reference counted.  Whoever wants to keep a buffer beyond
+ * the call it was lent for takes a reference with sr_pbuf_hold, and
+ * every reference is dropped with sr_pbuf_put; the last one returns the
+ * buffer to the pool.  An empty pool makes sr_pbuf_alloc return 0 and
+ * is counted, so callers can fall back or drop.
+ *
+ * A new buffer's data starts SR_PBUF_HEADROOM bytes in, leaving room to
+ * put a link header such as the VNS one in front of a frame in place.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_PBUF_H
+#define SR_PBUF_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include <pthread.h>
+
+#define SR_PBUF_SIZE          2048  /* data bytes in a buffer */
+#define SR_PBUF_DEFAULT_COUNT 4096
+#define SR_PBUF_CACHE         64    /* free buffers a thread keeps */
+#define SR_PBUF_ALIGN         64    /* cache line */
+#define SR_PBUF_HEADROOM      32    /* in front of the data of a new buffer */
+
+/* ----------------------------------------------------------------------------
+ * struct sr_pbuf
+ *
+ * One buffer.  off and len describe the data in buf that the holder is
+ * working on, for a queued packet the Ethernet frame.
+ *
+ * -------------------------------------------------------------------------- */
+
+struct sr_pbuf
+{
+    struct sr_pbuf* next;        /* free list, or the queue of its holder */
+    struct sr_pbuf_pool* pool;
+    uint32_t refcnt;
+    uint16_t off;                /* data starts at buf + off */
+    uint16_t len;
+    int if_index;                /* sr_if.index it arrived on, or -1 */
+    int out_index;               /* sr_if.index it was routed to, or -1 */
+    uint32_t nexthop;            /* and the next hop, network byte order */
+    int ready;                   /* headed for it, TTL and header done */
+    uint8_t buf[SR_PBUF_SIZE] __attribute__((aligned(SR_PBUF_ALIGN)));
+};
+
+struct sr_pbuf_pool
+{
+    struct sr_pbuf* slab;
+    unsigned int count;
+    pthread_mutex_t lock;        /* guards free_list and nfree */
+    struct sr_pbuf* free_list;
+    unsigned int nfree;          /* on free_list, thread caches aside */
+    unsigned int low_water;      /* fewest nfree has been */
+    unsigned long exhausted;     /* allocations that found it empty */
+};
+
+struct sr_pbuf_pool* sr_pbuf_pool_create(unsigned int count);
+void sr_pbuf_pool_destroy(struct sr_pbuf_pool* pool);
+void sr_pbuf_pool_print(struct sr_pbuf_pool* pool);
+
+struct sr_pbuf* sr_pbuf_alloc(struct sr_pbuf_pool* pool);
+void sr_pbuf_hold(struct sr_pbuf* pb);
+void sr_pbuf_put(struct sr_pbuf* pb);
+void sr_pbuf_thread_flush(void);
+
+struct sr_pbuf* sr_pbuf_of(struct sr_pbuf_pool* pool, const void* data);
+struct sr_pbuf* sr_pbuf_claim(struct sr_pbuf_pool* pool, const uint8_t* data,
+                              unsigned int len);
+
+/* -- first byte of the data the holder is working on -- */
+static inline uint8_t* sr_pbuf_data(struct sr_pbuf* pb)
+{
+    return pb->buf + pb->off;
+} /* -- sr_pbuf_data -- */
+
+/* -- bytes of pb in front of data, 0 if data is not in pb -- */
+static inline unsigned int sr_pbuf_headroom(const struct sr_pbuf* pb,
+                                            const uint8_t* data)
+{
+    if(data < pb->buf || data > pb->buf + SR_PBUF_SIZE)
+    { return 0; }
+    return data - pb->buf;
+} /* -- sr_pbuf_headroom -- */
+
+#endif /* -- SR_PBUF_H -- */
@@ -120,6 +120,50 @@ struct sr_ethernet_hdr
 #define IPPROTO_ICMP            0x0001  /* ICMP protocol */
 #endif
 
+#ifndef IPPROTO_OSPF
+#define IPPROTO_OSPF            0x0059  /* OSPF, and PWOSPF */
+#endif
+
+#ifndef ICMP_ECHOREPLY
+#define ICMP_ECHOREPLY          0       /* echo reply */
+#endif
+
+#ifndef ICMP_UNREACH
+#define ICMP_UNREACH            3       /* destination unreachable */
+#endif
+
+#ifndef ICMP_UNREACH_NET
+#define ICMP_UNREACH_NET        0       /* bad net */
+#endif
+
+#ifndef ICMP_UNREACH_HOST
+#define ICMP_UNREACH_HOST       1       /* bad host */
+#endif
+
+#ifndef ICMP_UNREACH_PROTOCOL
+#define ICMP_UNREACH_PROTOCOL   2       /* bad protocol */
+#endif
+
+#ifndef ICMP_UNREACH_PORT
+#define ICMP_UNREACH_PORT       3       /* bad port */
+#endif
+
+#ifndef ICMP_UNREACH_NEEDFRAG
+#define ICMP_UNREACH_NEEDFRAG   4       /* IP_DF caused drop */
+#endif
+
+#ifndef ICMP_ECHO
+#define ICMP_ECHO               8       /* echo request */
+#endif
+
+#ifndef ICMP_TIMXCEED
+#define ICMP_TIMXCEED           11      /* time exceeded */
+#endif
+
+#ifndef ICMP_TIMXCEED_INTRANS
+#define ICMP_TIMXCEED_INTRANS   0       /* ttl==0 in transit */
+#endif
+
 #ifndef ETHERTYPE_IP
 #define ETHERTYPE_IP            0x0800  /* IP protocol */
 #endif
@@ -12,19 +12,22 @@
 #include "pwospf_protocol.h"
 #include "sr_if.h"
 #include "sr_rt.h"
+#include "sr_pbuf.h"
+#include "sr_cksum.h"
+#include "sr_timer.h"
 
 #include <stdio.h>
 #include <unistd.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <arpa/inet.h>
 #include <time.h>
 
-
-/* -- declaration of main thread function for pwospf subsystem --- */
-static void* pwospf_run_thread(void* arg);
-static void* pwospf_run_thread_LSU(void* arg);
+static void pwospf_hello_fired(struct sr_timer* timer, void* arg);
+static void pwospf_lsu_fired(struct sr_timer* timer, void* arg);
+static void pwospf_neighbor_fired(struct sr_timer* timer, void* arg);
 
 /*---------------------------------------------------------------------
  * Method: pwospf_init(..)
@@ -32,152 +35,151 @@ static void* pwospf_run_thread_LSU(void* arg);
  * Sets up the internal data structures for the pwospf subsystem
  *
  * You may assume that the interfaces have been created and initialized
- * by this point.
+ * by this point.  Hellos and LSUs go out from timers on the packet
+ * thread's wheel, so the protocol state is only ever touched from that
+ * thread and needs no lock.
  *---------------------------------------------------------------------*/
 
 int pwospf_init(struct sr_instance* sr)
 {
-    assert(sr);
+    struct pwospf_subsys* subsys;
 
-    sr->ospf_subsys = (struct pwospf_subsys*)malloc(sizeof(struct
-                                                      pwospf_subsys));
+    assert(sr && sr->timers);
 
-    assert(sr->ospf_subsys);
-    //If the router is loaded a full routing table, enable OSPF protocol
-    if(sr->routing_table != NULL && (sr->routing_table)->next != NULL) return 0;
-    pthread_mutex_init(&(sr->ospf_subsys->lock), 0);
-    pthread_mutex_init(&(sr->ospf_subsys->lock_LSU), 0);
+    subsys = (struct pwospf_subsys*)calloc(1, sizeof(struct pwospf_subsys));
+    assert(subsys);
+    subsys->sr = sr;
+    sr_timer_init(&subsys->hello, pwospf_hello_fired, subsys);
+    sr_timer_init(&subsys->lsu, pwospf_lsu_fired, subsys);
+    sr_timer_init(&subsys->neighbor, pwospf_neighbor_fired, subsys);
+    sr->ospf_subsys = subsys;
 
+    //If the router is loaded a full routing table, enable OSPF protocol
+    if(sr_fib_size(sr_rt_table(sr)) > 1) return 0;
 
-    /* -- handle subsystem initialization here! -- */
-
-    /* -- start thread subsystem -- */
-    if( pthread_create(&sr->ospf_subsys->thread, 0, pwospf_run_thread, sr)) {
-        perror("pthread_create");
-        assert(0);
-    }
-    
-    if( pthread_create(&sr->ospf_subsys->thread_LSU, 0, pwospf_run_thread_LSU, sr)) {
-        perror("pthread_LSU_create");
-        assert(0);
-    }
+    //first hello right away, first LSU once neighbors have had time to answer
+    sr_timer_arm(sr->timers, &subsys->hello, sr_timer_now_ms(), 0);
+    sr_timer_arm(sr->timers, &subsys->lsu, sr_timer_now_ms(),
+                 OSPF_DEFAULT_LSUINT * 1000);
 
     return 0; /* success */
 } /* -- pwospf_init -- */
 
-
-/*---------------------------------------------------------------------
- * Method: pwospf_lock
- *
- * Lock mutex associated with pwospf_subsys
- *
- *---------------------------------------------------------------------*/
-
-void pwospf_lock(struct pwospf_subsys* subsys)
+/* -- say hello on every interface, every OSPF_DEFAULT_HELLOINT -- */
+static void pwospf_hello_fired(struct sr_timer* timer, void* arg)
 {
-    if ( pthread_mutex_lock(&subsys->lock) )
-    { assert(0); }
-} /* -- pwospf_subsys -- */
+    struct pwospf_subsys* subsys = (struct pwospf_subsys*)arg;
+    struct sr_instance* sr = subsys->sr;
 
-/*---------------------------------------------------------------------
- * Method: pwospf_unlock
- *
- * Unlock mutex associated with pwospf subsystem
- *
- *---------------------------------------------------------------------*/
+    send_hello(sr);
+    sr_timer_arm(sr->timers, timer, sr_timer_wheel_now(sr->timers),
+                 OSPF_DEFAULT_HELLOINT * 1000);
+} /* -- pwospf_hello_fired -- */
 
-void pwospf_unlock(struct pwospf_subsys* subsys)
+/* -- flood our links, every OSPF_DEFAULT_LSUINT -- */
+static void pwospf_lsu_fired(struct sr_timer* timer, void* arg)
 {
-    if ( pthread_mutex_unlock(&subsys->lock) )
-    { assert(0); }
-} /* -- pwospf_subsys -- */
+    struct pwospf_subsys* subsys = (struct pwospf_subsys*)arg;
+    struct sr_instance* sr = subsys->sr;
+
+    send_LSU(sr);
+    sr_timer_arm(sr->timers, timer, sr_timer_wheel_now(sr->timers),
+                 OSPF_DEFAULT_LSUINT * 1000);
+} /* -- pwospf_lsu_fired -- */
 
 /*---------------------------------------------------------------------
- * Method: pwospf_lock_LSU
+ * Method: pwospf_neighbor_arm
  *
- * Lock mutex associated with pwospf_LSU
+ * Set the neighbor timer for when the neighbor heard from longest ago
+ * times out, or leave it off if there are no neighbors.
  *
  *---------------------------------------------------------------------*/
 
-void pwospf_lock_LSU(struct pwospf_subsys* subsys)
+static void pwospf_neighbor_arm(struct pwospf_subsys* subsys)
 {
-    if ( pthread_mutex_lock(&subsys->lock_LSU) )
-    { assert(0); }
-} /* -- pwospf_subsys -- */
-
-/*---------------------------------------------------------------------
- * Method: pwospf_unlock_LSU
- *
- * Unlock mutex associated with pwospf LSU
- *
- *---------------------------------------------------------------------*/
+    struct sr_instance* sr = subsys->sr;
+    struct sr_if* ifs;
+    time_t oldest = 0, now = time(NULL);
+    int found = 0;
+
+    for(ifs = sr->if_list; ifs != NULL; ifs = ifs->next){
+        if(ifs->neighbors == NULL) continue;
+        if(!found || ifs->neighbors->update_time < oldest)
+            oldest = ifs->neighbors->update_time;
+        found = 1;
+    }
+    if(!found){
+        sr_timer_cancel(sr->timers, &subsys->neighbor);
+        return;
+    }
+    oldest += OSPF_NEIGHBOR_TIMEOUT;
+    sr_timer_arm(sr->timers, &subsys->neighbor, sr_timer_wheel_now(sr->timers),
+                 oldest > now ? (unsigned int)(oldest - now) * 1000 : 0);
+} /* -- pwospf_neighbor_arm -- */
 
-void pwospf_unlock_LSU(struct pwospf_subsys* subsys)
+static void pwospf_neighbor_fired(struct sr_timer* timer, void* arg)
 {
-    if ( pthread_mutex_unlock(&subsys->lock_LSU) )
-    { assert(0); }
-} /* -- pwospf_subsys -- */
+    struct pwospf_subsys* subsys = (struct pwospf_subsys*)arg;
+
+    clear_hello_result(subsys->sr);
+    pwospf_neighbor_arm(subsys);
+} /* -- pwospf_neighbor_fired -- */
 
 /*---------------------------------------------------------------------
- * Method: pwospf_run_thread
+ * Method: pwospf_neighbor_seen
  *
- * Main thread of pwospf subsystem.
+ * A hello from rid at ip came in on iface: record the neighbor, new or
+ * not, and make sure the timer that expires neighbors is running.
  *
  *---------------------------------------------------------------------*/
 
-static void* pwospf_run_thread(void* arg)
+void pwospf_neighbor_seen(struct sr_instance* sr, struct sr_if* iface,
+                          uint32_t rid, uint32_t ip)
 {
-    struct sr_instance* sr = (struct sr_instance*)arg;
+    //new neighbor
+    if(iface->neighbors == NULL){
+        iface->neighbors = (struct neighbor_router*)malloc(sizeof(struct neighbor_router));
+        assert(iface->neighbors);
+    }
+    iface->neighbors->neighbor_RID = rid;
+    iface->neighbors->neighbor_IP = ip;
+    iface->neighbors->update_time = time(NULL);
 
-    while(1)
-    {
-        /* -- PWOSPF subsystem functionality should start  here! -- */
+    //a later update only pushes the expiry back, the timer sorts that out
+    if(sr->ospf_subsys && !sr_timer_armed(&sr->ospf_subsys->neighbor))
+        pwospf_neighbor_arm(sr->ospf_subsys);
+} /* -- pwospf_neighbor_seen -- */
 
-        pwospf_lock(sr->ospf_subsys);
-        
-        //send hello message
-        send_hello(sr);
-        sleep(OSPF_DEFAULT_HELLOINT);
-        
-        pwospf_unlock(sr->ospf_subsys);
-    };
-    return NULL;
-} /* -- run_ospf_thread -- */
-
-static void* pwospf_run_thread_LSU(void* arg)
+/* -- list the neighbors heard from, for the control socket -- */
+void pwospf_print_neighbors(struct sr_instance* sr)
 {
-    struct sr_instance* sr = (struct sr_instance*)arg;
-
-    while(1)
-    {
-        /* -- PWOSPF subsystem functionality should start  here! -- */
-
-        pwospf_lock_LSU(sr->ospf_subsys);
-        (sr->lsuint)--;
-        sleep(1);
-        //send hello message
-        if(sr->lsuint <= 0){
-            send_LSU(sr);
-            sr->lsuint = (uint16_t)OSPF_DEFAULT_LSUINT;
-        }
-        
-        pwospf_unlock_LSU(sr->ospf_subsys);
-    };
-    return NULL;
-} /* -- run_ospf_thread -- */
-
-uint16_t ospf_checksum(uint8_t* start, unsigned long length){
-    uint16_t* temp;
-    uint32_t check = 0;
-    int i = 0, byte_num = length * 2;
-    for(i = 0;i < byte_num;i++){
-        if(i <= 11 && i >= 8) check += ntohs(*(uint16_t*)(start+i*2));
+    struct sr_if* ifs;
+    struct in_addr rid, ip;
+    time_t now = time(NULL);
+
+    for(ifs = sr->if_list; ifs != NULL; ifs = ifs->next){
+        if(ifs->neighbors == NULL) continue;
+        rid.s_addr = ifs->neighbors->neighbor_RID;
+        ip.s_addr = ifs->neighbors->neighbor_IP;
+        printf("%-8s router %s", ifs->name, inet_ntoa(rid));
+        printf(" at %s, heard from %lds ago\n", inet_ntoa(ip),
+               (long)(now - ifs->neighbors->update_time));
     }
-    check = (check & 0xffff) + (check >> 16);
-    temp = (uint16_t*)(&check);
-    *temp = htons(*temp);
-    *temp = (*temp) ^ 0xffff;
-    return *temp;
+} /* -- pwospf_print_neighbors -- */
+
+/*---------------------------------------------------------------------
+* Method: ospf_checksum
+* Checksum of the length byte PWOSPF packet at start, skipping the 64 bit
+* authentication field as OSPF does; 0 over a packet that is intact
+*---------------------------------------------------------------------*/
+uint16_t ospf_checksum(uint8_t* start, unsigned int length){
+    int auth = offsetof(struct ospfv2_hdr, audata);
+    uint32_t sum;
+    //add up both sides of the field, sr_cksum hands back the sum inverted
+    sum = (uint16_t)~sr_cksum(start, auth);
+    sum += (uint16_t)~sr_cksum(start + auth + 8, length - auth - 8);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)~sum;
 }
 
 void clear_hello_result(struct sr_instance *sr){
@@ -198,15 +200,17 @@ void send_hello(struct sr_instance *sr){
     struct ip* ip_hdr = NULL;
     struct ospfv2_hdr* ospf_hdr = NULL;
     struct ospfv2_hello_hdr* hello_hdr = NULL;
-    struct in_addr* temp;
+    struct sr_pbuf* pb;
     int len = 0, i = 0;
     
-    clear_hello_result(sr);
-    
     while(ifs != NULL){
         len = sizeof(struct sr_ethernet_hdr) + sizeof(struct ip) +
         sizeof(struct ospfv2_hdr) + sizeof(struct ospfv2_hello_hdr);
-        packet = (uint8_t*)malloc(len);
+        if((pb = sr_pbuf_alloc(sr->pbufs)) == NULL){
+            ifs = ifs->next;
+            continue;
+        }
+        packet = sr_pbuf_data(pb);
         
         //ethernet
         ethernet_hdr = (struct sr_ethernet_hdr*)packet;
@@ -224,12 +228,8 @@ void send_hello(struct sr_instance *sr){
         ip_hdr->ip_off = 0;
         ip_hdr->ip_ttl = 255;
         ip_hdr->ip_p = 0x89;       //ospf
-        temp = (struct in_addr*)malloc(sizeof(struct in_addr));
-        temp->s_addr = ifs->ip;
-        ip_hdr->ip_src = *temp;
-        temp = (struct in_addr*)malloc(sizeof(struct in_addr));
-        temp->s_addr = htonl(OSPF_AllSPFRouters);
-        ip_hdr->ip_dst = *temp;
+        ip_hdr->ip_src.s_addr = ifs->ip;
+        ip_hdr->ip_dst.s_addr = htonl(OSPF_AllSPFRouters);
         ip_hdr->ip_sum = 0;
         ip_hdr->ip_sum = calculate_checksum((uint8_t*)ip_hdr, ip_hdr->ip_hl);
         
@@ -242,16 +242,19 @@ void send_hello(struct sr_instance *sr){
         ospf_hdr->aid = sr->AID;
         ospf_hdr->autype = 0;
         ospf_hdr->audata = 0;
+        ospf_hdr->csum = 0;
         
         //hello_hdr
         hello_hdr = (struct ospfv2_hello_hdr*)(packet + sizeof(struct sr_ethernet_hdr) + sizeof(struct ip) + sizeof(struct ospfv2_hdr));
         hello_hdr->nmask = ifs->mask;
         hello_hdr->helloint = htons(ifs->helloint);
         hello_hdr->padding = 0;
-        ospf_hdr->csum = ospf_checksum((uint8_t*)ospf_hdr, htons(ospf_hdr->len) / 4);
-        sr_send_packet(sr, packet, len, ifs->name);
+        ospf_hdr->csum = ospf_checksum((uint8_t*)ospf_hdr, ntohs(ospf_hdr->len));
+        sr_send_packet_if(sr, packet, len, ifs);
+        sr_pbuf_put(pb);
         ifs = ifs->next;
     }
+    sr_send_flush(sr);
 }
 
 void send_LSU(struct sr_instance* sr){
@@ -261,10 +264,10 @@ void send_LSU(struct sr_instance* sr){
     struct ip* ip_hdr = NULL;
     struct ospfv2_hdr* ospf_hdr = NULL;
     struct ospfv2_lsu_hdr* lsu_hdr = NULL;
-    struct in_addr* temp;
     int len = 0, i = 0;
     uint32_t interface_num = 0;
     uint32_t *temp_space  = NULL;
+    struct sr_pbuf *pb, *last = NULL;
     while(if_temp != NULL){
         if_temp = if_temp->next;
         interface_num++;
@@ -288,7 +291,11 @@ void send_LSU(struct sr_instance* sr){
     while(ifs != NULL){
         len = sizeof(struct sr_ethernet_hdr) + sizeof(struct ip) +
         sizeof(struct ospfv2_hdr) + sizeof(struct ospfv2_lsu_hdr) + interface_num*12;
-        packet = (uint8_t*)malloc(len);
+        if(len > SR_PBUF_SIZE - SR_PBUF_HEADROOM || (pb = sr_pbuf_alloc(sr->pbufs)) == NULL){
+            ifs = ifs->next;
+            continue;
+        }
+        packet = sr_pbuf_data(pb);
         
         //ethernet
         ethernet_hdr = (struct sr_ethernet_hdr*)packet;
@@ -306,12 +313,8 @@ void send_LSU(struct sr_instance* sr){
         ip_hdr->ip_off = 0;
         ip_hdr->ip_ttl = 255;
         ip_hdr->ip_p = 0x89;       //ospf
-        temp = (struct in_addr*)malloc(sizeof(struct in_addr));
-        temp->s_addr = ifs->ip;
-        ip_hdr->ip_src = *temp;
-        temp = (struct in_addr*)malloc(sizeof(struct in_addr));
-        temp->s_addr = htonl(OSPF_AllSPFRouters);
-        ip_hdr->ip_dst = *temp;
+        ip_hdr->ip_src.s_addr = ifs->ip;
+        ip_hdr->ip_dst.s_addr = htonl(OSPF_AllSPFRouters);
         ip_hdr->ip_sum = 0;
         ip_hdr->ip_sum = calculate_checksum((uint8_t*)ip_hdr, ip_hdr->ip_hl);
         
@@ -324,6 +327,7 @@ void send_LSU(struct sr_instance* sr){
         ospf_hdr->aid = sr->AID;
         ospf_hdr->autype = 0;
         ospf_hdr->audata = 0;
+        ospf_hdr->csum = 0;
         
         //lsu_hdr
         lsu_hdr = (struct ospfv2_lsu_hdr*)(packet + sizeof(struct sr_ethernet_hdr) + sizeof(struct ip) + sizeof(struct ospfv2_hdr));
@@ -332,13 +336,21 @@ void send_LSU(struct sr_instance* sr){
         lsu_hdr->ttl = 255;
         lsu_hdr->num_adv = htonl(interface_num);
         memcpy(packet + sizeof(struct sr_ethernet_hdr) + sizeof(struct ip) + sizeof(struct ospfv2_hdr) + sizeof(struct ospfv2_lsu_hdr), temp_space, interface_num*12);
-        ospf_hdr->csum = ospf_checksum((uint8_t*)ospf_hdr, htons(ospf_hdr->len) / 4);
+        ospf_hdr->csum = ospf_checksum((uint8_t*)ospf_hdr, ntohs(ospf_hdr->len));
         
         //printf("Database Updated!!!!!!\n");
-        sr_send_packet(sr, packet, len, ifs->name);
+        sr_send_packet_if(sr, packet, len, ifs);
+        //keep the last one, the database is updated from it
+        if(last != NULL) sr_pbuf_put(last);
+        last = pb;
         ifs = ifs->next;
     }
+    sr_send_flush(sr);
+    free(temp_space);
     //After send the packet, update the self-entry in the database
-    database_update(sr, ospf_hdr);
+    if(last != NULL){
+        database_update(sr, ospf_hdr);
+        sr_pbuf_put(last);
+    }
 }
 
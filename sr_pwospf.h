@@ -11,27 +11,31 @@
 #define SR_PWOSPF_H
 
 #include<stdint.h>
-#include <pthread.h>
+
+#include "sr_timer.h"
 
 /* forward declare */
 struct sr_instance;
+struct sr_if;
 
 struct pwospf_subsys
 {
     /* -- pwospf subsystem state variables here -- */
+    struct sr_instance* sr;
 
-
-    /* -- thread and single lock for pwospf subsystem -- */
-    pthread_t thread;
-    pthread_mutex_t lock;
-    pthread_t thread_LSU;
-    pthread_mutex_t lock_LSU;
+    /* -- timers on the packet thread's wheel, in place of threads -- */
+    struct sr_timer hello;       /* every OSPF_DEFAULT_HELLOINT */
+    struct sr_timer lsu;         /* every OSPF_DEFAULT_LSUINT */
+    struct sr_timer neighbor;    /* when the oldest neighbor times out */
 };
 
 int pwospf_init(struct sr_instance* sr);
+void pwospf_neighbor_seen(struct sr_instance* sr, struct sr_if* iface,
+                          uint32_t rid, uint32_t ip);
+void pwospf_print_neighbors(struct sr_instance* sr);
 void send_hello(struct sr_instance *sr);
 void send_LSU(struct sr_instance* sr);
-uint16_t ospf_checksum(uint8_t* start, unsigned long length);
+uint16_t ospf_checksum(uint8_t* start, unsigned int length);
 void clear_hello_result(struct sr_instance *sr);
 
 #endif /* SR_PWOSPF_H */
@@ -0,0 +1,153 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_rcu.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Epoch based deferred reclamation, see sr_rcu.h.
+ *
+ * The global epoch starts at 1 and is bumped by every retire.  An object
+ * retired at epoch E may still be referenced by a reader that entered at
+ * an epoch <= E.  Readers entering later read an epoch > E and, because
+ * the writer published the replacement before bumping the epoch, can
+ * only see the replacement.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "sr_rcu.h"
+
+void sr_rcu_init(struct sr_rcu* rcu)
+{
+    /* -- REQUIRES -- */
+    assert(rcu);
+
+    memset(rcu, 0, sizeof(struct sr_rcu));
+    rcu->epoch = 1;
+    pthread_mutex_init(&rcu->lock, 0);
+} /* -- sr_rcu_init -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rcu_register(..)
+ * Scope: Global
+ *
+ * Hand out a reader slot.  Each thread that reads published data needs
+ * its own slot.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_rcu_reader* sr_rcu_register(struct sr_rcu* rcu)
+{
+    struct sr_rcu_reader* reader = 0;
+    int i;
+
+    pthread_mutex_lock(&rcu->lock);
+    for(i = 0; i < SR_RCU_MAX_READERS; i++)
+    {
+        if(!rcu->readers[i].used)
+        {
+            reader = &rcu->readers[i];
+            reader->used  = 1;
+            reader->epoch = SR_RCU_OFFLINE;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&rcu->lock);
+
+    assert(reader);
+    return reader;
+} /* -- sr_rcu_register -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rcu_retire(..)
+ * Scope: Global
+ *
+ * Queue ptr, already unpublished, to be passed to destroy once no reader
+ * can hold it.  Never blocks on readers.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_rcu_retire(struct sr_rcu* rcu, void* ptr, void (*destroy)(void*))
+{
+    struct sr_rcu_retired* item;
+
+    if(ptr == 0)
+    { return; }
+
+    item = (struct sr_rcu_retired*)malloc(sizeof(struct sr_rcu_retired));
+    assert(item);
+    item->ptr     = ptr;
+    item->destroy = destroy;
+
+    pthread_mutex_lock(&rcu->lock);
+    item->epoch = __atomic_fetch_add(&rcu->epoch, 1, __ATOMIC_SEQ_CST);
+    item->next  = rcu->retired;
+    rcu->retired = item;
+    rcu->nretired++;
+    pthread_mutex_unlock(&rcu->lock);
+} /* -- sr_rcu_retire -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rcu_reclaim(..)
+ * Scope: Global
+ *
+ * Free every retired object that no reader can still see.
+ *
+ * RETURN VALUES:
+ *
+ *  number of objects freed
+ *
+ *---------------------------------------------------------------------*/
+
+unsigned long sr_rcu_reclaim(struct sr_rcu* rcu)
+{
+    struct sr_rcu_retired** link;
+    struct sr_rcu_retired* item;
+    struct sr_rcu_retired* done = 0;
+    uint64_t oldest = UINT64_MAX, epoch;
+    unsigned long freed = 0;
+    int i;
+
+    pthread_mutex_lock(&rcu->lock);
+
+    for(i = 0; i < SR_RCU_MAX_READERS; i++)
+    {
+        if(!rcu->readers[i].used)
+        { continue; }
+        epoch = __atomic_load_n(&rcu->readers[i].epoch, __ATOMIC_SEQ_CST);
+        if(epoch != SR_RCU_OFFLINE && epoch < oldest)
+        { oldest = epoch; }
+    }
+
+    link = &rcu->retired;
+    while((item = *link) != 0)
+    {
+        if(item->epoch < oldest)
+        {
+            *link = item->next;
+            item->next = done;
+            done = item;
+            rcu->nretired--;
+            rcu->nfreed++;
+        }
+        else
+        { link = &item->next; }
+    }
+
+    pthread_mutex_unlock(&rcu->lock);
+
+    while(done)
+    {
+        item = done;
+        done = item->next;
+        item->destroy(item->ptr);
+        free(item);
+        freed++;
+    }
+
+    return freed;
+} /* -- sr_rcu_reclaim -- */
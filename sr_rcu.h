@@ -0,0 +1,84 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_rcu.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Epoch based deferred reclamation for data published with a single
+ * pointer store, in the style of RCU.
+ *
+ * A reader brackets its use of shared data with sr_rcu_read_lock and
+ * sr_rcu_read_unlock.  Neither call blocks or takes a lock; they only
+ * record, in the reader's own slot, the epoch the reader entered in.
+ *
+ * A writer publishes a new version with an atomic pointer store and hands
+ * the old version to sr_rcu_retire.  Retired objects are freed by
+ * sr_rcu_reclaim once every reader that could still see them has left
+ * its read side section.  Writers must serialize among themselves.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_RCU_H
+#define SR_RCU_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include <pthread.h>
+
+#define SR_RCU_MAX_READERS 64
+#define SR_RCU_OFFLINE     0 /* reader slot value outside a read section */
+
+struct sr_rcu_reader
+{
+    volatile uint64_t epoch;
+    uint8_t used;
+} __attribute__ ((aligned (64)));
+
+struct sr_rcu_retired
+{
+    void* ptr;
+    void (*destroy)(void*);
+    uint64_t epoch;
+    struct sr_rcu_retired* next;
+};
+
+struct sr_rcu
+{
+    volatile uint64_t epoch;
+    struct sr_rcu_reader readers[SR_RCU_MAX_READERS];
+    struct sr_rcu_retired* retired;
+    unsigned long nretired; /* waiting to be freed */
+    unsigned long nfreed;   /* freed over the lifetime */
+    pthread_mutex_t lock;   /* reader registration and retire list */
+};
+
+void sr_rcu_init(struct sr_rcu* rcu);
+struct sr_rcu_reader* sr_rcu_register(struct sr_rcu* rcu);
+void sr_rcu_retire(struct sr_rcu* rcu, void* ptr, void (*destroy)(void*));
+unsigned long sr_rcu_reclaim(struct sr_rcu* rcu);
+
+static inline void sr_rcu_read_lock(struct sr_rcu* rcu,
+                                    struct sr_rcu_reader* reader)
+{
+    __atomic_store_n(&reader->epoch, __atomic_load_n(&rcu->epoch,
+                     __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+}
+
+static inline void sr_rcu_read_unlock(struct sr_rcu_reader* reader)
+{
+    __atomic_store_n(&reader->epoch, SR_RCU_OFFLINE, __ATOMIC_RELEASE);
+}
+
+/* -- load a pointer published by a writer, inside a read section -- */
+#define sr_rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_SEQ_CST)
+
+/* -- publish a fully initialized object to readers -- */
+#define sr_rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_SEQ_CST)
+
+#endif /* -- SR_RCU_H -- */
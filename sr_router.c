@@ -23,6 +23,16 @@
 #include "sr_pwospf.h"
 #include "sr_router.h"
 #include "sr_protocol.h"
+#include "sr_rcu.h"
+#include "sr_arpcache.h"
+#include "sr_arpqueue.h"
+#include "sr_pbuf.h"
+#include "sr_cksum.h"
+#include "sr_timer.h"
+#include "sr_worker.h"
+#include "sr_event.h"
+#include "sr_dispatch.h"
+#include "sr_icmp.h"
 #include "pwospf_protocol.h"
 
 /*--------------------------------------------------------------------- 
@@ -39,45 +49,93 @@ void sr_init(struct sr_instance* sr)
     assert(sr);
 
     /* Add initialization code here! */
-    sr->un_packet = NULL;
     sr->AID = 0;
-    sr->lsuint = (uint16_t)OSPF_DEFAULT_LSUINT;
     sr->sequence = 0;
     sr->s_rt = 0;
     sr->db = 0;
+    sr->timers = (struct sr_timer_wheel*)malloc(sizeof(struct sr_timer_wheel));
+    assert(sr->timers);
+    sr_timer_wheel_init(sr->timers, sr_timer_now_ms());
+    //The packet thread sleeps on the server, timers and control socket at once
+    sr->loop = sr_event_loop_create(sr->timers);
+    assert(sr->loop);
+    sr->reclaim = (struct sr_timer*)malloc(sizeof(struct sr_timer));
+    assert(sr->reclaim);
+    sr_timer_init(sr->reclaim, rcu_reclaim_fired, sr);
+    //What a frame goes to: by ethertype, then by IP protocol for our own
+    //addresses, or for PWOSPF whatever the destination.  We run no TCP or
+    //UDP services, so every port is unreachable
+    sr->dispatch = sr_dispatch_create();
+    sr_dispatch_ether(sr->dispatch, ETHERTYPE_ARP, processARP);
+    sr_dispatch_ether(sr->dispatch, ETHERTYPE_IP, processIP);
+    sr_dispatch_ip(sr->dispatch, IPPROTO_ICMP, sendICMP, 0);
+    sr_dispatch_ip(sr->dispatch, IPPROTO_TCP, port_unreachable, 0);
+    sr_dispatch_ip(sr->dispatch, IPPROTO_UDP, port_unreachable, 0);
+    sr_dispatch_ip(sr->dispatch, IPPROTO_OSPF, processOSPF, SR_DISPATCH_ANY_DST);
+    sr_dispatch_set_local(sr->dispatch, sr->if_list);
+    sr->icmp = sr_icmp_create();
+    sr->arp_cache = sr_arpcache_create(sr->arp_capacity);
+    //Entries in use get refreshed by unicast before they time out
+    sr_arpcache_set_aging(sr->arp_cache, sr->timers, arp_refresh, sr);
+    sr->arp_queue = sr_arpqueue_create(sr->timers, arp_queue_send,
+                                       arp_queue_transmit,
+                                       arp_queue_unreachable, sr);
+    //Forwarding workers if asked for, else packets are forwarded on the
+    //thread that reads them
+    if(sr->nworkers){
+        sr->workers = sr_workers_create(sr->nworkers, sr->rcu, worker_route, worker_transmit, sr);
+        //Frames coming back only need to wake the loop, it drains them
+        if(sr->workers != NULL && sr_event_add(sr->loop, sr_workers_wake_fd(sr->workers), EPOLLIN, 0, 0) == NULL){
+            sr_workers_destroy(sr->workers);
+            sr->workers = NULL;
+        }
+        if(sr->workers == NULL) fprintf(stderr, "Forwarding on the packet thread instead\n");
+    }
     
    /* moved to sr_vns_comm.c, after HWINFO has been received and processed */
    /* pwospf_init(sr); */
 } /* -- sr_init -- */
 
 /*---------------------------------------------------------------------
- * Method: sr_handlepacket(uint8_t* p,char* interface)
+ * Method: rcu_reclaim_fired
+ * Free the routing tables a forwarding worker was still reading when
+ * they were replaced, trying again while any are left
+ *---------------------------------------------------------------------*/
+void rcu_reclaim_fired(struct sr_timer* timer, void* arg){
+    struct sr_instance* sr = (struct sr_instance*)arg;
+    sr_rcu_reclaim(sr->rcu);
+    if(sr->rcu->nretired) sr_timer_arm(sr->timers, timer, sr_timer_wheel_now(sr->timers), RCU_RECLAIM_MS);
+} /* -- rcu_reclaim_fired -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_handlepacket(uint8_t* p,struct sr_if* iface)
  * Scope:  Global
  *
  * This method is called each time the router receives a packet on the
  * interface.  The packet buffer, the packet length and the receiving
  * interface are passed in as parameters. The packet is complete with
- * ethernet headers.
+ * ethernet headers.  The receiving interface has already been resolved
+ * from its name by the caller.
  *
- * Note: Both the packet buffer and the character's memory are handled
- * by sr_vns_comm.c that means do NOT delete either.  Make a copy of the
- * packet instead if you intend to keep it around beyond the scope of
- * the method call.
+ * Note: Both the packet buffer and the interface are handled
+ * by sr_vns_comm.c that means do NOT delete either.  To keep the packet
+ * around beyond the scope of the method call, take a reference to its
+ * buffer with sr_pbuf_claim, which copies it if it is not pooled.
  *
  *---------------------------------------------------------------------*/
 
 void sr_handlepacket(struct sr_instance* sr,
         uint8_t * packet/* lent */,
         unsigned int len,
-        char* interface/* lent */)
+        struct sr_if* iface/* lent */)
 {
     //struct ip* ips;
     struct sr_ethernet_hdr* ethernets;
-    struct sr_arphdr* arps;
+    sr_dispatch_fn fn;
     /* REQUIRES */
     assert(sr);
     assert(packet);
-    assert(interface);
+    assert(iface);
 
 //    int x = 0;
 //    printf("------------\n");
@@ -87,50 +145,50 @@ void sr_handlepacket(struct sr_instance* sr,
 //    printf("============\n");
 //    printf("*** -> Received packet of length %d \n",len);
     
-    //analysis ethernet packet
+    //Routes looked up below stay valid until the read section ends
+    sr_rcu_read_lock(sr->rcu, sr->fwd_reader);
+    
+    //analysis ethernet packet, by the handler for its type: ARP, IP, ..
     ethernets = (struct sr_ethernet_hdr*)packet;
-    //ARP
-    if(ethernets->ether_type == htons(ETHERTYPE_ARP)){
-        arps = (struct sr_arphdr*)(packet + sizeof(struct sr_ethernet_hdr));
-        //Request
-        if(arps->ar_op == htons(ARP_REQUEST)){
-            sr_arprequest(sr, packet, interface, len);
-        }
-        //Reply
-        else if(arps->ar_op == htons(ARP_REPLY)){
-            sr_arpreply(sr, packet, interface, len);
-        }
-    }
-    //IP
-    else if(ethernets->ether_type == htons(ETHERTYPE_IP)){
-        processIP(sr, packet, interface, len);
+    if(len >= sizeof(struct sr_ethernet_hdr) &&
+       (fn = sr_dispatch_ether_fn(sr->dispatch, ethernets->ether_type)) != NULL){
+        fn(sr, packet, iface, len);
     }
+    
+    sr_rcu_read_unlock(sr->fwd_reader);
 
 }/* end sr_ForwardPacket */
 
+/*---------------------------------------------------------------------
+ * Method: processARP
+ *
+ *---------------------------------------------------------------------*/
+void processARP(struct sr_instance* sr, uint8_t* packet, struct sr_if* iface, unsigned int length){
+    struct sr_arphdr* arps = (struct sr_arphdr*)(packet + sizeof(struct sr_ethernet_hdr));
+    //Request
+    if(arps->ar_op == htons(ARP_REQUEST)){
+        sr_arprequest(sr, packet, iface, length);
+    }
+    //Reply
+    else if(arps->ar_op == htons(ARP_REPLY)){
+        sr_arpreply(sr, packet, iface, length);
+    }
+}
+
 
 /*---------------------------------------------------------------------
  * Method: ARPRequest
  *
  *---------------------------------------------------------------------*/
-void sr_arprequest(struct sr_instance* sr, uint8_t* packet, char* interface, unsigned int length){
-    struct sr_if* ifs;
-    ifs = sr->if_list;
-    uint8_t* packetN;
+void sr_arprequest(struct sr_instance* sr, uint8_t* packet, struct sr_if* ifs, unsigned int length){
+    uint8_t packetN[sizeof(struct sr_ethernet_hdr) + sizeof(struct sr_arphdr)];
     struct sr_ethernet_hdr* ethernets;
     struct sr_arphdr* arps;
     
     //Judge the length of the packet
     if(length != sizeof(struct sr_ethernet_hdr) + sizeof(struct sr_arphdr)) return;
     
-    while(ifs != NULL){
-        if(strcmp(ifs->name, interface) == 0) break;
-        else ifs = ifs->next;
-    }
-    if(ifs == NULL) return;
-    else{
-        packetN = (uint8_t*)malloc(length);
-        
+    {
         //Ethernet head
         ethernets = (struct sr_ethernet_hdr*)packetN;
         memcpy(ethernets->ether_dhost, ((struct sr_ethernet_hdr*)packet)->ether_shost, ETHER_ADDR_LEN);
@@ -149,10 +207,10 @@ void sr_arprequest(struct sr_instance* sr, uint8_t* packet, char* interface, uns
         memcpy(arps->ar_tha, ((struct sr_ethernet_hdr*)packet)->ether_shost, ETHER_ADDR_LEN);
         arps->ar_tip = ((struct sr_arphdr*)(packet + sizeof(struct sr_ethernet_hdr)))->ar_sip;
         
-        sr_send_packet(sr, packetN, length, interface);
+        sr_send_packet_if(sr, packetN, length, ifs);
         
         //Update the ARP cache
-        arp_cache_update(sr, interface, ethernets->ether_dhost, arps->ar_tip);
+        arp_cache_update(sr, ifs, ethernets->ether_dhost, arps->ar_tip);
     }
 }
 
@@ -160,19 +218,17 @@ void sr_arprequest(struct sr_instance* sr, uint8_t* packet, char* interface, uns
 * Method: IPForwarding
 *
 *---------------------------------------------------------------------*/
-void processIP(struct sr_instance* sr, uint8_t* packet, char* interface, unsigned int length){
+void processIP(struct sr_instance* sr, uint8_t* packet, struct sr_if* iface, unsigned int length){
     int etherhl = sizeof(struct sr_ethernet_hdr);
     int ipl = sizeof(struct ip);
     struct ip* ips;
-    struct sr_rt* rts, *rtsd = NULL;
+    struct sr_rt* rts;
+    const struct sr_nexthop* nh;
+    const struct sr_dispatch_ip* proto;
     struct sr_if* ifs;
-    struct if_arp* arps;
     struct sr_ethernet_hdr* ethernets = (struct sr_ethernet_hdr*)packet;
-    struct ospfv2_hdr* ospf_hdr = (struct ospfv2_hdr*)(packet + etherhl + ipl);
-    int byte_num = 0, i = 0;
-    uint32_t check = 0, des_op = 0, mask_temp = 0, pwospf_check = 0;
+    uint32_t des_op = 0;
     ips = (struct ip*)(packet + etherhl);
-    byte_num = (ips->ip_hl) * 2;
 //    if(ips->ip_p == IPPROTO_ICMP){
 //        printf("Got it!\n");
 //        int x = 0;
@@ -184,161 +240,262 @@ void processIP(struct sr_instance* sr, uint8_t* packet, char* interface, unsigne
 //            printf("\n******************\n");
 //        }
 //    }
+    //truncated header, drop; nothing in it can be read before this
+    if(length < etherhl + ipl || length < etherhl + ips->ip_hl * 4) return;
     //Wrong ip packet, drop
     if(ips->ip_v != 4) return;
-    //incoming packet's TTL is one, drop
-    if(ips->ip_ttl <= 1) return;
-    
-    //check sum
-    for(i = 0;i < byte_num;i++){
-        check += ntohs(*(uint16_t*)(packet+etherhl+i*2));
-    }
-    check = (check & 0xffff) + (check >> 16);
     
-    //checksum fails
-    if(check != 0xffff) return;
+    //check sum, fails unless it comes out 0 over the header
+    if(sr_cksum(ips, ips->ip_hl * 4) != 0) return;
     
     //checksum sucesses
-    rts = sr->routing_table;
     des_op = (ips->ip_dst).s_addr;
     
-    //Update the ARP cache
-    arp_cache_update(sr, interface, ethernets->ether_shost, (ips->ip_src).s_addr);
+    //Its sender is still there, if it is a neighbour
+    arp_cache_confirm(sr, iface, ethernets->ether_shost, (ips->ip_src).s_addr);
     
-    //ospf packet
-    if(ips->ip_p == 0x89){
-        //version check
-        if(ospf_hdr->version != OSPF_V2) return;
-        
-        //Area ID check
-        if(ospf_hdr->aid != 0) return;
-        
-        //Authentication check
-        if(ospf_hdr->audata != 0) return;
-        
-        //check sum evaluation
-        for(i = 0;i < htons(ospf_hdr->len) / 2;i++){
-            if(i <= 11 && i >= 8) pwospf_check += ntohs(*(uint16_t*)(packet+etherhl+ipl + i * 2));
-        }
-        pwospf_check = (check & 0xffff) + (check >> 16);
-        //checksum fails
-        if(pwospf_check != 0xffff) return;
-        //hello message
-        if(ospf_hdr->type == OSPF_TYPE_HELLO){
-            ifs = sr->if_list;
-           while(ifs != NULL){
-               if(strcmp(ifs->name, interface) == 0) break;
-               ifs = ifs->next;
-           }
-           //new neighbor
-           if(ifs->neighbors == NULL){
-               ifs->neighbors = (struct neighbor_router*)malloc(sizeof(struct neighbor_router));
-           }
-            ifs->neighbors->neighbor_RID = ospf_hdr->rid;
-            ifs->neighbors->neighbor_IP = ips->ip_src.s_addr;
-            ifs->neighbors->update_time = time(NULL);
-        }
-        //lsu message
-        else if(ospf_hdr->type == OSPF_TYPE_LSU){
-            LSU_process(sr, ospf_hdr, ips->ip_src.s_addr, packet, length, interface);
-        }
+    //For the router: to one of its addresses, or a protocol it takes
+    //whatever the destination (PWOSPF).  Its TTL does not matter then
+    proto = sr_dispatch_ip_entry(sr->dispatch, ips->ip_p);
+    if((proto->flags & SR_DISPATCH_ANY_DST) || sr_dispatch_local(sr->dispatch, des_op) != NULL){
+        if(proto->fn != NULL) proto->fn(sr, packet, iface, length);
+        else sr_icmp_error(sr, packet, length, iface, ICMP_UNREACH, ICMP_UNREACH_PROTOCOL, 0);
         return;
     }
     
-    ifs = sr->if_list;
-    while(ifs != NULL){
-        if(ifs->ip == des_op) break;
-        ifs = ifs->next;
+    //TTL would reach 0 on the way out, tell the sender (traceroute)
+    if(ips->ip_ttl <= 1){
+        sr_icmp_error(sr, packet, length, iface, ICMP_TIMXCEED, ICMP_TIMXCEED_INTRANS, 0);
+        return;
     }
     
-    //If des_op is the address of the router
-    if(ifs != NULL){
-        
-        //If the packet is ICMP
-        if(ips->ip_p == IPPROTO_ICMP){
-            //Check sum
-//            check = 0;
-//            //6 represents 6 uint_16 to be caculated.
-//            for(i = 0;i < 6;i++){
-//                check += ntohs(*(uint16_t*)(packet+etherhl+sizeof(struct ip)+i*2));
-//            }
-//            check = (check & 0xffff) + (check >> 16);
-//            if(check != 0xffff) return;
-//            printf("\n\n\n\nICMP\n\n\n\n");
-            sendICMP(sr, packet, interface, length);
-            return;
-        }
-        //TCP, UDP, ..
-        else{
-            //printf("\n\n\n\nTCP\n\n\\n\n");
-            return;
-        }
+    //Longest prefix match
+    rts = sr_rt_lookup(sr, des_op);
+    if(rts == NULL){
+        sr_icmp_error(sr, packet, length, iface, ICMP_UNREACH, ICMP_UNREACH_NET, 0);
+        return;
     }
     
-    if(rts == NULL) return;       //Error, do nothing
-    while(rts != NULL){
-        if(((rts->dest).s_addr & (rts->mask).s_addr) ==
-           (des_op & (rts->mask).s_addr) && rts->mask.s_addr >= mask_temp){
-            mask_temp = rts->mask.s_addr;
-            rtsd = rts;
-        }
-        rts = rts->next;
-    }
-    rts = rtsd;
+    //Equal-cost routes: hash the flow so it always takes the same next hop
+    nh = sr_rt_select(rts, flow_hash(ips, length - etherhl));
     
     //find the interface structure
-    ifs = sr->if_list;
-    while(ifs != NULL){
-        if(strcmp(ifs->name, rts->interface) == 0) break;
-        ifs = ifs->next;
+    ifs = sr_get_interface_by_index(sr, nh->if_index);
+    if(ifs == NULL) return;
+    //On-link destinations have no gateway, ARP for the host itself.
+    //A gateway's adjacency is remembered in the route as a hint
+    if(nh->gw.s_addr){
+        send_to_nexthop(sr, packet, iface, length, ifs, nh->gw.s_addr, sr_rt_adj(rts, nh));
     }
-    arps = ifs->arp_cache;
-    while(arps != NULL){
-        if(rts->gw.s_addr == 0){
-            if(arps->p_addr == des_op) break;
-        }
-        else{
-            if(arps->p_addr == rts->gw.s_addr) break;
-        }
-        arps = arps->next;
+    else{
+        send_to_nexthop(sr, packet, iface, length, ifs, des_op, NULL);
     }
-    //ARP cache does not have the mac address, send ARP request, drop the IP packet.
-    if(arps == NULL){
-        sendARP(sr, rts->interface, rts->gw.s_addr, ips);
-        add_unhandled(sr, packet, length);
+}
+
+/*---------------------------------------------------------------------
+* Method: processOSPF
+* A PWOSPF packet, checked and then taken as a hello or an LSU
+*---------------------------------------------------------------------*/
+void processOSPF(struct sr_instance* sr, uint8_t* packet, struct sr_if* iface, unsigned int length){
+    int etherhl = sizeof(struct sr_ethernet_hdr);
+    int ipl = sizeof(struct ip);
+    struct ip* ips = (struct ip*)(packet + etherhl);
+    struct ospfv2_hdr* ospf_hdr = (struct ospfv2_hdr*)(packet + etherhl + ipl);
+    unsigned int ospf_len;
+    
+    //room for the header before looking at it
+    if(length < etherhl + ipl + sizeof(struct ospfv2_hdr)) return;
+    
+    //version check
+    if(ospf_hdr->version != OSPF_V2) return;
+    
+    //Area ID check
+    if(ospf_hdr->aid != 0) return;
+    
+    //Authentication check
+    if(ospf_hdr->audata != 0) return;
+    
+    //Length and checksum check, over the whole PWOSPF packet
+    ospf_len = ntohs(ospf_hdr->len);
+    if(ospf_len < sizeof(struct ospfv2_hdr) || etherhl + ipl + ospf_len > length) return;
+    if(ospf_checksum((uint8_t*)ospf_hdr, ospf_len) != 0) return;
+    
+    //hello message
+    if(ospf_hdr->type == OSPF_TYPE_HELLO){
+        pwospf_neighbor_seen(sr, iface, ospf_hdr->rid, ips->ip_src.s_addr);
+    }
+    //lsu message
+    else if(ospf_hdr->type == OSPF_TYPE_LSU){
+        LSU_process(sr, ospf_hdr, ips->ip_src.s_addr, packet, length, iface);
+    }
+}
+
+/*---------------------------------------------------------------------
+* Method: send_to_nexthop
+* Send the packet that came in on iface out of ifs to next, finding
+* next in the ARP cache through hint if there is one
+*---------------------------------------------------------------------*/
+void send_to_nexthop(struct sr_instance* sr, uint8_t* packet, struct sr_if* iface, unsigned int length, struct sr_if* ifs, uint32_t next, uint32_t* hint){
+    struct ip* ips = (struct ip*)(packet + sizeof(struct sr_ethernet_hdr));
+    struct sr_arp_entry* arpe;
+    struct sr_pbuf* pb;
+    //Too big for ifs, and we do not fragment: refuse it if the sender
+    //said not to, else let it through as ever
+    if(ntohs(ips->ip_len) > ifs->mtu && (ntohs(ips->ip_off) & IP_DF)){
+        sr_icmp_error(sr, packet, length, iface, ICMP_UNREACH, ICMP_UNREACH_NEEDFRAG, ifs->mtu);
+        return;
+    }
+    if(hint) arpe = sr_arpcache_lookup_hint(sr->arp_cache, ifs->index, next, hint);
+    else arpe = sr_arpcache_lookup(sr->arp_cache, ifs->index, next);
+    //ARP cache does not have the mac address, park the packet until it does:
+    //hold on to the receive buffer, or a pooled copy of the packet
+    if(arpe == NULL){
+        pb = sr_pbuf_claim(sr->pbufs, packet, length);
+        if(pb == NULL) return;
+        pb->if_index = iface->index;
+        sr_arpqueue_add(sr->arp_queue, ifs->index, next, pb);
+        sr_pbuf_put(pb);
+        return;
+    }
+    //ARP cache has the mac address, and the header to send with
+    IPForwarding(sr, packet, arpe->hdr, ifs, length);
+}
+
+/*---------------------------------------------------------------------
+* Method: sr_dispatchpacket
+* sr_handlepacket when there are forwarding workers: an IP packet goes
+* in a pooled buffer to the worker for its flow, anything else is
+* handled here and now
+*---------------------------------------------------------------------*/
+void sr_dispatchpacket(struct sr_instance* sr, uint8_t* packet, unsigned int len, struct sr_if* iface){
+    int etherhl = sizeof(struct sr_ethernet_hdr);
+    struct sr_pbuf* pb;
+    if(len < etherhl + sizeof(struct ip) || ((struct sr_ethernet_hdr*)packet)->ether_type != htons(ETHERTYPE_IP)){
+        sr_handlepacket(sr, packet, len, iface);
         return;
     }
-    //If the ARP entry has expired (15s)
-    else if(time(NULL) - arps->created_time >= 15){
-        //printf("\n\n-----------------TIME EXPIRE!---------------\n\n");
-        sendARP(sr, rts->interface, rts->gw.s_addr, ips);
-        add_unhandled(sr, packet, length);
+    //the receive buffer is reused once this returns
+    pb = sr_pbuf_claim(sr->pbufs, packet, len);
+    if(pb == NULL) return;
+    pb->if_index = iface->index;
+    pb->out_index = -1;
+    sr_workers_dispatch(sr->workers, pb, flow_hash((struct ip*)(packet + etherhl), len - etherhl));
+}
+
+/*---------------------------------------------------------------------
+* Method: worker_route
+* Worker thread half of processIP for the frame in pb: checks a packet
+* to be forwarded, looks up its route and its next hop's adjacency and,
+* given both, decrements its TTL and writes its Ethernet header, leaving
+* it ready for worker_transmit to send.  A next hop not in the ARP cache
+* is left in pb for worker_transmit to park the packet on.  Returns 0
+* for anything else, which processIP sees as usual: for the router,
+* bad, without a route or too big.  Only reads what the packet thread
+* leaves alone, interfaces and routes, and the ARP cache through
+* sr_arpcache_read
+*---------------------------------------------------------------------*/
+int worker_route(void* ctx, struct sr_pbuf* pb){
+    struct sr_instance* sr = (struct sr_instance*)ctx;
+    int etherhl = sizeof(struct sr_ethernet_hdr);
+    uint8_t* packet = sr_pbuf_data(pb);
+    struct ip* ips = (struct ip*)(packet + etherhl);
+    uint8_t hdr[sizeof(struct sr_ethernet_hdr)];
+    const struct sr_nexthop* nh;
+    struct sr_rt* rts;
+    struct sr_if* iface;
+    struct sr_if* ifs;
+    
+    //processIP's checks; it runs them again, and sends any ICMP error
+    if(pb->len < etherhl + sizeof(struct ip) || pb->len < etherhl + ips->ip_hl * 4) return 0;
+    if(ips->ip_v != 4 || ips->ip_ttl <= 1) return 0;
+    if(sr_cksum(ips, ips->ip_hl * 4) != 0) return 0;
+    if((sr_dispatch_ip_entry(sr->dispatch, ips->ip_p)->flags & SR_DISPATCH_ANY_DST) ||
+       sr_dispatch_local(sr->dispatch, ips->ip_dst.s_addr) != NULL) return 0;
+    
+    //Longest prefix match, and the next hop for this flow
+    rts = sr_rt_lookup(sr, ips->ip_dst.s_addr);
+    if(rts == NULL) return 0;
+    nh = sr_rt_select(rts, flow_hash(ips, pb->len - etherhl));
+    iface = sr_get_interface_by_index(sr, pb->if_index);
+    ifs = sr_get_interface_by_index(sr, nh->if_index);
+    if(iface == NULL || ifs == NULL) return 0;
+    if(ntohs(ips->ip_len) > ifs->mtu && (ntohs(ips->ip_off) & IP_DF)) return 0;
+    
+    arp_cache_confirm(sr, iface, ((struct sr_ethernet_hdr*)packet)->ether_shost, ips->ip_src.s_addr);
+    pb->out_index = nh->if_index;
+    pb->nexthop = nh->gw.s_addr ? nh->gw.s_addr : ips->ip_dst.s_addr;
+    
+    //The adjacency, through the route's hint for a gateway as send_to_nexthop
+    if(sr_arpcache_read(sr->arp_cache, ifs->index, pb->nexthop,
+                        nh->gw.s_addr ? sr_rt_adj(rts, nh) : NULL, hdr) == 0){
+        sr_ip_dec_ttl(ips);
+        memcpy(packet, hdr, sizeof(hdr));
+        pb->ready = 1;
+    }
+    return 1;
+}
+
+/*---------------------------------------------------------------------
+* Method: worker_transmit
+* Packet thread half: sends a frame worker_route made ready, parks one
+* whose next hop it did not find in the ARP cache (or sends it, if the
+* cache has it by now), and hands any other to sr_handlepacket as if it
+* had just come in.  The route may have changed since; the packet goes
+* where it was sent
+*---------------------------------------------------------------------*/
+void worker_transmit(void* ctx, struct sr_pbuf* pb){
+    struct sr_instance* sr = (struct sr_instance*)ctx;
+    uint8_t* packet = sr_pbuf_data(pb);
+    struct sr_if* iface = sr_get_interface_by_index(sr, pb->if_index);
+    struct sr_if* ifs;
+    if(iface == NULL) return;
+    if(pb->out_index < 0){
+        sr_handlepacket(sr, packet, pb->len, iface);
         return;
     }
-    //ARP cache has the mac address
-    IPForwarding(sr, packet, arps->m_addr, ifs->addr, ifs->name, length);
+    ifs = sr_get_interface_by_index(sr, pb->out_index);
+    if(pb->ready) sr_send_packet_nocopy(sr, packet, pb->len, ifs);
+    else send_to_nexthop(sr, packet, iface, pb->len, ifs, pb->nexthop, NULL);
+}
+
+/*---------------------------------------------------------------------
+* Method: flow_hash
+* Hash of the 5-tuple, ports left out for fragments so that every
+* fragment of a datagram hashes alike
+*---------------------------------------------------------------------*/
+uint32_t flow_hash(struct ip* ips, unsigned int length){
+    uint32_t h = ips->ip_src.s_addr, ports = 0;
+    unsigned int hl = ips->ip_hl * 4;
+    if((ips->ip_p == IPPROTO_TCP || ips->ip_p == IPPROTO_UDP) &&
+       (ntohs(ips->ip_off) & (IP_MF | IP_OFFMASK)) == 0 && length >= hl + 4){
+        memcpy(&ports, (uint8_t*)ips + hl, 4);
+    }
+    h = h * 0x9e3779b1 ^ ips->ip_dst.s_addr;
+    h = h * 0x9e3779b1 ^ ports;
+    h = h * 0x9e3779b1 ^ ips->ip_p;
+    //Final mix so the top bits sr_rt_select uses depend on every input bit
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
 }
 
 /*---------------------------------------------------------------------
 * Method: IPForwarding
-*
+* Send packet out of iface with the Ethernet header of its adjacency
 *---------------------------------------------------------------------*/
-void IPForwarding(struct sr_instance* sr, uint8_t* packet, unsigned char* macd, unsigned char* macs, char* interface, unsigned int length){
+void IPForwarding(struct sr_instance* sr, uint8_t* packet, const uint8_t* ether_hdr, struct sr_if* iface, unsigned int length){
     uint8_t etherhl = sizeof(struct sr_ethernet_hdr);
     struct ip* ips = (struct ip*)(packet + etherhl);
-    struct sr_ethernet_hdr* ethernets;
-    ips->ip_ttl--;                 //update TTL
-    //Calculate new checksum
-    ips->ip_sum = 0;
-    ips->ip_sum = calculate_checksum((uint8_t*)ips, ips->ip_hl);
+    //update TTL, and the checksum for just that change (RFC 1624)
+    sr_ip_dec_ttl(ips);
     
     //Construct the new Ethernet packet
-    ethernets = (struct sr_ethernet_hdr*)packet;
-    memcpy(ethernets->ether_dhost, macd, ETHER_ADDR_LEN);
-    memcpy(ethernets->ether_shost, macs, ETHER_ADDR_LEN);
-    ethernets->ether_type = htons(ETHERTYPE_IP);
-    //send the packet
-    sr_send_packet(sr, packet, length, interface);
+    memcpy(packet, ether_hdr, sizeof(struct sr_ethernet_hdr));
+    //send the packet, from its own buffer: nothing changes it after this
+    sr_send_packet_nocopy(sr, packet, length, iface);
     
 //    int x = 0;
 //    if(ips->ip_p == IPPROTO_ICMP){
@@ -355,15 +512,21 @@ void IPForwarding(struct sr_instance* sr, uint8_t* packet, unsigned char* macd,
 * Method: sendICMP
 * uncheck ICMP check sum
 *---------------------------------------------------------------------*/
-void sendICMP(struct sr_instance* sr, uint8_t* packet, char* interface, unsigned int length){
+void sendICMP(struct sr_instance* sr, uint8_t* packet, struct sr_if* iface, unsigned int length){
     int ether_len = sizeof(struct sr_ethernet_hdr);
-    int ip_len = sizeof(struct ip);
     struct sr_ethernet_hdr* ethernets = (struct sr_ethernet_hdr*)packet;
     struct ip* ips = (struct ip*)(packet + ether_len);
+    int ip_len = ips->ip_hl * 4;
+    unsigned int ICMP_len;
     uint8_t* ICMP_hdr;
     uint8_t ether_temp[ETHER_ADDR_LEN];
     uint32_t ip_temp;
     uint16_t*ICMP_checksum;
+    //ICMP message is whatever the IP packet holds past its header, and
+    //has to be in the frame
+    ICMP_len = ntohs(ips->ip_len) - ip_len;
+    if(ntohs(ips->ip_len) < ip_len + 4 || ether_len + ip_len + ICMP_len > length) return;
+    
     //Exchange the ethernet address
     memcpy(ether_temp, ethernets->ether_dhost, ETHER_ADDR_LEN);
     memcpy(ethernets->ether_dhost, ethernets->ether_shost, ETHER_ADDR_LEN);
@@ -376,42 +539,45 @@ void sendICMP(struct sr_instance* sr, uint8_t* packet, char* interface, unsigned
     
     //Calculate ip checksum
     ips->ip_sum = 0;
-    ips->ip_sum = calculate_checksum((uint8_t*)ips, ips->ip_hl);
+    ips->ip_sum = sr_cksum(ips, ip_len);
     
     //Update ICMP part
     ICMP_hdr = packet + ether_len + ip_len;
     ICMP_hdr[0] = 0x0;        //set reply
-    //calculate checksum
+    //calculate checksum, over the header and all of the echoed data
     ICMP_checksum = (uint16_t*)(ICMP_hdr+2);
     *ICMP_checksum = 0x0;
-    *ICMP_checksum = calculate_checksum((uint8_t*)ICMP_hdr, 35);
+    *ICMP_checksum = sr_cksum(ICMP_hdr, ICMP_len);
     
     //send the packet
-    sr_send_packet(sr, packet, length, interface);
+    sr_send_packet_nocopy(sr, packet, length, iface);
 }
 
+/*---------------------------------------------------------------------
+* Method: port_unreachable
+* TCP or UDP to one of our addresses, where nothing listens
+*---------------------------------------------------------------------*/
+void port_unreachable(struct sr_instance* sr, uint8_t* packet, struct sr_if* iface, unsigned int length){
+    sr_icmp_error(sr, packet, length, iface, ICMP_UNREACH, ICMP_UNREACH_PORT, 0);
+}
 
 /*---------------------------------------------------------------------
-* Method: sendARP
-*
+* Method: send_arp_request
+* Ask for tip's address, broadcast, or unicast to dmac when refreshing
+* an entry we already have. Returns -1 if the rate limit held it back
 *---------------------------------------------------------------------*/
-void sendARP(struct sr_instance* sr, char* interface, uint32_t gw, struct ip* ips){
-    struct sr_if* ifs;
+int send_arp_request(struct sr_instance* sr, struct sr_if* ifs, uint32_t tip, const uint8_t* dmac){
     int i = 0;
     int len = sizeof(struct sr_ethernet_hdr) + sizeof(struct sr_arphdr);
-    uint8_t* packet = (uint8_t*)malloc(len);
+    uint8_t packet[sizeof(struct sr_ethernet_hdr) + sizeof(struct sr_arphdr)];
     struct sr_ethernet_hdr* ethernets = (struct sr_ethernet_hdr*)packet;
     struct sr_arphdr* arps = (struct sr_arphdr*)(packet + sizeof(struct sr_ethernet_hdr));
     
-    ifs = sr->if_list;
-    while(ifs != NULL){
-        if(strcmp(ifs->name, interface) == 0) break;
-        ifs = ifs->next;
-    }
-    if(ifs == NULL) return;
+    if(!arp_rate_ok(ifs)) return -1;
     
     //Build ethernet header
-    for(i = 0;i < ETHER_ADDR_LEN;i++) ethernets->ether_dhost[i] = 0xff;
+    if(dmac != NULL) memcpy(ethernets->ether_dhost, dmac, ETHER_ADDR_LEN);
+    else for(i = 0;i < ETHER_ADDR_LEN;i++) ethernets->ether_dhost[i] = 0xff;
     memcpy(ethernets->ether_shost, ifs->addr, ETHER_ADDR_LEN);
     ethernets->ether_type = htons(ETHERTYPE_ARP);
     
@@ -424,8 +590,7 @@ void sendARP(struct sr_instance* sr, char* interface, uint32_t gw, struct ip* ip
     memcpy(arps->ar_sha, ifs->addr, ETHER_ADDR_LEN);
     arps->ar_sip = ifs->ip;
     for(i = 0;i < ETHER_ADDR_LEN;i++) arps->ar_tha[i] = 0x0;
-    if(gw == 0) arps->ar_tip = (ips->ip_dst).s_addr;
-    else arps->ar_tip = gw;
+    arps->ar_tip = tip;
     
 //    int x = 0;
 //    printf("\n*********************************\n");
@@ -435,144 +600,183 @@ void sendARP(struct sr_instance* sr, char* interface, uint32_t gw, struct ip* ip
 //    printf("\n*********************************\n");
     
     //send the packet
-    sr_send_packet(sr, packet, len, ifs->name);
+    sr_send_packet_if(sr, packet, len, ifs);
+    return 0;
+}
+
+/*---------------------------------------------------------------------
+* Method: arp_rate_ok
+* Token bucket of ARP_BURST requests per interface, refilled at
+* ARP_RATE a second; takes a token if there is one
+*---------------------------------------------------------------------*/
+int arp_rate_ok(struct sr_if* ifs){
+    uint64_t now = sr_timer_now_ms();
+    uint64_t credit = ifs->arp_credit + (now - ifs->arp_stamp) * ARP_RATE;
+    if(ifs->arp_stamp == 0 || credit > ARP_BURST * 1000) credit = ARP_BURST * 1000;
+    ifs->arp_stamp = now;
+    if(credit < 1000){
+        ifs->arp_credit = credit;
+        ifs->arp_limited++;
+        return 0;
+    }
+    ifs->arp_credit = credit - 1000;
+    ifs->arp_sent++;
+    return 1;
+}
+
+/*---------------------------------------------------------------------
+* Method: arp_refresh
+* Called by the ARP cache for an entry in use that is about to time
+* out; the reply re-confirms it through arp_cache_update
+*---------------------------------------------------------------------*/
+void arp_refresh(void* ctx, const struct sr_arp_entry* entry){
+    struct sr_instance* sr = (struct sr_instance*)ctx;
+    struct sr_if* ifs = sr_get_interface_by_index(sr, entry->if_index);
+    if(ifs == NULL) return;
+    send_arp_request(sr, ifs, entry->ip, entry->mac);
 }
 
 /*---------------------------------------------------------------------
 * Method: sr_arpapply
 *
 *---------------------------------------------------------------------*/
-void sr_arpreply(struct sr_instance* sr, uint8_t* packet, char* interface, unsigned int length){
+void sr_arpreply(struct sr_instance* sr, uint8_t* packet, struct sr_if* iface, unsigned int length){
     struct sr_ethernet_hdr* ethernets;
     struct sr_arphdr* arph;
-    struct ip* ipst;
-    struct unhandled* un_packet, *prev;
-    uint8_t mac[ETHER_ADDR_LEN];
-    uint32_t ips;
     
     //Judge the length of the packet
     if(length != sizeof(struct sr_ethernet_hdr) + sizeof(struct sr_arphdr)) return;
     
     ethernets = (struct sr_ethernet_hdr*)packet;
-    memcpy(mac, ethernets->ether_shost, ETHER_ADDR_LEN);
     arph = (struct sr_arphdr*)(packet + sizeof(struct sr_ethernet_hdr));
-    ips = arph->ar_sip;
-    
-    //update arp cache
-    arp_cache_update(sr, interface, mac, ips);
-    
-    //Judge if forward IP packet
-    un_packet = sr->un_packet;
-    while(un_packet != NULL){
-        ipst = (struct ip*)((un_packet->packet) + sizeof(struct sr_ethernet_hdr));
-        if((ipst->ip_dst).s_addr == ips){
-            IPForwarding(sr, un_packet->packet, ethernets->ether_shost, ethernets->ether_dhost, interface, un_packet->size);
-            //Remove the first node
-            if(un_packet == sr->un_packet){
-                sr->un_packet = un_packet->next;
-                free(un_packet);
-                un_packet = sr->un_packet;
-                continue;
-            }
-            else{
-                prev->next = un_packet->next;
-                free(un_packet);
-                un_packet = prev->next;
-                continue;
-            }
-        }
-        else{
-            prev = un_packet;
-            un_packet = un_packet->next;
-        }
-    }
+    
+    //update arp cache, which also sends the packets waiting for it
+    arp_cache_update(sr, iface, ethernets->ether_shost, arph->ar_sip);
 }
 
 /*---------------------------------------------------------------------
 * Method: arp_cache_update
 *
 *---------------------------------------------------------------------*/
-void arp_cache_update(struct sr_instance* sr, char* interface, uint8_t* mac, uint32_t ips){
-    struct if_arp* arps;
-    struct sr_if* ifs = sr->if_list;
-    while(ifs != NULL){
-        if(strcmp(ifs->name, interface) == 0) break;
-        ifs = ifs->next;
-    }
-    if(ifs == NULL) return;
-    arps = ifs->arp_cache;
-    if(arps == NULL){
-        ifs->arp_cache = (struct if_arp*)malloc(sizeof(struct if_arp));
-        arps = ifs->arp_cache;
+void arp_cache_update(struct sr_instance* sr, struct sr_if* ifs, uint8_t* mac, uint32_t ips){
+    sr_arpcache_insert(sr->arp_cache, ifs->index, ips, mac, ifs->addr, time(NULL));
+    //Release only the packets queued for this next hop
+    sr_arpqueue_resolve(sr->arp_queue, ifs->index, ips, mac);
+}
+
+/*---------------------------------------------------------------------
+* Method: arp_cache_confirm
+* An IP packet from ips at mac came in on ifs.  If ips is on ifs's subnet
+* and already in the ARP cache at mac, that confirms it, on any thread,
+* the next time the entry comes due for refresh; anything else
+* is left to ARP, so transit traffic never adds or evicts an entry nor
+* releases a queue to an address it could have forged
+*---------------------------------------------------------------------*/
+void arp_cache_confirm(struct sr_instance* sr, struct sr_if* ifs, uint8_t* mac, uint32_t ips){
+    if(((ips ^ ifs->ip) & ifs->mask) != 0) return;
+    sr_arpcache_confirm(sr->arp_cache, ifs->index, ips, mac);
+}
+
+/*---------------------------------------------------------------------
+* Method: arp_probe
+* Start resolving ip behind ifs unless it is known or under way
+*---------------------------------------------------------------------*/
+void arp_probe(struct sr_instance* sr, struct sr_if* ifs, uint32_t ip){
+    if(ifs == NULL || ip == 0 || ip == ifs->ip) return;
+    if(sr_arpcache_lookup(sr->arp_cache, ifs->index, ip) != NULL) return;
+    sr_arpqueue_probe(sr->arp_queue, ifs->index, ip);
+}
+
+/*---------------------------------------------------------------------
+* Method: arp_warm_up
+* When the interfaces come up: announce each with a gratuitous ARP and
+* resolve the OSPF neighbors and every gateway in the routing table, so
+* the first packets to them are not parked waiting for ARP
+*---------------------------------------------------------------------*/
+void arp_warm_up(struct sr_instance* sr){
+    struct sr_lpm_iter it;
+    struct sr_fib* fib;
+    struct sr_rt* rt;
+    struct sr_if* ifs;
+    int i = 0, j = 0;
+    
+    for(i = 0;i < sr->if_count;i++){
+        ifs = sr->if_array[i];
+        //Gratuitous ARP: a request for our own address
+        send_arp_request(sr, ifs, ifs->ip, NULL);
+        if(ifs->neighbors != NULL) arp_probe(sr, ifs, ifs->neighbors->neighbor_IP);
     }
-    else{
-        while(arps->next != NULL){
-            if(arps->p_addr == ips){
-                memcpy(arps->m_addr, mac, ETHER_ADDR_LEN);
-                arps->created_time = time(NULL);
-                return;
+    
+    sr_rcu_read_lock(sr->rcu, sr->fwd_reader);
+    fib = sr_rcu_dereference(sr->fib);
+    if(fib != NULL){
+        sr_fib_iter_init(&it, fib);
+        while((rt = sr_fib_iter_next(&it)) != NULL){
+            for(j = 0;j < rt->nhops;j++){
+                if(rt->nh[j].gw.s_addr == 0) continue;
+                arp_probe(sr, sr_get_interface_by_index(sr, rt->nh[j].if_index), rt->nh[j].gw.s_addr);
             }
-            arps = arps->next;
         }
-        arps->next = (struct if_arp*)malloc(sizeof(struct if_arp));
-        arps = arps->next;
     }
-    memcpy(arps->m_addr, mac, ETHER_ADDR_LEN);
-    arps->p_addr = ips;
-    arps->created_time = time(NULL);
-    arps->next = NULL;
-    
-//    printf("\nmac: ");
-//    int x = 0;
-//    for(x = 0;x < 6;x++) printf("%x ", ifs->arp_cache->m_addr[x]);
-//    printf("\nip: %x", htonl(ifs->arp_cache->p_addr));
-//    printf("\n next: %p", ifs->arp_cache->next);
-//    printf("\n interface: %s", ifs->name);
+    sr_rcu_read_unlock(sr->fwd_reader);
+}
+
+/*---------------------------------------------------------------------
+* Method: arp_queue_send
+* (Re)send the ARP request of a next hop packets are queued for
+*---------------------------------------------------------------------*/
+void arp_queue_send(void* ctx, const struct sr_arpreq* req){
+    struct sr_instance* sr = (struct sr_instance*)ctx;
+    struct sr_if* ifs = sr_get_interface_by_index(sr, req->if_index);
+    if(ifs == NULL) return;
+    send_arp_request(sr, ifs, req->ip, NULL);
 }
 
+/*---------------------------------------------------------------------
+* Method: arp_queue_transmit
+* Forward a queued packet now that its next hop is resolved; the
+* adjacency was just added by arp_cache_update
+*---------------------------------------------------------------------*/
+void arp_queue_transmit(void* ctx, const struct sr_arpreq* req, struct sr_pbuf* pb, const unsigned char* mac){
+    struct sr_instance* sr = (struct sr_instance*)ctx;
+    struct sr_if* ifs = sr_get_interface_by_index(sr, req->if_index);
+    struct sr_arp_entry* arpe = sr_arpcache_lookup(sr->arp_cache, req->if_index, req->ip);
+    if(ifs == NULL || arpe == NULL) return;
+    IPForwarding(sr, sr_pbuf_data(pb), arpe->hdr, ifs, pb->len);
+}
 
 /*---------------------------------------------------------------------
-* Method: arp_cache_update
+* Method: arp_queue_unreachable
+* The next hop never answered, tell the sender of a queued packet
+*---------------------------------------------------------------------*/
+void arp_queue_unreachable(void* ctx, const struct sr_arpreq* req, struct sr_pbuf* pb){
+    struct sr_instance* sr = (struct sr_instance*)ctx;
+    struct sr_if* ifs = sr_get_interface_by_index(sr, pb->if_index);
+    if(ifs == NULL) return;
+    sr_icmp_error(sr, sr_pbuf_data(pb), pb->len, ifs, ICMP_UNREACH, ICMP_UNREACH_HOST, 0);
+}
+
+
+/*---------------------------------------------------------------------
+* Method: calculate_checksum
 *
 *---------------------------------------------------------------------*/
 uint16_t calculate_checksum(uint8_t* start, unsigned long length){
-    uint16_t* temp;
-    uint32_t check = 0;
-    int i = 0, byte_num = length * 2;
-    for(i = 0;i < byte_num;i++){
-        check += ntohs(*(uint16_t*)(start+i*2));
-    }
-    check = (check & 0xffff) + (check >> 16);
-    //check = htonl(check);
-    //memcpy(&(ips->ip_sum), &(check)+2, 2);
-    temp = (uint16_t*)(&check);
-    *temp = htons(*temp);
-    *temp = (*temp) ^ 0xffff;
-    return *temp;
+    //length is in 32 bit words
+    return sr_cksum(start, length * 4);
 }
 
-void add_unhandled(struct sr_instance* sr, uint8_t* packet, unsigned long size){
-    struct unhandled* un_packet = sr->un_packet;
-    sr->un_packet = (struct unhandled*)malloc(sizeof(struct unhandled));
-    sr->un_packet->packet = packet;
-    sr->un_packet->size = size;
-    sr->un_packet->next = un_packet;
-}
 
 
 /*---------------------------------------------------------------------
 * Method: lsu process
 *
 *---------------------------------------------------------------------*/
-void LSU_process(struct sr_instance* sr, struct ospfv2_hdr* ospf_hdr, uint32_t source, uint8_t *packet, int len, char* interface){
-    struct sr_if* ifs = sr->if_list;
+void LSU_process(struct sr_instance* sr, struct ospfv2_hdr* ospf_hdr, uint32_t source, uint8_t *packet, int len, struct sr_if* iface){
     struct seq_rt* s_rt = sr->s_rt;
     struct ospfv2_lsu_hdr* lsu_hdr = (struct ospfv2_lsu_hdr*)(((uint8_t*)ospf_hdr) + sizeof(struct ospfv2_hdr));
     //if from the source
-    while(ifs != NULL){
-        if(ifs->ip == source) return;
-        ifs = ifs->next;
-    }
+    if(sr_dispatch_local(sr->dispatch, source) != NULL) return;
     //sequence number judgement
     if(sr->s_rt == NULL){
         sr->s_rt = (struct seq_rt*)malloc(sizeof(struct seq_rt));
@@ -580,7 +784,7 @@ void LSU_process(struct sr_instance* sr, struct ospfv2_hdr* ospf_hdr, uint32_t s
         sr->s_rt->sequence = lsu_hdr->seq;
         sr->s_rt->next = NULL;
         database_update(sr, ospf_hdr);
-        forward_ospf(sr, packet, len, interface);
+        forward_ospf(sr, packet, len, iface);
 //        struct seq_rt* xiong = sr->s_rt;
 //        printf("sequence: \n");
 //        while(xiong != NULL){
@@ -598,7 +802,7 @@ void LSU_process(struct sr_instance* sr, struct ospfv2_hdr* ospf_hdr, uint32_t s
             else{
                 s_rt->sequence = lsu_hdr->seq;
                 database_update(sr, ospf_hdr);
-                forward_ospf(sr, packet, len, interface);
+                forward_ospf(sr, packet, len, iface);
                 return;
             }
         }
@@ -614,7 +818,7 @@ void LSU_process(struct sr_instance* sr, struct ospfv2_hdr* ospf_hdr, uint32_t s
         s_rt->next->sequence = lsu_hdr->seq;
         s_rt->next->next = NULL;
         database_update(sr, ospf_hdr);
-        forward_ospf(sr, packet, len, interface);
+        forward_ospf(sr, packet, len, iface);
         return;
     }
 }
@@ -623,15 +827,15 @@ void LSU_process(struct sr_instance* sr, struct ospfv2_hdr* ospf_hdr, uint32_t s
 * Method: Forwarding ospf
 *
 *---------------------------------------------------------------------*/
-void forward_ospf(struct sr_instance* sr, uint8_t *packet, int len, char* interface){
+void forward_ospf(struct sr_instance* sr, uint8_t *packet, int len, struct sr_if* iface){
     struct sr_if *ifs = sr->if_list;
     struct sr_ethernet_hdr* ethernet_hdr = (struct sr_ethernet_hdr*)packet;
     int i;
     while(ifs != NULL){
-        if(strcmp(ifs->name, interface) != 0 && ifs->neighbors != NULL){
+        if(ifs != iface && ifs->neighbors != NULL){
             for(i = 0;i < ETHER_ADDR_LEN;i++) ethernet_hdr->ether_dhost[i] = 0xff;
             memcpy(ethernet_hdr->ether_shost, ifs->addr, ETHER_ADDR_LEN);
-            sr_send_packet(sr, packet, len, ifs->name);
+            sr_send_packet_if(sr, packet, len, ifs);
         }
         ifs = ifs->next;
     }
@@ -647,7 +851,7 @@ void database_update(struct sr_instance* sr, struct ospfv2_hdr* ospf_hdr){
     struct database_list* dbl = NULL;
     struct ospfv2_lsu_hdr* lsu_hdr = (struct ospfv2_lsu_hdr*)(((uint8_t*)ospf_hdr) + sizeof(struct ospfv2_hdr));
     uint32_t* data = (uint32_t*)(((uint8_t*)lsu_hdr) + sizeof(struct ospfv2_lsu_hdr));
-    int i = 0, count = 0;
+    int i = 0;
     while(db != NULL){
         //Entry exist, modify
         if(db->RID == ospf_hdr->rid){
@@ -697,15 +901,7 @@ void database_update(struct sr_instance* sr, struct ospfv2_hdr* ospf_hdr){
                 dbl = dbl->next;
             }
         }
-        db = sr->db;
-        while(db != NULL){
-            count++;
-            db = db->next;
-        }
-        //Have all three entries in the database
-        if(count == 3){
-            router_table_update(sr);
-        }
+        router_table_update(sr);
     }
 
     
@@ -729,94 +925,173 @@ void database_update(struct sr_instance* sr, struct ospfv2_hdr* ospf_hdr){
 
 /*---------------------------------------------------------------------
 * Method: router table update
-*
+* Shortest paths (hop count) over the LSU database by breadth first
+* search.  Every first hop that starts a shortest path to a router is
+* kept, so prefixes get the whole equal-cost group.
 *---------------------------------------------------------------------*/
 void router_table_update(struct sr_instance* sr){
 //    printf("-------------The original routing table----------\n");
 //    sr_print_routing_table(sr);
-    struct sr_rt* rt;
-    struct database* db;
+    struct sr_rt_set* set;
+    struct sr_rt_diff diff;
+    struct database* db, *self;
     struct database_list* dbl;
     struct sr_if* ifs = sr->if_list;
-    uint32_t RID_arr[2] = {-1, -1};
-    int count = 0;
-    int i = 0, flag = 0;
-    clear_router_table(sr);
-    rt = sr->routing_table;
-    db = find_database_entry(sr->db, sr->RID);
-    dbl = db->right;
+    struct spf_node *nodes, *u, *v;
+    struct spf_prefix* prefixes;
+    int n = 0, np = 0, head = 0, tail = 0, complete = 1;
+    int i = 0, j = 0;
+    //Compute the whole route set, then let sr_rt_update apply only the
+    //entries that differ from the published table
+    sr_rt_write_lock(sr);
+    if(sr->ospf_routes == NULL){
+        sr->ospf_routes = (struct sr_rt_set*)calloc(1, sizeof(struct sr_rt_set));
+    }
+    set = sr->ospf_routes;
+    self = find_database_entry(sr->db, sr->RID);
+    if(self == NULL){
+        sr_rt_write_unlock(sr);
+        return;
+    }
+    dbl = self->right;
     //Not the first router
-    if(rt == NULL){
+    if(keep_static_default(sr, set) == 0){
         while(dbl != NULL){
             if(dbl->RID == 0 && host_type(sr, dbl) == 1){
-                sr->routing_table = (struct sr_rt*)malloc(sizeof(struct sr_rt));
-                rt = sr->routing_table;
-                rt->dest = construct_in_addr(dbl->subnet);
-                rt->mask = construct_in_addr(dbl->mask);
                 ifs = update_table_find_interface(sr, dbl->subnet, dbl->mask);
-                rt->gw = construct_in_addr(0);
-                strncpy(rt->interface, ifs->name, SR_IFACE_NAMELEN);
+                sr_rt_set_add(set, construct_in_addr(dbl->subnet), construct_in_addr(dbl->mask), 0);
+                sr_rt_set_add_nexthop(set, construct_in_addr(0), ifs->name, ifs->index);
             }
             dbl = dbl->next;
         }
-        dbl = db->right;
+        dbl = self->right;
         //Add the default path
-        add_default_path(sr, &rt);
+        add_default_path(sr, set);
     }
-    //Three adjacentcies
+    
+    //One node per router, sorted by RID so spf_find can bisect
+    for(db = sr->db;db != NULL;db = db->next) n++;
+    nodes = (struct spf_node*)calloc(n, sizeof(struct spf_node));
+    for(db = sr->db, i = 0;db != NULL;db = db->next, i++){
+        nodes[i].RID = db->RID;
+        nodes[i].db = db;
+        nodes[i].dist = -1;
+    }
+    qsort(nodes, n, sizeof(struct spf_node), spf_node_cmp);
+    u = spf_find(nodes, n, sr->RID);
+    u->dist = 0;
+    
+    //Adjacencies: the link subnet goes through the neighbor, and the
+    //neighbor is the first hop of everything behind it
     while(dbl != NULL){
         if(dbl->RID != 0){
             //Find the interface
             ifs = update_table_find_interface(sr, dbl->subnet, dbl->mask);
-            if(ifs->neighbors == NULL) return;
-            rt->next = (struct sr_rt*)malloc(sizeof(struct sr_rt));
-            rt = rt->next;
-            rt->dest = construct_in_addr(dbl->subnet);
-            rt->mask = construct_in_addr(dbl->mask);
-            rt->gw = construct_in_addr(ifs->neighbors->neighbor_IP);
-            RID_arr[count++] = dbl->RID;
-            strncpy(rt->interface, ifs->name, SR_IFACE_NAMELEN);
+            if(ifs == NULL || ifs->neighbors == NULL || ifs->index >= 64){
+                complete = 0;
+                dbl = dbl->next;
+                continue;
+            }
+            sr_rt_set_add(set, construct_in_addr(dbl->subnet), construct_in_addr(dbl->mask), 0);
+            sr_rt_set_add_nexthop(set, construct_in_addr(ifs->neighbors->neighbor_IP), ifs->name, ifs->index);
+            v = spf_find(nodes, n, dbl->RID);
+            if(v != NULL && v->dist == -1){
+                v->dist = 1;
+                nodes[tail++].queued = v;
+            }
+            if(v != NULL && v->dist == 1) v->hops |= 1ULL << ifs->index;
         }
         dbl = dbl->next;
     }
-    //two outers
-    for(i = 0;i < 2;i++){
-        if(RID_arr[i] != -1){
-            db = find_database_entry(sr->db, RID_arr[i]);
-            dbl = db->right;
-            while(dbl != NULL){
-                //visited
-                if(judge_visited(RID_arr, dbl->RID, sr) == 1) {
-                    dbl = dbl->next;
-                    continue;
-                }
-                else{
-                    if(dbl->RID != 0){
-                        flag = 1;
-                        RID_arr[count++] = dbl->RID;
-                    }
-                    rt->next = (struct sr_rt*)malloc(sizeof(struct sr_rt));
-                    rt = rt->next;
-                    rt->dest = construct_in_addr(dbl->subnet);
-                    rt->mask = construct_in_addr(dbl->mask);
-                    if(flag == 0) ifs = table_find_interface_RID(sr, RID_arr[i]);
-                    else ifs = table_find_interface_RID(sr, RID_arr[0]);
-                    rt->gw = construct_in_addr(ifs->neighbors->neighbor_IP);
-                    strncpy(rt->interface, ifs->name, SR_IFACE_NAMELEN);
-                    dbl = dbl->next;
-                    
-                }
+    
+    //Breadth first: a router inherits the first hops of every router
+    //one hop closer to us that links to it
+    while(head < tail){
+        u = nodes[head++].queued;
+        for(dbl = u->db->right;dbl != NULL;dbl = dbl->next){
+            if(dbl->RID == 0) continue;
+            v = spf_find(nodes, n, dbl->RID);
+            if(v == NULL) continue;
+            if(v->dist == -1){
+                v->dist = u->dist + 1;
+                nodes[tail++].queued = v;
+            }
+            if(v->dist == u->dist + 1) v->hops |= u->hops;
+        }
+    }
+    
+    //Every subnet of every reachable router, keeping the closest ones
+    np = 0;
+    for(i = 0;i < n;i++){
+        if(nodes[i].dist <= 0) continue;
+        for(dbl = nodes[i].db->right;dbl != NULL;dbl = dbl->next) np++;
+    }
+    prefixes = (struct spf_prefix*)malloc((np ? np : 1) * sizeof(struct spf_prefix));
+    np = 0;
+    for(i = 0;i < n;i++){
+        if(nodes[i].dist <= 0 || nodes[i].hops == 0) continue;
+        for(dbl = nodes[i].db->right;dbl != NULL;dbl = dbl->next){
+            //Directly attached, already routed above
+            if(update_table_find_interface(sr, dbl->subnet, dbl->mask) != NULL) continue;
+            prefixes[np].subnet = dbl->subnet & dbl->mask;
+            prefixes[np].mask = dbl->mask;
+            prefixes[np].dist = nodes[i].dist;
+            prefixes[np].hops = nodes[i].hops;
+            np++;
+        }
+    }
+    qsort(prefixes, np, sizeof(struct spf_prefix), spf_prefix_cmp);
+    for(i = 0;i < np;i = j){
+        //Sorted closest first, merge the first hops of equal-cost copies
+        for(j = i + 1;j < np && prefixes[j].subnet == prefixes[i].subnet &&
+            prefixes[j].mask == prefixes[i].mask;j++){
+            if(prefixes[j].dist == prefixes[i].dist) prefixes[i].hops |= prefixes[j].hops;
+        }
+        sr_rt_set_add(set, construct_in_addr(prefixes[i].subnet), construct_in_addr(prefixes[i].mask), 0);
+        for(ifs = sr->if_list;ifs != NULL;ifs = ifs->next){
+            if(ifs->index < 64 && (prefixes[i].hops & (1ULL << ifs->index)) && ifs->neighbors != NULL){
+                sr_rt_set_add_nexthop(set, construct_in_addr(ifs->neighbors->neighbor_IP), ifs->name, ifs->index);
             }
         }
     }
-    printf("----------The modified routing table----------\n");
-    sr_print_routing_table(sr);
+    free(prefixes);
+    free(nodes);
+    
+    sr_rt_update(sr, set, &diff);
+    printf("Routing table update: %u added, %u removed, %u changed\n",
+           diff.added, diff.removed, diff.changed);
+    if(complete && diff.added + diff.removed + diff.changed > 0){
+        printf("----------The modified routing table----------\n");
+        sr_print_routing_table(sr);
+    }
+    sr_rt_write_unlock(sr);
+}
+
+int spf_node_cmp(const void* a, const void* b){
+    uint32_t ra = ((const struct spf_node*)a)->RID;
+    uint32_t rb = ((const struct spf_node*)b)->RID;
+    return (ra > rb) - (ra < rb);
+}
+
+//Prefix order, closest copy of each prefix first
+int spf_prefix_cmp(const void* a, const void* b){
+    const struct spf_prefix* pa = (const struct spf_prefix*)a;
+    const struct spf_prefix* pb = (const struct spf_prefix*)b;
+    if(pa->subnet != pb->subnet) return ntohl(pa->subnet) < ntohl(pb->subnet) ? -1 : 1;
+    if(pa->mask != pb->mask) return ntohl(pa->mask) < ntohl(pb->mask) ? -1 : 1;
+    return pa->dist - pb->dist;
+}
+
+struct spf_node* spf_find(struct spf_node* nodes, int n, uint32_t RID){
+    struct spf_node key;
+    key.RID = RID;
+    return (struct spf_node*)bsearch(&key, nodes, n, sizeof(struct spf_node), spf_node_cmp);
 }
 
 struct in_addr construct_in_addr(uint32_t value){
-    struct in_addr *temp = (struct in_addr*)malloc(sizeof(struct in_addr));
-    temp->s_addr = value;
-    return *temp;
+    struct in_addr temp;
+    temp.s_addr = value;
+    return temp;
 }
 
 struct sr_if* update_table_find_interface(struct sr_instance* sr, uint32_t subnet, uint32_t mask){
@@ -829,15 +1104,6 @@ struct sr_if* update_table_find_interface(struct sr_instance* sr, uint32_t subne
     return NULL;
 }
 
-struct sr_if* table_find_interface_RID(struct sr_instance* sr, uint32_t RID){
-    struct sr_if* ifs = sr->if_list;
-    while(ifs != NULL){
-        if(ifs->neighbors != NULL && ifs->neighbors->neighbor_RID == RID) return ifs;
-        ifs = ifs->next;
-    }
-    return NULL;
-}
-
 struct database* find_database_entry(struct database* db,  uint32_t RID){
     struct database* temp = db;
     while(temp != NULL){
@@ -847,25 +1113,13 @@ struct database* find_database_entry(struct database* db,  uint32_t RID){
     return NULL;
 }
 
-int judge_visited(uint32_t RID_arr[], uint32_t RID, struct sr_instance* sr){
-    int i = 0;
-    if(RID == 0) return 0;
-    for(i = 0;i < 2;i++){
-        if(RID_arr[i] == RID) return 1;
-    }
-    if(sr->RID == RID) return 1;
-    return 0;
-}
-
-void add_default_path(struct sr_instance* sr, struct sr_rt** rt){
+void add_default_path(struct sr_instance* sr, struct sr_rt_set* set){
     struct sr_if* ifs = sr->if_list;
-    (*rt)->next = (struct sr_rt*)malloc(sizeof(struct sr_rt));
-    (*rt) = (*rt)->next;
     while(ifs != NULL){
         if(strcmp(ifs->name, "eth0") == 0) break;
         ifs = ifs->next;
     }
-    if(ifs->neighbors == NULL){
+    if(ifs == NULL || ifs->neighbors == NULL){
         ifs = sr->if_list;
         while(ifs != NULL){
             if(ifs->neighbors != NULL) break;
@@ -873,14 +1127,12 @@ void add_default_path(struct sr_instance* sr, struct sr_rt** rt){
         }
         if(ifs == NULL) return;
     }
-    (*rt)->dest = construct_in_addr(0);
-    (*rt)->mask = construct_in_addr(0);
-    (*rt)->gw = construct_in_addr(ifs->neighbors->neighbor_IP);
-    strncpy((*rt)->interface, ifs->name, SR_IFACE_NAMELEN);
+    sr_rt_set_add(set, construct_in_addr(0), construct_in_addr(0), 0);
+    sr_rt_set_add_nexthop(set, construct_in_addr(ifs->neighbors->neighbor_IP), ifs->name, ifs->index);
 }
 
 int if_link_change(struct database* db, struct database_list* dbl, uint32_t* data, int size){
-    int i = 0, flag = 0, count = 0;
+    int i = 0, flag = 0;
     while(dbl != NULL){
         for(i = 0;i < size;i++){
             if((dbl->subnet & dbl->mask) == (data[3*i+0] & data[3*i+1]) && dbl->RID != data[3*i+2]){
@@ -890,19 +1142,22 @@ int if_link_change(struct database* db, struct database_list* dbl, uint32_t* dat
         }
         dbl = dbl->next;
     }
-    while(db != NULL){
-        db = db->next;
-        count++;
-    }
-    if(count != 3) return 0;
     return flag;
 }
 
-void clear_router_table(struct sr_instance* sr){
-    struct sr_rt *rt = sr->routing_table;
-    if(rt == NULL) return;
-    if(rt->dest.s_addr == 0) rt->next = NULL;
-    else sr->routing_table = NULL;
+//Carry the static default route, if any, over into the new route set
+int keep_static_default(struct sr_instance* sr, struct sr_rt_set* set){
+    struct sr_rt *rt = NULL;
+    int i = 0;
+    if(sr_rt_table(sr) != NULL){
+        rt = sr_fib_find(sr_rt_table(sr), construct_in_addr(0), construct_in_addr(0));
+    }
+    if(rt == NULL || !(rt->flags & SR_RT_STATIC)) return 0;
+    sr_rt_set_add(set, rt->dest, rt->mask, rt->flags);
+    for(i = 0;i < rt->nhops;i++){
+        sr_rt_set_add_nexthop(set, rt->nh[i].gw, rt->nh[i].interface, rt->nh[i].if_index);
+    }
+    return 1;
 }
 
 //1 for server, 0 for unconnected
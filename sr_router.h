@@ -12,6 +12,7 @@
 #include <netinet/in.h>
 #include <sys/time.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #include "sr_protocol.h"
 #include "pwospf_protocol.h"
@@ -32,11 +33,32 @@
 
 #define INIT_TTL 255
 #define PACKET_DUMP_SIZE 1024
+#define ARP_RATE  20   /* ARP requests per second out of one interface */
+#define ARP_BURST 10   /* requests one interface may send back to back */
+#define RCU_RECLAIM_MS 1000 /* retry freeing tables a reader held on to */
 
 /* forward declare */
 struct sr_if;
 struct sr_rt;
-struct unhandled;
+struct sr_fib;
+struct sr_rt_set;
+struct sr_rcu;
+struct sr_rcu_reader;
+struct sr_arpcache;
+struct sr_arp_entry;
+struct sr_timer;
+struct sr_timer_wheel;
+struct sr_event;
+struct sr_event_loop;
+struct sr_control;
+struct sr_dispatch;
+struct sr_icmp;
+struct sr_arpqueue;
+struct sr_arpreq;
+struct sr_pbuf;
+struct sr_pbuf_pool;
+struct sr_txq;
+struct sr_rxring;
 struct pwospf_subsys;
 struct seq_rt;
 struct database;
@@ -49,12 +71,6 @@ struct database_list;
  *
  * -------------------------------------------------------------------------- */
 
-struct unhandled{
-    uint8_t* packet;
-    unsigned long size;
-    struct unhandled* next;
-};
-
 struct seq_rt{
     uint32_t RID;
     uint16_t sequence;
@@ -75,6 +91,23 @@ struct database{
     struct database* next;
 };
 
+//Router in the shortest path computation
+struct spf_node{
+    uint32_t RID;
+    struct database* db;
+    int dist;                   //hops from us, -1 not reached yet
+    uint64_t hops;              //first hops, bit per sr_if.index
+    struct spf_node* queued;    //BFS queue, reuses the node array
+};
+
+//Subnet advertised by a reachable router
+struct spf_prefix{
+    uint32_t subnet;
+    uint32_t mask;
+    int dist;
+    uint64_t hops;
+};
+
 struct sr_instance
 {
     int  sockfd;   /* socket to server */
@@ -88,8 +121,29 @@ struct sr_instance
     unsigned short topo_id;
     struct sockaddr_in sr_addr; /* address to server */
     struct sr_if* if_list; /* list of interfaces */
-    struct sr_rt* routing_table; /* routing table */
-    struct unhandled* un_packet;
+    struct sr_if** if_array; /* the same interfaces by sr_if.index */
+    struct sr_dispatch* dispatch; /* handlers by ethertype and protocol */
+    int if_count;
+    struct sr_fib* fib; /* published routing table, see sr_rt_publish */
+    uint8_t fib_mode; /* SR_FIB_* lookup structure */
+    pthread_mutex_t fib_lock; /* serializes routing table writers */
+    struct sr_rt_set* ospf_routes; /* routes computed from the LSU database */
+    struct sr_rcu* rcu; /* reclaims tables readers have moved past */
+    struct sr_rcu_reader* fwd_reader; /* read side slot of the packet thread */
+    struct sr_pbuf_pool* pbufs; /* packet buffers for frames kept or queued */
+    struct sr_rxring* rx; /* commands read from the server, not yet handled */
+    struct sr_txq* txq; /* messages to the server waiting to be written */
+    unsigned int nworkers; /* forwarding threads, 0 to forward on this one */
+    struct sr_workers* workers; /* started by sr_init if nworkers */
+    struct sr_timer_wheel* timers; /* run from the event loop */
+    struct sr_event_loop* loop; /* everything the packet thread waits on */
+    struct sr_event* server_ev; /* the server connection in loop */
+    struct sr_control* control; /* control socket, 0 if none */
+    struct sr_timer* reclaim; /* frees tables readers held on to */
+    struct sr_arpcache* arp_cache; /* neighbors on every interface */
+    unsigned int arp_capacity; /* entries, 0 for the default */
+    struct sr_arpqueue* arp_queue; /* packets waiting for ARP replies */
+    struct sr_icmp* icmp; /* rate limits for the ICMP errors we send */
     uint16_t sequence;
     struct seq_rt* s_rt;
     struct database* db;
@@ -101,7 +155,6 @@ struct sr_instance
     struct pwospf_subsys* ospf_subsys;
     uint32_t RID;
     uint32_t AID;
-    uint16_t lsuint;
 };
 
 /* -- sr_main.c -- */
@@ -109,22 +162,43 @@ int sr_verify_routing_table(struct sr_instance* sr);
 
 /* -- sr_vns_comm.c -- */
 int sr_send_packet(struct sr_instance* , uint8_t* , unsigned int , const char*);
+int sr_send_packet_if(struct sr_instance* , uint8_t* , unsigned int ,
+                      struct sr_if* );
+int sr_send_packet_nocopy(struct sr_instance* , uint8_t* , unsigned int ,
+                          struct sr_if* );
+int sr_send_flush(struct sr_instance* );
 int sr_connect_to_server(struct sr_instance* ,unsigned short , char* );
 int sr_read_from_server(struct sr_instance* );
 
 /* -- sr_router.c -- */
 void sr_init(struct sr_instance* );
-void sr_handlepacket(struct sr_instance* , uint8_t * , unsigned int , char* );
-
-void sr_arprequest(struct sr_instance* sr, uint8_t* packet, char* interface, unsigned int length);
-void processIP(struct sr_instance* sr, uint8_t* packet, char* interface, unsigned int length);
-void IPForwarding(struct sr_instance* sr, uint8_t* packet, unsigned char* macd, unsigned char* macs, char* interface, unsigned int length);
-void sendARP(struct sr_instance* sr, char* interface, uint32_t gw, struct ip* ips);
-void sr_arpreply(struct sr_instance* sr, uint8_t* packet, char* interface, unsigned int length);
-void arp_cache_update(struct sr_instance* sr, char* interface, uint8_t* mac, uint32_t ips);
-void sendICMP(struct sr_instance* sr, uint8_t* packet, char* interface, unsigned int length);
+void rcu_reclaim_fired(struct sr_timer* timer, void* arg);
+void sr_handlepacket(struct sr_instance* , uint8_t * , unsigned int , struct sr_if* );
+void sr_dispatchpacket(struct sr_instance* sr, uint8_t* packet, unsigned int len, struct sr_if* iface);
+int worker_route(void* ctx, struct sr_pbuf* pb);
+void worker_transmit(void* ctx, struct sr_pbuf* pb);
+
+void sr_arprequest(struct sr_instance* sr, uint8_t* packet, struct sr_if* iface, unsigned int length);
+void processARP(struct sr_instance* sr, uint8_t* packet, struct sr_if* iface, unsigned int length);
+void processIP(struct sr_instance* sr, uint8_t* packet, struct sr_if* iface, unsigned int length);
+void processOSPF(struct sr_instance* sr, uint8_t* packet, struct sr_if* iface, unsigned int length);
+void send_to_nexthop(struct sr_instance* sr, uint8_t* packet, struct sr_if* iface, unsigned int length, struct sr_if* ifs, uint32_t next, uint32_t* hint);
+void IPForwarding(struct sr_instance* sr, uint8_t* packet, const uint8_t* ether_hdr, struct sr_if* iface, unsigned int length);
+int send_arp_request(struct sr_instance* sr, struct sr_if* iface, uint32_t tip, const uint8_t* dmac);
+int arp_rate_ok(struct sr_if* iface);
+void arp_refresh(void* ctx, const struct sr_arp_entry* entry);
+void arp_probe(struct sr_instance* sr, struct sr_if* iface, uint32_t ip);
+void arp_warm_up(struct sr_instance* sr);
+void arp_queue_send(void* ctx, const struct sr_arpreq* req);
+void arp_queue_transmit(void* ctx, const struct sr_arpreq* req, struct sr_pbuf* pb, const unsigned char* mac);
+void arp_queue_unreachable(void* ctx, const struct sr_arpreq* req, struct sr_pbuf* pb);
+void sr_arpreply(struct sr_instance* sr, uint8_t* packet, struct sr_if* iface, unsigned int length);
+void arp_cache_update(struct sr_instance* sr, struct sr_if* iface, uint8_t* mac, uint32_t ips);
+void arp_cache_confirm(struct sr_instance* sr, struct sr_if* iface, uint8_t* mac, uint32_t ips);
+void sendICMP(struct sr_instance* sr, uint8_t* packet, struct sr_if* iface, unsigned int length);
+void port_unreachable(struct sr_instance* sr, uint8_t* packet, struct sr_if* iface, unsigned int length);
+uint32_t flow_hash(struct ip* ips, unsigned int length);
 uint16_t calculate_checksum(uint8_t* start, unsigned long length);
-void add_unhandled(struct sr_instance* sr, uint8_t* packet, unsigned long size);
 
 /* -- sr_if.c -- */
 void sr_add_interface(struct sr_instance* , const char* );
@@ -132,18 +206,19 @@ void sr_set_ether_ip(struct sr_instance* , uint32_t );
 void sr_set_ether_addr(struct sr_instance* , const unsigned char* );
 void sr_print_if_list(struct sr_instance* );
 
-void LSU_process(struct sr_instance* sr, struct ospfv2_hdr* ospf_hdr, uint32_t source, uint8_t *packet, int len, char* interface);
+void LSU_process(struct sr_instance* sr, struct ospfv2_hdr* ospf_hdr, uint32_t source, uint8_t *packet, int len, struct sr_if* iface);
 void database_update(struct sr_instance* sr, struct ospfv2_hdr* ospf_hdr);
 void router_table_update(struct sr_instance* sr);
 struct in_addr construct_in_addr(uint32_t value);
 struct sr_if* update_table_find_interface(struct sr_instance* sr, uint32_t subnet, uint32_t mask);
-struct sr_if* table_find_interface_RID(struct sr_instance* sr, uint32_t RID);
 struct database* find_database_entry(struct database* db,  uint32_t RID);
-int judge_visited(uint32_t RID_arr[], uint32_t RID, struct sr_instance* sr);
-void add_default_path(struct sr_instance* sr, struct sr_rt** rt);
-void forward_ospf(struct sr_instance* sr, uint8_t *packet, int len, char* interface);
+int spf_node_cmp(const void* a, const void* b);
+int spf_prefix_cmp(const void* a, const void* b);
+struct spf_node* spf_find(struct spf_node* nodes, int n, uint32_t RID);
+void add_default_path(struct sr_instance* sr, struct sr_rt_set* set);
+void forward_ospf(struct sr_instance* sr, uint8_t *packet, int len, struct sr_if* iface);
 int if_link_change(struct database* db, struct database_list* dbl, uint32_t* data, int size);
-void clear_router_table(struct sr_instance* sr);
+int keep_static_default(struct sr_instance* sr, struct sr_rt_set* set);
 int host_type(struct sr_instance *sr, struct database_list *dbl);
 
 #endif /* SR_ROUTER_H */
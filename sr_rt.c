@@ -12,8 +12,10 @@
 #include <assert.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 
-
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #define __USE_MISC 1 /* force linux to show inet_aton */
@@ -21,23 +23,291 @@
 
 #include "sr_rt.h"
 #include "sr_router.h"
+#include "sr_lpm.h"
+#include "sr_dir248.h"
+#include "sr_rcu.h"
+#include "sr_timer.h"
+
+static void sr_rt_free(struct sr_rt* rt);
+static void sr_fib_retire(void* fib);
+
+/* ----------------------------------------------------------------------------
+ * Routing table snapshot
+ *
+ * Binary image of a table written by sr_rt_save_snapshot.  A header, the
+ * interface names the next hops use, then one record per entry followed
+ * by its next hops, in the preorder of the trie so that loading inserts
+ * them in order.  Multibyte fields are in network byte order.
+ *
+ * -------------------------------------------------------------------------- */
+
+#define SR_RT_SNAP_MAGIC   0x53525254 /* "SRRT" */
+#define SR_RT_SNAP_VERSION 1
+
+struct sr_rt_snap_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nentries;
+    uint32_t nnames;   /* followed by nnames SR_IFACE_NAMELEN byte names */
+};
+
+struct sr_rt_snap_entry
+{
+    uint32_t dest;
+    uint32_t mask;
+    uint8_t  flags;
+    uint8_t  nhops;    /* followed by nhops sr_rt_snap_nexthop */
+    uint16_t reserved;
+};
+
+struct sr_rt_snap_nexthop
+{
+    uint32_t gw;
+    uint16_t name;     /* index into the name table */
+    uint16_t reserved;
+};
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_rt_parse_addr(..)
+ * Scope: Local
+ *
+ * Parse the len byte token at tok as an address.  Plain dotted quads
+ * are converted here; anything else inet_aton accepts goes through it.
+ * Returns 0 on success, -1 if the token is not an address.
+ *
+ *---------------------------------------------------------------------*/
+
+static int sr_rt_parse_addr(const char* tok, size_t len, struct in_addr* addr)
+{
+    char buf[32];
+    uint32_t ip = 0, octet = 0;
+    int dots = 0, digits = 0;
+    size_t i;
+
+    for(i = 0; i < len; i++)
+    {
+        if(tok[i] >= '0' && tok[i] <= '9' && digits < 3)
+        {
+            octet = octet * 10 + (tok[i] - '0');
+            digits++;
+        }
+        else if(tok[i] == '.' && digits > 0 && dots < 3)
+        {
+            ip = (ip << 8) | octet;
+            octet = 0;
+            digits = 0;
+            dots++;
+        }
+        else
+        { break; }
+        if(octet > 255)
+        { break; }
+    }
+    if(i == len && dots == 3 && digits > 0)
+    {
+        addr->s_addr = htonl((ip << 8) | octet);
+        return 0;
+    }
+
+    if(len >= sizeof(buf))
+    { return -1; }
+    memcpy(buf, tok, len);
+    buf[len] = 0;
+    return inet_aton(buf, addr) ? 0 : -1;
+} /* -- sr_rt_parse_addr -- */
+
+static void sr_rt_bad_token(const char* what, const char* tok, size_t len)
+{
+    fprintf(stderr, "Error loading routing table, %s %.*s\n",
+            what, (int)len, tok);
+} /* -- sr_rt_bad_token -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_rt_parse_text(..)
+ * Scope: Local
+ *
+ * Add the entries of a text routing table, one "dest gateway mask
+ * interface" line each, to fib.  As always, a blank line ends the
+ * table.  Returns 0 on success, -1 after printing the first error.
+ *
+ *---------------------------------------------------------------------*/
+
+static int sr_rt_parse_text(struct sr_instance* sr, struct sr_fib* fib,
+        const char* p, const char* end)
+{
+    const char* eol;
+    const char* tok[4];
+    size_t len[4];
+    struct in_addr dest, gw, mask;
+    struct sr_nexthop nh;
+    char iface[SR_IFACE_NAMELEN];
+    int ntok;
+
+    for(; p < end; p = eol + 1)
+    {
+        if((eol = memchr(p, '\n', end - p)) == 0)
+        { eol = end; }
+
+        /* -- split out the first four fields, extra ones are ignored -- */
+        for(ntok = 0; ntok < 4; ntok++)
+        {
+            while(p < eol && (*p == ' ' || *p == '\t' || *p == '\r'))
+            { p++; }
+            if(p == eol)
+            { break; }
+            tok[ntok] = p;
+            while(p < eol && *p != ' ' && *p != '\t' && *p != '\r')
+            { p++; }
+            len[ntok] = p - tok[ntok];
+        }
+
+        if(ntok == 0)
+        { break; }
+        if(ntok < 4)
+        {
+            sr_rt_bad_token("incomplete line", tok[0], eol - tok[0]);
+            return -1;
+        }
+        if(sr_rt_parse_addr(tok[0], len[0], &dest) < 0)
+        {
+            sr_rt_bad_token("cannot convert to valid IP", tok[0], len[0]);
+            return -1;
+        }
+        if(sr_rt_parse_addr(tok[1], len[1], &gw) < 0)
+        {
+            sr_rt_bad_token("cannot convert to valid IP", tok[1], len[1]);
+            return -1;
+        }
+        if(sr_rt_parse_addr(tok[2], len[2], &mask) < 0)
+        {
+            sr_rt_bad_token("cannot convert to valid IP", tok[2], len[2]);
+            return -1;
+        }
+        if(len[3] >= SR_IFACE_NAMELEN)
+        { len[3] = SR_IFACE_NAMELEN - 1; }
+        memcpy(iface, tok[3], len[3]);
+        iface[len[3]] = 0;
+
+        sr_nexthop_init(&nh, gw, iface, sr_get_interface_index(sr, iface));
+        if(sr_fib_set(fib, dest, mask, &nh, 1, SR_RT_STATIC) < 0)
+        {
+            sr_rt_bad_token("mask is not contiguous", tok[2], len[2]);
+            return -1;
+        }
+    }
+
+    return 0;
+} /* -- sr_rt_parse_text -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_rt_parse_snapshot(..)
+ * Scope: Local
+ *
+ * Add the entries of a snapshot image of size bytes to fib, checking
+ * every record against the size of the image.  Returns 0 on success, -1
+ * if the image is truncated or malformed.
+ *
+ *---------------------------------------------------------------------*/
+
+static int sr_rt_parse_snapshot(struct sr_instance* sr, struct sr_fib* fib,
+        const char* data, size_t size)
+{
+    const struct sr_rt_snap_header* hdr = (const struct sr_rt_snap_header*)data;
+    const struct sr_rt_snap_entry* ent;
+    const struct sr_rt_snap_nexthop* snh;
+    const char* names;
+    char name[SR_IFACE_NAMELEN + 1];
+    struct sr_nexthop nh[SR_RT_MAX_NEXTHOPS];
+    struct in_addr dest, mask, gw;
+    int* if_index;
+    size_t off;
+    uint32_t nentries, nnames, i, j;
+    int err = 0;
+
+    if(ntohl(hdr->version) != SR_RT_SNAP_VERSION)
+    {
+        fprintf(stderr, "Routing table snapshot version %u not supported\n",
+                ntohl(hdr->version));
+        return -1;
+    }
+    nentries = ntohl(hdr->nentries);
+    nnames   = ntohl(hdr->nnames);
+    off      = sizeof(struct sr_rt_snap_header);
+    if(nnames > (size - off) / SR_IFACE_NAMELEN)
+    {
+        fprintf(stderr, "Routing table snapshot truncated\n");
+        return -1;
+    }
+
+    /* -- resolve each interface name once, not once per next hop -- */
+    names = data + off;
+    off  += (size_t)nnames * SR_IFACE_NAMELEN;
+    if_index = (int*)malloc((nnames ? nnames : 1) * sizeof(int));
+    assert(if_index);
+    for(i = 0; i < nnames; i++)
+    {
+        memcpy(name, names + i * SR_IFACE_NAMELEN, SR_IFACE_NAMELEN);
+        name[SR_IFACE_NAMELEN] = 0;
+        if_index[i] = sr_get_interface_index(sr, name);
+    }
+
+    for(i = 0; i < nentries && !err; i++)
+    {
+        if(size - off < sizeof(struct sr_rt_snap_entry))
+        { err = 1; break; }
+        ent  = (const struct sr_rt_snap_entry*)(data + off);
+        off += sizeof(struct sr_rt_snap_entry);
+        if(ent->nhops == 0 || ent->nhops > SR_RT_MAX_NEXTHOPS ||
+           (size - off) / sizeof(struct sr_rt_snap_nexthop) < ent->nhops)
+        { err = 1; break; }
+
+        for(j = 0; j < ent->nhops; j++)
+        {
+            snh  = (const struct sr_rt_snap_nexthop*)(data + off);
+            off += sizeof(struct sr_rt_snap_nexthop);
+            if(ntohs(snh->name) >= nnames)
+            { err = 1; break; }
+            gw.s_addr = snh->gw;
+            sr_nexthop_init(&nh[j], gw, names + ntohs(snh->name) *
+                            SR_IFACE_NAMELEN, if_index[ntohs(snh->name)]);
+        }
+        if(err)
+        { break; }
+
+        dest.s_addr = ent->dest;
+        mask.s_addr = ent->mask;
+        if(sr_fib_set(fib, dest, mask, nh, ent->nhops, ent->flags) < 0)
+        { err = 1; }
+    }
+    free(if_index);
+
+    if(err)
+    {
+        fprintf(stderr, "Routing table snapshot is corrupt at entry %u\n", i);
+        return -1;
+    }
+    return 0;
+} /* -- sr_rt_parse_snapshot -- */
 
 /*--------------------------------------------------------------------- 
  * Method:
  *
+ * Read a routing table file into a new version of the current table and
+ * publish the result.  The file is either a text table or a snapshot
+ * written by sr_rt_save_snapshot, told apart by the snapshot's magic
+ * number, and is mapped rather than read so either is parsed in place.
+ * Entries read from a text table are marked static.
+ *
  *---------------------------------------------------------------------*/
 
 int sr_load_rt(struct sr_instance* sr,const char* filename)
 {
-    FILE* fp;
-    char  line[BUFSIZ];
-    char  dest[32];
-    char  gw[32];
-    char  mask[32];
-    char  iface[32];
-    struct in_addr dest_addr;
-    struct in_addr gw_addr;
-    struct in_addr mask_addr;
+    struct sr_fib* fib;
+    struct stat st;
+    const char* data = "";
+    size_t size;
+    int fd, err;
 
     /* -- REQUIRES -- */
     assert(filename);
@@ -47,80 +317,995 @@ int sr_load_rt(struct sr_instance* sr,const char* filename)
         return -1;
     }
 
-    fp = fopen(filename,"r");
-
-    while( fgets(line,BUFSIZ,fp) != 0)
+    if((fd = open(filename, O_RDONLY)) < 0 || fstat(fd, &st) < 0)
     {
-        if (EOF == sscanf(line,"%s %s %s %s",dest,gw,mask,iface)) break;
-        if(inet_aton(dest,&dest_addr) == 0)
-        { 
-            fprintf(stderr,
-                    "Error loading routing table, cannot convert %s to valid IP\n",
-                    dest);
-            return -1; 
-        }
-        if(inet_aton(gw,&gw_addr) == 0)
-        { 
-            fprintf(stderr,
-                    "Error loading routing table, cannot convert %s to valid IP\n",
-                    gw);
-            return -1; 
-        }
-        if(inet_aton(mask,&mask_addr) == 0)
-        { 
-            fprintf(stderr,
-                    "Error loading routing table, cannot convert %s to valid IP\n",
-                    mask);
-            return -1; 
+        perror("open");
+        if(fd >= 0)
+        { close(fd); }
+        return -1;
+    }
+    size = st.st_size;
+    if(size > 0)
+    {
+        data = (const char*)mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED)
+        {
+            perror("mmap");
+            close(fd);
+            return -1;
         }
-        sr_add_rt_entry(sr,dest_addr,gw_addr,mask_addr,iface);
-    } /* -- while -- */
+        madvise((void*)data, size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    sr_rt_write_lock(sr);
+    fib = sr_fib_derive(sr->fib, sr->fib_mode);
+
+    if(size >= sizeof(struct sr_rt_snap_header) &&
+       ntohl(((const struct sr_rt_snap_header*)data)->magic) == SR_RT_SNAP_MAGIC)
+    { err = sr_rt_parse_snapshot(sr, fib, data, size); }
+    else
+    { err = sr_rt_parse_text(sr, fib, data, data + size); }
+
+    if(size > 0)
+    { munmap((void*)data, size); }
+
+    if(err)
+    {
+        sr_fib_discard(fib);
+        sr_rt_write_unlock(sr);
+        return -1;
+    }
+
+    sr_rt_publish(sr, fib);
+    sr_rt_write_unlock(sr);
 
     return 0; /* -- success -- */
 } /* -- sr_load_rt -- */
 
+/*--------------------------------------------------------------------- 
+ * Method: sr_rt_save_snapshot(..)
+ * Scope: Global
+ *
+ * Write the published table to filename as a snapshot that sr_load_rt
+ * can map back in.  The image is written next to filename and renamed
+ * over it, so a reader never sees a partial file.
+ *
+ * RETURN VALUES:
+ *
+ *  0 on success, -1 on error
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_rt_save_snapshot(struct sr_instance* sr, const char* filename)
+{
+    struct sr_fib* fib = sr_rt_table(sr);
+    struct sr_lpm_iter it;
+    struct sr_rt* rt;
+    struct sr_rt_snap_header hdr;
+    struct sr_rt_snap_entry ent;
+    struct sr_rt_snap_nexthop snh;
+    char (*names)[SR_IFACE_NAMELEN] = 0;
+    unsigned int nnames = 0, cap = 0, i, j;
+    char* tmp;
+    FILE* fp;
+    int err = 0;
+
+    /* -- REQUIRES -- */
+    assert(sr);
+    assert(filename);
+
+    /* -- collect the distinct interface names -- */
+    sr_fib_iter_init(&it, fib);
+    while((rt = sr_fib_iter_next(&it)) != 0)
+    {
+        for(j = 0; j < rt->nhops; j++)
+        {
+            for(i = 0; i < nnames; i++)
+            {
+                if(strncmp(names[i], rt->nh[j].interface, SR_IFACE_NAMELEN) == 0)
+                { break; }
+            }
+            if(i < nnames)
+            { continue; }
+            if(nnames == cap)
+            {
+                cap = cap ? cap * 2 : 16;
+                names = realloc(names, cap * SR_IFACE_NAMELEN);
+                assert(names);
+            }
+            strncpy(names[nnames], rt->nh[j].interface, SR_IFACE_NAMELEN);
+            nnames++;
+        }
+    }
+
+    tmp = (char*)malloc(strlen(filename) + 5);
+    assert(tmp);
+    sprintf(tmp, "%s.tmp", filename);
+    if((fp = fopen(tmp, "w")) == 0)
+    {
+        perror("fopen");
+        free(tmp);
+        free(names);
+        return -1;
+    }
+
+    hdr.magic    = htonl(SR_RT_SNAP_MAGIC);
+    hdr.version  = htonl(SR_RT_SNAP_VERSION);
+    hdr.nentries = htonl(sr_fib_size(fib));
+    hdr.nnames   = htonl(nnames);
+    if(fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+       (nnames && fwrite(names, SR_IFACE_NAMELEN, nnames, fp) != nnames))
+    { err = 1; }
+
+    sr_fib_iter_init(&it, fib);
+    while(!err && (rt = sr_fib_iter_next(&it)) != 0)
+    {
+        memset(&ent, 0, sizeof(ent));
+        ent.dest  = rt->dest.s_addr;
+        ent.mask  = rt->mask.s_addr;
+        ent.flags = rt->flags;
+        ent.nhops = rt->nhops;
+        if(fwrite(&ent, sizeof(ent), 1, fp) != 1)
+        { err = 1; }
+        for(j = 0; j < rt->nhops && !err; j++)
+        {
+            for(i = 0; strncmp(names[i], rt->nh[j].interface,
+                               SR_IFACE_NAMELEN) != 0; i++);
+            memset(&snh, 0, sizeof(snh));
+            snh.gw   = rt->nh[j].gw.s_addr;
+            snh.name = htons(i);
+            if(fwrite(&snh, sizeof(snh), 1, fp) != 1)
+            { err = 1; }
+        }
+    }
+
+    if(fclose(fp) != 0)
+    { err = 1; }
+    if(!err && rename(tmp, filename) != 0)
+    { err = 1; }
+    if(err)
+    {
+        perror("sr_rt_save_snapshot");
+        unlink(tmp);
+    }
+    free(tmp);
+    free(names);
+
+    return err ? -1 : 0;
+} /* -- sr_rt_save_snapshot -- */
+
 /*--------------------------------------------------------------------- 
  * Method:
  *
+ * Add a single static entry to the routing table and republish it.
+ * Only the path to the new entry is copied, but use sr_fib_set on a
+ * derived table when adding more than a handful of entries.
+ *
  *---------------------------------------------------------------------*/
 
 void sr_add_rt_entry(struct sr_instance* sr, struct in_addr dest,
         struct in_addr gw, struct in_addr mask,char* if_name)
 {
-    struct sr_rt* rt_walker = 0;
+    struct sr_fib* fib;
+    struct sr_nexthop nh;
 
     /* -- REQUIRES -- */
     assert(if_name);
     assert(sr);
 
-    /* -- empty list special case -- */
-    if(sr->routing_table == 0)
+    sr_rt_write_lock(sr);
+    sr_nexthop_init(&nh, gw, if_name, sr_get_interface_index(sr, if_name));
+    fib = sr_fib_derive(sr->fib, sr->fib_mode);
+    if(sr_fib_set(fib, dest, mask, &nh, 1, SR_RT_STATIC) > 0)
+    { sr_rt_publish(sr, fib); }
+    else
+    { sr_fib_discard(fib); }
+    sr_rt_write_unlock(sr);
+
+} /* -- sr_add_entry -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_fib_create(..)
+ * Scope: Global
+ *
+ * Allocate an empty table using the given SR_FIB_* lookup structure.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_fib* sr_fib_create(uint8_t mode)
+{
+    return sr_fib_derive(0, mode);
+} /* -- sr_fib_create -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_fib_derive(..)
+ * Scope: Global
+ *
+ * Start a new version of base, which may be 0, sharing all of its
+ * entries.  The result is private until published; base must be the
+ * published table when it is, and must not be modified meanwhile.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_fib* sr_fib_derive(const struct sr_fib* base, uint8_t mode)
+{
+    struct sr_fib* fib = (struct sr_fib*)calloc(1, sizeof(struct sr_fib));
+
+    assert(fib);
+    fib->mode = mode;
+    if(base)
     {
-        sr->routing_table = (struct sr_rt*)malloc(sizeof(struct sr_rt));
-        sr->routing_table->next = 0;
-        sr->routing_table->dest = dest;
-        sr->routing_table->gw   = gw;
-        sr->routing_table->mask = mask;
-        strncpy(sr->routing_table->interface,if_name,SR_IFACE_NAMELEN);
+        fib->lpm     = sr_lpm_derive(base->lpm);
+        fib->base    = base;
+        fib->nstatic = base->nstatic;
+    }
+    else
+    { fib->lpm = sr_lpm_create(sr_rt_free); }
+    return fib;
+} /* -- sr_fib_derive -- */
 
-        return;
+void sr_nexthop_init(struct sr_nexthop* nh, struct in_addr gw,
+        const char* if_name, int if_index)
+{
+    memset(nh, 0, sizeof(struct sr_nexthop));
+    nh->gw = gw;
+    nh->if_index = if_index;
+    strncpy(nh->interface, if_name, SR_IFACE_NAMELEN);
+} /* -- sr_nexthop_init -- */
+
+static int sr_nexthop_cmp(const void* a, const void* b)
+{
+    const struct sr_nexthop* na = (const struct sr_nexthop*)a;
+    const struct sr_nexthop* nb = (const struct sr_nexthop*)b;
+    uint32_t ga = ntohl(na->gw.s_addr), gb = ntohl(nb->gw.s_addr);
+
+    if(na->if_index != nb->if_index)
+    { return na->if_index < nb->if_index ? -1 : 1; }
+    if(ga != gb)
+    { return ga < gb ? -1 : 1; }
+    return strncmp(na->interface, nb->interface, SR_IFACE_NAMELEN);
+}
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_nexthop_normalize(..)
+ * Scope: Local
+ *
+ * Sort a next hop group and drop duplicates and anything past
+ * SR_RT_MAX_NEXTHOPS, so equal groups compare equal whatever order they
+ * were found in.  Returns the new count.
+ *
+ *---------------------------------------------------------------------*/
+
+static unsigned int sr_nexthop_normalize(struct sr_nexthop* nh, unsigned int n)
+{
+    unsigned int i, out = 0;
+
+    qsort(nh, n, sizeof(struct sr_nexthop), sr_nexthop_cmp);
+    for(i = 0; i < n && out < SR_RT_MAX_NEXTHOPS; i++)
+    {
+        if(out > 0 && sr_nexthop_cmp(&nh[out - 1], &nh[i]) == 0)
+        { continue; }
+        nh[out++] = nh[i];
     }
+    return out;
+}
 
-    /* -- find the end of the list -- */
-    rt_walker = sr->routing_table;
-    while(rt_walker->next)
-    {rt_walker = rt_walker->next; }
+/* -- note that dest/mask changed, for a DIR-24-8 table to catch up -- */
+static void sr_fib_edited(struct sr_fib* fib, struct in_addr dest,
+        struct in_addr mask)
+{
+    struct sr_dir248_edit* edit;
 
-    rt_walker->next = (struct sr_rt*)malloc(sizeof(struct sr_rt));
-    rt_walker = rt_walker->next;
+    if(fib->mode != SR_FIB_DIR248 || fib->base == 0 || fib->base->dir == 0)
+    { return; }
+    if(fib->nedits == fib->edits_cap)
+    {
+        fib->edits_cap = fib->edits_cap ? fib->edits_cap * 2 : 16;
+        fib->edits = (struct sr_dir248_edit*)realloc(fib->edits,
+                fib->edits_cap * sizeof(struct sr_dir248_edit));
+        assert(fib->edits);
+    }
+    edit = &fib->edits[fib->nedits++];
+    edit->prefix = ntohl(dest.s_addr & mask.s_addr);
+    edit->len = sr_lpm_mask_len(mask.s_addr);
+}
 
-    rt_walker->next = 0;
-    rt_walker->dest = dest;
-    rt_walker->gw   = gw;
-    rt_walker->mask = mask;
-    strncpy(rt_walker->interface,if_name,SR_IFACE_NAMELEN);
+/* -- 1 if entry already says exactly this -- */
+static int sr_rt_same(const struct sr_rt* entry, struct in_addr dest,
+        const struct sr_nexthop* nh, unsigned int nhops, uint8_t flags)
+{
+    unsigned int i;
 
-} /* -- sr_add_entry -- */
+    if(entry->dest.s_addr != dest.s_addr || entry->flags != flags ||
+       entry->nhops != nhops)
+    { return 0; }
+    for(i = 0; i < nhops; i++)
+    {
+        if(sr_nexthop_cmp(&entry->nh[i], &nh[i]) != 0)
+        { return 0; }
+    }
+    return 1;
+}
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_fib_set(..)
+ * Scope: Global
+ *
+ * Make dest/mask route through the nhops next hops in nh, in a table
+ * that has not been published yet, replacing any entry for the same
+ * prefix.
+ *
+ * RETURN VALUES:
+ *
+ *  1 if the table changed, 0 if it already held this entry, -1 if mask
+ *  is not contiguous or there is no next hop
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_fib_set(struct sr_fib* fib, struct in_addr dest, struct in_addr mask,
+        const struct sr_nexthop* nh, unsigned int nhops, uint8_t flags)
+{
+    struct sr_nexthop group[SR_RT_MAX_NEXTHOPS];
+    struct sr_rt* old;
+    struct sr_rt* entry;
+
+    /* -- REQUIRES -- */
+    assert(fib);
+    assert(nh);
+
+    if(nhops > SR_RT_MAX_NEXTHOPS)
+    { nhops = SR_RT_MAX_NEXTHOPS; }
+    if(nhops == 0)
+    { return -1; }
+    memcpy(group, nh, nhops * sizeof(struct sr_nexthop));
+    nhops = sr_nexthop_normalize(group, nhops);
+
+    old = sr_lpm_find(fib->lpm, dest.s_addr, mask.s_addr);
+    if(old && sr_rt_same(old, dest, group, nhops, flags))
+    { return 0; }
+
+    entry = (struct sr_rt*)malloc(sizeof(struct sr_rt) +
+                                  nhops * sizeof(struct sr_nexthop));
+    assert(entry);
+    entry->dest  = dest;
+    entry->mask  = mask;
+    entry->flags = flags;
+    entry->nhops = nhops;
+    memcpy(entry->nh, group, nhops * sizeof(struct sr_nexthop));
+
+    if(old && (old->flags & SR_RT_STATIC))
+    { fib->nstatic--; }
+    if(sr_lpm_insert(fib->lpm, dest.s_addr, mask.s_addr, entry) != 0)
+    {
+        free(entry);
+        return -1;
+    }
+    if(flags & SR_RT_STATIC)
+    { fib->nstatic++; }
+    sr_fib_edited(fib, dest, mask);
+
+    return 1;
+} /* -- sr_fib_set -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_fib_remove(..)
+ * Scope: Global
+ *
+ * Remove the entry for exactly dest/mask from an unpublished table.
+ * Returns 1 if there was one.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_fib_remove(struct sr_fib* fib, struct in_addr dest, struct in_addr mask)
+{
+    struct sr_rt* old = sr_lpm_find(fib->lpm, dest.s_addr, mask.s_addr);
+
+    if(old == 0)
+    { return 0; }
+    if(old->flags & SR_RT_STATIC)
+    { fib->nstatic--; }
+    sr_fib_edited(fib, dest, mask);
+    return sr_lpm_remove(fib->lpm, dest.s_addr, mask.s_addr);
+} /* -- sr_fib_remove -- */
+
+struct sr_rt* sr_fib_find(const struct sr_fib* fib, struct in_addr dest,
+        struct in_addr mask)
+{
+    return sr_lpm_find(fib->lpm, dest.s_addr, mask.s_addr);
+} /* -- sr_fib_find -- */
+
+unsigned int sr_fib_size(const struct sr_fib* fib)
+{
+    return fib ? fib->lpm->routes : 0;
+} /* -- sr_fib_size -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_fib_iter_init(..)
+ * Scope: Global
+ *
+ * Walk the entries of fib, which may be 0, sorted by prefix.  fib must
+ * not change during the walk.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_fib_iter_init(struct sr_lpm_iter* it, const struct sr_fib* fib)
+{
+    sr_lpm_iter_init(it, fib ? fib->lpm : 0);
+} /* -- sr_fib_iter_init -- */
+
+struct sr_rt* sr_fib_iter_next(struct sr_lpm_iter* it)
+{
+    return sr_lpm_iter_next(it);
+} /* -- sr_fib_iter_next -- */
+
+/* -- throw away an unpublished table, leaving its base untouched -- */
+void sr_fib_discard(struct sr_fib* fib)
+{
+    if(fib == 0)
+    { return; }
+
+    sr_lpm_discard(fib->lpm);
+    sr_dir248_destroy(fib->dir);
+    free(fib->edits);
+    free(fib);
+} /* -- sr_fib_discard -- */
+
+void sr_fib_destroy(struct sr_fib* fib)
+{
+    if(fib == 0)
+    { return; }
+
+    sr_lpm_destroy(fib->lpm);
+    sr_dir248_destroy(fib->dir);
+    free(fib->edits);
+    free(fib);
+} /* -- sr_fib_destroy -- */
+
+static void sr_rt_free(struct sr_rt* rt)
+{
+    free(rt);
+}
+
+static void sr_fib_retire(void* fib)
+{
+    sr_fib_destroy((struct sr_fib*)fib);
+}
+
+void sr_rt_set_clear(struct sr_rt_set* set)
+{
+    set->n = 0;
+} /* -- sr_rt_set_clear -- */
+
+void sr_rt_set_add(struct sr_rt_set* set, struct in_addr dest,
+        struct in_addr mask, uint8_t flags)
+{
+    struct sr_rt_set_entry* entry;
+
+    /* -- REQUIRES -- */
+    assert(set);
+
+    if(set->n == set->cap)
+    {
+        set->cap = set->cap ? set->cap * 2 : 16;
+        set->entries = (struct sr_rt_set_entry*)realloc(set->entries,
+                set->cap * sizeof(struct sr_rt_set_entry));
+        assert(set->entries);
+    }
+
+    entry = &set->entries[set->n];
+    entry->dest  = dest;
+    entry->mask  = mask;
+    entry->flags = flags;
+    entry->nhops = 0;
+    entry->seq = set->n++;
+} /* -- sr_rt_set_add -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_rt_set_add_nexthop(..)
+ * Scope: Global
+ *
+ * Add a next hop to the entry last added to set.  Hops past
+ * SR_RT_MAX_NEXTHOPS are ignored.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_rt_set_add_nexthop(struct sr_rt_set* set, struct in_addr gw,
+        const char* if_name, int if_index)
+{
+    struct sr_rt_set_entry* entry;
+
+    /* -- REQUIRES -- */
+    assert(set);
+    assert(set->n > 0);
+    assert(if_name);
+
+    entry = &set->entries[set->n - 1];
+    if(entry->nhops < SR_RT_MAX_NEXTHOPS)
+    { sr_nexthop_init(&entry->nh[entry->nhops++], gw, if_name, if_index); }
+} /* -- sr_rt_set_add_nexthop -- */
+
+/* -- order prefixes the way the trie walk visits them -- */
+static int sr_rt_cmp(struct in_addr dest_a, struct in_addr mask_a,
+                     struct in_addr dest_b, struct in_addr mask_b)
+{
+    uint32_t pa = ntohl(dest_a.s_addr & mask_a.s_addr);
+    uint32_t pb = ntohl(dest_b.s_addr & mask_b.s_addr);
+    uint32_t ma = ntohl(mask_a.s_addr);
+    uint32_t mb = ntohl(mask_b.s_addr);
+
+    if(pa != pb)
+    { return pa < pb ? -1 : 1; }
+    if(ma != mb)
+    { return ma < mb ? -1 : 1; }
+    return 0;
+}
+
+static int sr_rt_set_cmp(const void* a, const void* b)
+{
+    const struct sr_rt_set_entry* ea = (const struct sr_rt_set_entry*)a;
+    const struct sr_rt_set_entry* eb = (const struct sr_rt_set_entry*)b;
+    int c = sr_rt_cmp(ea->dest, ea->mask, eb->dest, eb->mask);
+
+    if(c != 0)
+    { return c; }
+    return (ea->seq > eb->seq) - (ea->seq < eb->seq);
+}
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_rt_update(..)
+ * Scope: Global
+ *
+ * Make the routing table hold exactly the entries in set.  The set is
+ * sorted and merged against the published table, so only prefixes that
+ * were added, removed or changed are touched, and nothing is published
+ * if none were.  The set is emptied.  Caller holds the write lock.
+ *
+ * RETURN VALUES:
+ *
+ *  number of entries changed, also broken down in diff if not 0
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_rt_update(struct sr_instance* sr, struct sr_rt_set* set,
+        struct sr_rt_diff* diff)
+{
+    struct sr_fib* fib;
+    struct sr_lpm_iter it;
+    struct sr_rt* cur;
+    struct sr_rt_set_entry* want;
+    struct sr_rt_diff d;
+    unsigned int i, n = 0;
+    int c;
+
+    /* -- REQUIRES -- */
+    assert(sr);
+    assert(set);
+
+    memset(&d, 0, sizeof(struct sr_rt_diff));
+
+    /* -- sort, then keep only the last entry given for each prefix -- */
+    qsort(set->entries, set->n, sizeof(struct sr_rt_set_entry), sr_rt_set_cmp);
+    for(i = 0; i < set->n; i++)
+    {
+        if(n > 0 && sr_rt_cmp(set->entries[n - 1].dest, set->entries[n - 1].mask,
+                              set->entries[i].dest, set->entries[i].mask) == 0)
+        { n--; }
+        set->entries[n++] = set->entries[i];
+    }
+
+    fib = sr_fib_derive(sr->fib, sr->fib_mode);
+    sr_fib_iter_init(&it, sr->fib);
+    cur = sr_fib_iter_next(&it);
+    i = 0;
+
+    while(cur || i < n)
+    {
+        want = i < n ? &set->entries[i] : 0;
+        c = !cur ? 1 : !want ? -1 :
+            sr_rt_cmp(cur->dest, cur->mask, want->dest, want->mask);
+
+        if(c < 0)
+        {
+            sr_fib_remove(fib, cur->dest, cur->mask);
+            d.removed++;
+            cur = sr_fib_iter_next(&it);
+            continue;
+        }
+
+        c = sr_fib_set(fib, want->dest, want->mask, want->nh, want->nhops,
+                       want->flags) > 0;
+        if(cur && sr_rt_cmp(cur->dest, cur->mask, want->dest, want->mask) == 0)
+        {
+            d.changed += c;
+            cur = sr_fib_iter_next(&it);
+        }
+        else
+        { d.added += c; }
+        i++;
+    }
+
+    if(d.added + d.removed + d.changed)
+    { sr_rt_publish(sr, fib); }
+    else
+    { sr_fib_discard(fib); }
+
+    sr_rt_set_clear(set);
+    if(diff)
+    { *diff = d; }
+    return d.added + d.removed + d.changed;
+} /* -- sr_rt_update -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_rt_publish(..)
+ * Scope: Global
+ *
+ * Finish building fib and make it the table the forwarding path sees,
+ * with a single pointer store.  The previous table is retired and freed
+ * once no reader can still be using it; if fib was derived from it, only
+ * the entries fib dropped are freed with it.  Caller holds the write
+ * lock and gives up ownership of fib.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_rt_publish(struct sr_instance* sr, struct sr_fib* fib)
+{
+    struct sr_fib* old;
+
+    /* -- REQUIRES -- */
+    assert(sr);
+    assert(fib);
+
+    /* -- a DIR-24-8 table is brought up to date from its base's, if any -- */
+    if(fib->mode == SR_FIB_DIR248 && fib->dir == 0)
+    {
+        if(fib->base && fib->base->dir)
+        {
+            fib->dir = sr_dir248_update(fib->base->dir, fib->base->lpm,
+                                        fib->lpm, fib->edits, fib->nedits);
+        }
+        else
+        { fib->dir = sr_dir248_build(fib->lpm); }
+    }
+    free(fib->edits);
+    fib->edits = 0;
+    fib->nedits = fib->edits_cap = 0;
+
+    old = sr->fib;
+    if(fib->base)
+    {
+        assert(fib->base == old);
+        sr_lpm_hand_over(old->lpm, fib->lpm);
+        fib->base = 0;
+    }
+    sr_rcu_assign_pointer(sr->fib, fib);
+    sr_rcu_retire(sr->rcu, old, sr_fib_retire);
+    sr_rcu_reclaim(sr->rcu);
+
+    /* -- a reader still had an old table, free it once it lets go -- */
+    if(sr->rcu->nretired && sr->reclaim && !sr_timer_armed(sr->reclaim))
+    {
+        sr_timer_arm(sr->timers, sr->reclaim, sr_timer_now_ms(),
+                     RCU_RECLAIM_MS);
+    }
+} /* -- sr_rt_publish -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_rt_bind_interfaces(..)
+ * Scope: Global
+ *
+ * Point every next hop at the index of the interface it names.  Entries
+ * loaded before the hardware info arrived have none yet.  Republishes
+ * the table if any entry changed.
+ *
+ * RETURN VALUES:
+ *
+ *  number of next hops whose interface does not exist
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_rt_bind_interfaces(struct sr_instance* sr)
+{
+    struct sr_fib* fib;
+    struct sr_lpm_iter it;
+    struct sr_rt* rt_walker;
+    struct sr_nexthop nh[SR_RT_MAX_NEXTHOPS];
+    unsigned int i;
+    int changed, nchanged = 0, missing = 0;
+
+    /* -- REQUIRES -- */
+    assert(sr);
+
+    sr_rt_write_lock(sr);
+    fib = sr_fib_derive(sr->fib, sr->fib_mode);
+    sr_fib_iter_init(&it, sr->fib);
+    while((rt_walker = sr_fib_iter_next(&it)) != 0)
+    {
+        changed = 0;
+        for(i = 0; i < rt_walker->nhops; i++)
+        {
+            nh[i] = rt_walker->nh[i];
+            nh[i].if_index = sr_get_interface_index(sr, nh[i].interface);
+            if(nh[i].if_index == SR_IF_NONE)
+            { missing++; }
+            if(nh[i].if_index != rt_walker->nh[i].if_index)
+            { changed = 1; }
+        }
+        if(changed)
+        {
+            sr_fib_set(fib, rt_walker->dest, rt_walker->mask, nh,
+                       rt_walker->nhops, rt_walker->flags);
+            nchanged++;
+        }
+    }
+    if(nchanged)
+    { sr_rt_publish(sr, fib); }
+    else
+    { sr_fib_discard(fib); }
+    sr_rt_write_unlock(sr);
+
+    return missing;
+} /* -- sr_rt_bind_interfaces -- */
+
+void sr_rt_write_lock(struct sr_instance* sr)
+{
+    if ( pthread_mutex_lock(&sr->fib_lock) )
+    { assert(0); }
+} /* -- sr_rt_write_lock -- */
+
+void sr_rt_write_unlock(struct sr_instance* sr)
+{
+    if ( pthread_mutex_unlock(&sr->fib_lock) )
+    { assert(0); }
+} /* -- sr_rt_write_unlock -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_rt_table(..)
+ * Scope: Global
+ *
+ * The published table.  For the control plane, which either holds the
+ * write lock or runs before any writer thread exists.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_fib* sr_rt_table(struct sr_instance* sr)
+{
+    return sr->fib;
+} /* -- sr_rt_table -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_rt_parse_fib_mode(..)
+ * Scope: Global
+ *
+ * Map a lookup structure name given on the command line to SR_FIB_*.
+ * Returns -1 for an unknown name.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_rt_parse_fib_mode(const char* name)
+{
+    if(strcmp(name, "list") == 0)   { return SR_FIB_LIST; }
+    if(strcmp(name, "trie") == 0)   { return SR_FIB_TRIE; }
+    if(strcmp(name, "dir248") == 0) { return SR_FIB_DIR248; }
+    return -1;
+} /* -- sr_rt_parse_fib_mode -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_rt_print_index_stats(..)
+ * Scope: Global
+ *
+ * Print which lookup structure is in use and the memory it takes.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_rt_print_index_stats(struct sr_instance* sr)
+{
+    struct sr_fib* fib = sr->fib;
+    unsigned int entries = sr_fib_size(fib);
+
+    if(fib && fib->mode == SR_FIB_TRIE)
+    {
+        printf("Route lookup: trie, %u entries, %u nodes, %lu bytes\n",
+               entries, fib->lpm->nodes,
+               (unsigned long)(fib->lpm->nodes * sizeof(struct sr_lpm_node)));
+    }
+    else if(fib && fib->dir)
+    {
+        printf("Route lookup: dir248, %u entries, %u overflow blocks, "
+               "%lu bytes\n", entries, fib->dir->nblocks,
+               (unsigned long)sr_dir248_footprint(fib->dir));
+    }
+    else
+    {
+        printf("Route lookup: list, %u entries, %lu bytes\n", entries,
+               (unsigned long)(entries * (sizeof(struct sr_rt) +
+                               sizeof(struct sr_nexthop))));
+    }
+} /* -- sr_rt_print_index_stats -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_fib_lookup(..)
+ * Scope: Global
+ *
+ * Return the entry of fib with the longest prefix matching dst (network
+ * byte order), or 0 if there is no route.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_rt* sr_fib_lookup(const struct sr_fib* fib, uint32_t dst_nbo)
+{
+    if(fib->dir)
+    { return sr_dir248_lookup(fib->dir, dst_nbo); }
+    if(fib->mode == SR_FIB_TRIE)
+    { return sr_lpm_lookup(fib->lpm, dst_nbo); }
+    return sr_fib_lookup_linear(fib, dst_nbo);
+} /* -- sr_fib_lookup -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_rt_lookup(..)
+ * Scope: Global
+ *
+ * Longest prefix match against the published table.  The caller must be
+ * inside an RCU read section and must not use the result after leaving
+ * it.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_rt* sr_rt_lookup(struct sr_instance* sr, uint32_t dst_nbo)
+{
+    struct sr_fib* fib = sr_rcu_dereference(sr->fib);
+
+    return fib ? sr_fib_lookup(fib, dst_nbo) : 0;
+} /* -- sr_rt_lookup -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_fib_lookup_batch(..)
+ * Scope: Global
+ *
+ * sr_fib_lookup for n destinations, out[i] receiving the match for
+ * dst_nbo[i].  The trie and DIR-24-8 overlap the memory accesses of the
+ * lookups; the list scans once per destination.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_fib_lookup_batch(const struct sr_fib* fib, const uint32_t* dst_nbo,
+        unsigned int n, struct sr_rt** out)
+{
+    unsigned int i;
+
+    if(fib->dir)
+    { sr_dir248_lookup_batch(fib->dir, dst_nbo, n, out); }
+    else if(fib->mode == SR_FIB_TRIE)
+    { sr_lpm_lookup_batch(fib->lpm, dst_nbo, n, out); }
+    else
+    {
+        for(i = 0; i < n; i++)
+        { out[i] = sr_fib_lookup_linear(fib, dst_nbo[i]); }
+    }
+} /* -- sr_fib_lookup_batch -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_rt_lookup_batch(..)
+ * Scope: Global
+ *
+ * sr_rt_lookup for n destinations, all resolved against the same
+ * version of the table.  Same read section rules as sr_rt_lookup.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_rt_lookup_batch(struct sr_instance* sr, const uint32_t* dst_nbo,
+        unsigned int n, struct sr_rt** out)
+{
+    struct sr_fib* fib = sr_rcu_dereference(sr->fib);
+
+    if(fib)
+    { sr_fib_lookup_batch(fib, dst_nbo, n, out); }
+    else
+    { memset(out, 0, n * sizeof(struct sr_rt*)); }
+} /* -- sr_rt_lookup_batch -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_fib_lookup_linear(..)
+ * Scope: Global
+ *
+ * Reference longest prefix match that looks at every entry.  Used for
+ * SR_FIB_LIST and as the oracle for sr_rt_check_lookup.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_rt* sr_fib_lookup_linear(const struct sr_fib* fib, uint32_t dst_nbo)
+{
+    struct sr_lpm_iter it;
+    struct sr_rt* rt_walker;
+    struct sr_rt* best = 0;
+    int best_len = -1, len;
+
+    sr_fib_iter_init(&it, fib);
+    while((rt_walker = sr_fib_iter_next(&it)) != 0)
+    {
+        if(((rt_walker->dest.s_addr ^ dst_nbo) & rt_walker->mask.s_addr) == 0)
+        {
+            len = __builtin_popcount(rt_walker->mask.s_addr);
+            if(len >= best_len)
+            {
+                best_len = len;
+                best = rt_walker;
+            }
+        }
+    }
+
+    return best;
+} /* -- sr_fib_lookup_linear -- */
+
+/*--------------------------------------------------------------------- 
+ * Method: sr_rt_check_lookup(..)
+ * Scope: Global
+ *
+ * Compare the published table's lookup against the linear scan.  Every
+ * entry is probed at its first and last address and just outside both
+ * ends, followed by 'probes' random destinations.  Mismatches are
+ * printed.
+ *
+ * RETURN VALUES:
+ *
+ *  number of destinations on which the two lookups disagree
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_rt_check_lookup(struct sr_instance* sr, unsigned int probes)
+{
+    struct sr_fib* fib = sr->fib;
+    struct sr_lpm_iter it;
+    struct sr_rt* rt_walker = 0;
+    struct sr_rt* fast;
+    struct sr_rt* slow;
+    struct in_addr addr;
+    uint32_t dst[4];
+    unsigned int i, checked = 0;
+    int bad = 0;
+
+    /* -- REQUIRES -- */
+    assert(sr);
+
+    if(fib == 0)
+    { return 0; }
+
+    sr_fib_iter_init(&it, fib);
+    for(;;)
+    {
+        if((rt_walker = sr_fib_iter_next(&it)) != 0)
+        {
+            dst[0] = ntohl(rt_walker->dest.s_addr & rt_walker->mask.s_addr);
+            dst[1] = dst[0] | ~ntohl(rt_walker->mask.s_addr);
+            dst[2] = dst[0] - 1;
+            dst[3] = dst[1] + 1;
+        }
+        else if(probes > 0)
+        {
+            dst[0] = ((uint32_t)random() << 16) ^ (uint32_t)random();
+            dst[1] = dst[2] = dst[3] = dst[0];
+            probes--;
+        }
+        else
+        { break; }
+
+        for(i = 0; i < 4; i++)
+        {
+            fast = sr_fib_lookup(fib, htonl(dst[i]));
+            slow = sr_fib_lookup_linear(fib, htonl(dst[i]));
+            checked++;
+            if(fast != slow)
+            {
+                addr.s_addr = htonl(dst[i]);
+                fprintf(stderr,"Route lookup mismatch for %s\n",inet_ntoa(addr));
+                bad++;
+            }
+        }
+    }
+
+    printf("Checked %u route lookups, %d mismatches\n", checked, bad);
+    return bad;
+} /* -- sr_rt_check_lookup -- */
 
 /*--------------------------------------------------------------------- 
  * Method:
@@ -129,22 +1314,18 @@ void sr_add_rt_entry(struct sr_instance* sr, struct in_addr dest,
 
 void sr_print_routing_table(struct sr_instance* sr)
 {
+    struct sr_lpm_iter it;
     struct sr_rt* rt_walker = 0;
 
-    if(sr->routing_table == 0)
+    if(sr_fib_size(sr_rt_table(sr)) == 0)
     {
         printf(" Routing table empty \n");
         return;
     }
 
-    rt_walker = sr->routing_table;
-    
-    sr_print_routing_entry(rt_walker);
-    while(rt_walker->next)
-    {
-        rt_walker = rt_walker->next; 
-        sr_print_routing_entry(rt_walker);
-    }
+    sr_fib_iter_init(&it, sr_rt_table(sr));
+    while((rt_walker = sr_fib_iter_next(&it)) != 0)
+    { sr_print_routing_entry(rt_walker); }
 
 } /* -- sr_print_routing_table -- */
 
@@ -155,13 +1336,17 @@ void sr_print_routing_table(struct sr_instance* sr)
 
 void sr_print_routing_entry(struct sr_rt* entry)
 {
+    unsigned int i;
+
     /* -- REQUIRES --*/
     assert(entry);
-    assert(entry->interface);
 
     printf("Destination: %s\n",inet_ntoa(entry->dest));
-    printf("  Gateway : %s\n",inet_ntoa(entry->gw));
     printf("  Mask : %s\n",inet_ntoa(entry->mask));
-    printf("  Interface : %s\n",entry->interface);
+    for(i = 0; i < entry->nhops; i++)
+    {
+        printf("  Gateway : %s\n",inet_ntoa(entry->nh[i].gw));
+        printf("  Interface : %s\n",entry->nh[i].interface);
+    }
 
 } /* -- sr_print_routing_entry -- */
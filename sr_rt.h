@@ -20,28 +20,191 @@
 
 #include "sr_if.h"
 
+#include "sr_lpm.h"
+
+/* -- lookup structure selected at startup, see sr_rt_lookup -- */
+#define SR_FIB_LIST   0 /* scan every entry */
+#define SR_FIB_TRIE   1 /* Patricia trie, sr_lpm.c */
+#define SR_FIB_DIR248 2 /* DIR-24-8 table, sr_dir248.c */
+
+/* -- sr_rt flags -- */
+#define SR_RT_STATIC  0x01 /* loaded from the routing table file */
+
+#define SR_RT_MAX_NEXTHOPS 8 /* widest equal-cost group kept for a prefix */
+
+/* ----------------------------------------------------------------------------
+ * struct sr_nexthop
+ *
+ * One way out for a prefix: the gateway (0 for directly attached) and the
+ * interface to reach it through.
+ *
+ * -------------------------------------------------------------------------- */
+
+struct sr_nexthop
+{
+    struct in_addr gw;
+    int    if_index; /* sr_if.index of interface, or SR_IF_NONE */
+    char   interface[SR_IFACE_NAMELEN];
+    uint32_t adj;    /* hint, ARP cache slot + 1 of gw, see sr_rt_adj */
+};
+
 /* ----------------------------------------------------------------------------
  * struct sr_rt
  *
- * Node in the routing table 
+ * Node in the routing table.  Packets to the prefix are spread over the
+ * next hops by sr_rt_select.
  *
  * -------------------------------------------------------------------------- */
 
 struct sr_rt
 {
     struct in_addr dest;
-    struct in_addr gw;
     struct in_addr mask;
-    char   interface[SR_IFACE_NAMELEN];
-    struct sr_rt* next;
+    uint8_t flags;
+    uint8_t nhops;          /* more than 1 for an equal-cost group */
+    uint32_t dir;           /* its slot value in DIR-24-8 tables */
+    struct sr_nexthop nh[]; /* sorted by interface index, then gateway */
 };
 
 
+/* ----------------------------------------------------------------------------
+ * struct sr_fib
+ *
+ * One version of the routing table.  The entries live in a persistent
+ * trie, so a new version is derived from the published one, edited in
+ * place and published with sr_rt_publish; unchanged entries are shared
+ * between the two.  A published table is never modified, but for the
+ * ARP hints of its next hops, see sr_rt_adj.
+ *
+ * -------------------------------------------------------------------------- */
+
+struct sr_dir248;
+struct sr_dir248_edit;
+
+struct sr_fib
+{
+    uint8_t mode;               /* SR_FIB_* */
+    struct sr_lpm* lpm;         /* holds the entries in every mode */
+    struct sr_dir248* dir;
+    const struct sr_fib* base;  /* version this one was derived from */
+    unsigned int nstatic;       /* entries with SR_RT_STATIC */
+
+    /* -- prefixes changed since derived, for sr_dir248_update -- */
+    struct sr_dir248_edit* edits;
+    unsigned int nedits;
+    unsigned int edits_cap;
+};
+
+/* ----------------------------------------------------------------------------
+ * struct sr_rt_set
+ *
+ * Scratch list of routes computed by the routing protocol, to be applied
+ * with sr_rt_update.  Reused between updates so it stops allocating once
+ * it has grown to the size of the table.
+ *
+ * -------------------------------------------------------------------------- */
+
+struct sr_rt_set_entry
+{
+    struct in_addr dest;
+    struct in_addr mask;
+    uint8_t flags;
+    uint8_t nhops;
+    struct sr_nexthop nh[SR_RT_MAX_NEXTHOPS];
+    unsigned int seq; /* order added, the last of equal prefixes wins */
+};
+
+struct sr_rt_set
+{
+    struct sr_rt_set_entry* entries;
+    unsigned int n;
+    unsigned int cap;
+};
+
+/* -- what one sr_rt_update did to the table -- */
+struct sr_rt_diff
+{
+    unsigned int added;
+    unsigned int removed;
+    unsigned int changed;
+};
+
 int sr_load_rt(struct sr_instance*,const char*);
+int sr_rt_save_snapshot(struct sr_instance* sr, const char* filename);
 void sr_add_rt_entry(struct sr_instance*, struct in_addr,struct in_addr,
                   struct in_addr,char*);
 void sr_print_routing_table(struct sr_instance* sr);
+
+struct sr_fib* sr_fib_create(uint8_t mode);
+struct sr_fib* sr_fib_derive(const struct sr_fib* base, uint8_t mode);
+int sr_fib_set(struct sr_fib* fib, struct in_addr dest, struct in_addr mask,
+        const struct sr_nexthop* nh, unsigned int nhops, uint8_t flags);
+int sr_fib_remove(struct sr_fib* fib, struct in_addr dest, struct in_addr mask);
+struct sr_rt* sr_fib_find(const struct sr_fib* fib, struct in_addr dest,
+        struct in_addr mask);
+unsigned int sr_fib_size(const struct sr_fib* fib);
+void sr_fib_iter_init(struct sr_lpm_iter* it, const struct sr_fib* fib);
+struct sr_rt* sr_fib_iter_next(struct sr_lpm_iter* it);
+void sr_fib_discard(struct sr_fib* fib);
+void sr_fib_destroy(struct sr_fib* fib);
+struct sr_rt* sr_fib_lookup(const struct sr_fib* fib, uint32_t dst_nbo);
+struct sr_rt* sr_fib_lookup_linear(const struct sr_fib* fib, uint32_t dst_nbo);
+void sr_fib_lookup_batch(const struct sr_fib* fib, const uint32_t* dst_nbo,
+        unsigned int n, struct sr_rt** out);
+
+void sr_rt_set_clear(struct sr_rt_set* set);
+void sr_rt_set_add(struct sr_rt_set* set, struct in_addr dest,
+        struct in_addr mask, uint8_t flags);
+void sr_rt_set_add_nexthop(struct sr_rt_set* set, struct in_addr gw,
+        const char* if_name, int if_index);
+int sr_rt_update(struct sr_instance* sr, struct sr_rt_set* set,
+        struct sr_rt_diff* diff);
+
+void sr_rt_write_lock(struct sr_instance* sr);
+void sr_rt_write_unlock(struct sr_instance* sr);
+void sr_rt_publish(struct sr_instance* sr, struct sr_fib* fib);
+int sr_rt_bind_interfaces(struct sr_instance* sr);
+struct sr_fib* sr_rt_table(struct sr_instance* sr);
+struct sr_rt* sr_rt_lookup(struct sr_instance* sr, uint32_t dst_nbo);
+void sr_rt_lookup_batch(struct sr_instance* sr, const uint32_t* dst_nbo,
+        unsigned int n, struct sr_rt** out);
+int sr_rt_check_lookup(struct sr_instance* sr, unsigned int probes);
+int sr_rt_parse_fib_mode(const char* name);
+void sr_rt_print_index_stats(struct sr_instance* sr);
 void sr_print_routing_entry(struct sr_rt* entry);
+void sr_nexthop_init(struct sr_nexthop* nh, struct in_addr gw,
+        const char* if_name, int if_index);
+
+/*---------------------------------------------------------------------
+ * Method: sr_rt_select(..)
+ *
+ * Pick the next hop for a flow from the entry's group.  hash should be
+ * a function of the flow only, so its packets all leave the same way.
+ *
+ *---------------------------------------------------------------------*/
+
+static inline
+const struct sr_nexthop* sr_rt_select(const struct sr_rt* rt, uint32_t hash)
+{
+    if(rt->nhops == 1)
+    { return &rt->nh[0]; }
+    return &rt->nh[((uint64_t)hash * rt->nhops) >> 32];
+} /* -- sr_rt_select -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rt_adj(..)
+ *
+ * The ARP hint of rt's next hop nh, for sr_arpcache_lookup_hint or
+ * sr_arpcache_read to update.  It is the one field of a published route that changes, by
+ * any reader at any time, so it is only ever read and written with
+ * relaxed atomics.  A stale hint just costs the hashed lookup.
+ *
+ *---------------------------------------------------------------------*/
+
+static inline uint32_t* sr_rt_adj(struct sr_rt* rt, const struct sr_nexthop* nh)
+{
+    return &rt->nh[nh - rt->nh].adj;
+} /* -- sr_rt_adj -- */
 
 
 #endif  /* --  sr_RT_H -- */
@@ -0,0 +1,150 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_rxring.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Receive ring for the VNS command stream, see sr_rxring.h.  A command
+ * starts with its length, 4 bytes in network byte order, counting
+ * those 4 bytes.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "sr_rxring.h"
+
+/* -- the length of the command at ring->head, 4 bytes of it must be in -- */
+static uint32_t rxring_peek_len(const struct sr_rxring* ring)
+{
+    uint32_t len;
+
+    memcpy(&len, ring->buf + ring->head, 4);
+    return ntohl(len);
+} /* -- rxring_peek_len -- */
+
+struct sr_rxring* sr_rxring_create(unsigned int size, unsigned int max_len)
+{
+    struct sr_rxring* ring;
+
+    assert(max_len <= size);
+    ring = (struct sr_rxring*)calloc(1, sizeof(struct sr_rxring));
+    assert(ring);
+    ring->buf = (uint8_t*)malloc(size);
+    assert(ring->buf);
+    ring->size = size;
+    ring->max_len = max_len;
+    return ring;
+} /* -- sr_rxring_create -- */
+
+void sr_rxring_destroy(struct sr_rxring* ring)
+{
+    if(ring == 0)
+    { return; }
+    free(ring->buf);
+    free(ring);
+} /* -- sr_rxring_destroy -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rxring_fill(..)
+ * Scope: Global
+ *
+ * Read once into the free space, making room first: an empty ring
+ * starts over at the front, and a partial command is moved there if
+ * the longest command might not fit behind it.  Retries reads cut
+ * short by a signal.  Returns what read returned, 0 at end of stream.
+ *
+ *---------------------------------------------------------------------*/
+
+ssize_t sr_rxring_fill(struct sr_rxring* ring,
+        ssize_t (*read)(void* ctx, void* buf, size_t count), void* ctx)
+{
+    ssize_t ret;
+
+    ring->cur = 0;
+    ring->cur_len = 0;
+    if(ring->head == ring->tail)
+    { ring->head = ring->tail = 0; }
+    else
+    {
+        ring->carried++;
+        if(ring->size - ring->head < ring->max_len)
+        {
+            memmove(ring->buf, ring->buf + ring->head, ring->tail - ring->head);
+            ring->tail -= ring->head;
+            ring->head = 0;
+        }
+    }
+
+    do
+    { ret = read(ctx, ring->buf + ring->tail, ring->size - ring->tail); }
+    while(ret < 0 && errno == EINTR);
+
+    if(ret > 0)
+    {
+        ring->tail += ret;
+        ring->reads++;
+        ring->bytes += ret;
+    }
+    return ret;
+} /* -- sr_rxring_fill -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_rxring_next(..)
+ * Scope: Global
+ *
+ * Take the next command, setting cmd to its first byte and len to its
+ * length.  Returns 1, 0 if no whole command has been read yet, or -1 if
+ * the next one claims a length under 4 or over max_len; len is set to
+ * that length and the stream cannot be trusted past it.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_rxring_next(struct sr_rxring* ring, uint8_t** cmd, unsigned int* len)
+{
+    uint32_t n;
+
+    if(ring->tail - ring->head < 4)
+    { return 0; }
+    n = rxring_peek_len(ring);
+    if(n < 4 || n > ring->max_len)
+    {
+        *len = n;
+        return -1;
+    }
+    if(ring->tail - ring->head < n)
+    { return 0; }
+
+    *cmd = ring->cur = ring->buf + ring->head;
+    *len = ring->cur_len = n;
+    ring->head += n;
+    ring->commands++;
+    return 1;
+} /* -- sr_rxring_next -- */
+
+/* -- 1 if a whole command is waiting to be taken -- */
+int sr_rxring_pending(const struct sr_rxring* ring)
+{
+    uint32_t n;
+
+    if(ring == 0 || ring->tail - ring->head < 4)
+    { return 0; }
+    n = rxring_peek_len(ring);
+    return n < 4 || n > ring->max_len || ring->tail - ring->head >= n;
+} /* -- sr_rxring_pending -- */
+
+void sr_rxring_print(struct sr_rxring* ring)
+{
+    printf("Receive ring: %lu commands in %lu bytes from %lu reads "
+           "(%.2f per read), %lu reads completed a partial one\n",
+           ring->commands, ring->bytes, ring->reads,
+           ring->reads ? (double)ring->commands / ring->reads : 0.0,
+           ring->carried);
+} /* -- sr_rxring_print -- */
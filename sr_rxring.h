@@ -0,0 +1,67 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_rxring.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Receive ring for the VNS command stream.  sr_rxring_fill reads as much
+ * as the stream has, up to the free space, in one call; sr_rxring_next
+ * then takes the complete commands out of what was read one at a time,
+ * in place.  A command split across reads stays in the ring and is
+ * completed by the next fill, which first moves it to the front if
+ * there might not be room behind it for the rest.
+ *
+ * A taken command stays put until the next fill, which may move or
+ * overwrite it: whatever still refers to one must be done with it by
+ * then.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_RXRING_H
+#define SR_RXRING_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include <sys/types.h>
+
+#define SR_RXRING_SIZE (128 * 1024)
+
+struct sr_rxring
+{
+    uint8_t* buf;
+    unsigned int size;
+    unsigned int max_len;        /* longest command allowed */
+    unsigned int head;           /* first byte not yet taken */
+    unsigned int tail;           /* end of what has been read */
+    uint8_t* cur;                /* command taken last, until the next fill */
+    unsigned int cur_len;
+
+    unsigned long reads;
+    unsigned long bytes;
+    unsigned long commands;
+    unsigned long carried;       /* fills that began with part of a command */
+};
+
+struct sr_rxring* sr_rxring_create(unsigned int size, unsigned int max_len);
+void sr_rxring_destroy(struct sr_rxring* ring);
+
+ssize_t sr_rxring_fill(struct sr_rxring* ring,
+        ssize_t (*read)(void* ctx, void* buf, size_t count), void* ctx);
+int sr_rxring_next(struct sr_rxring* ring, uint8_t** cmd, unsigned int* len);
+int sr_rxring_pending(const struct sr_rxring* ring);
+void sr_rxring_print(struct sr_rxring* ring);
+
+/* -- 1 if [p, p + len) starts the command taken last and lies in it -- */
+static inline int sr_rxring_is_current(const struct sr_rxring* ring,
+                                       const uint8_t* p, unsigned int len)
+{
+    return ring->cur && p == ring->cur && len <= ring->cur_len;
+} /* -- sr_rxring_is_current -- */
+
+#endif /* -- SR_RXRING_H -- */
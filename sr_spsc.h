@@ -0,0 +1,102 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_spsc.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Single producer, single consumer ring of pointers.  One thread pushes
+ * and one other thread pops, and neither takes a lock: each side owns
+ * one index and reads the other's with acquire, after writing its own
+ * with release.  Each side also keeps a copy of the other's index and
+ * reads the real one only when the ring looks full or empty, so in a
+ * steady stream the two sides seldom touch the same cache line.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_SPSC_H
+#define SR_SPSC_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include <stdlib.h>
+
+struct sr_spsc
+{
+    void** slots;
+    uint32_t mask;                    /* slots - 1, a power of two */
+
+    /* -- the consumer's -- */
+    uint32_t head __attribute__((aligned(64))); /* next to pop */
+    uint32_t tail_seen;
+
+    /* -- the producer's -- */
+    uint32_t tail __attribute__((aligned(64))); /* next to push */
+    uint32_t head_seen;
+} __attribute__((aligned(64)));
+
+/* -- room for size pointers, rounded up to a power of two; 0 or -1 -- */
+static inline int sr_spsc_init(struct sr_spsc* ring, unsigned int size)
+{
+    unsigned int n = 1;
+
+    while(n < size)
+    { n <<= 1; }
+    ring->slots = (void**)calloc(n, sizeof(void*));
+    ring->mask = n - 1;
+    ring->head = ring->tail_seen = 0;
+    ring->tail = ring->head_seen = 0;
+    return ring->slots ? 0 : -1;
+} /* -- sr_spsc_init -- */
+
+static inline void sr_spsc_free(struct sr_spsc* ring)
+{
+    free(ring->slots);
+    ring->slots = 0;
+} /* -- sr_spsc_free -- */
+
+/* -- producer: 0, or -1 if the ring is full -- */
+static inline int sr_spsc_push(struct sr_spsc* ring, void* p)
+{
+    uint32_t tail = ring->tail;
+
+    if(tail - ring->head_seen > ring->mask)
+    {
+        ring->head_seen = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if(tail - ring->head_seen > ring->mask)
+        { return -1; }
+    }
+    ring->slots[tail & ring->mask] = p;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return 0;
+} /* -- sr_spsc_push -- */
+
+/* -- consumer: the oldest pointer, or 0 if the ring is empty -- */
+static inline void* sr_spsc_pop(struct sr_spsc* ring)
+{
+    uint32_t head = ring->head;
+    void* p;
+
+    if(head == ring->tail_seen)
+    {
+        ring->tail_seen = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if(head == ring->tail_seen)
+        { return 0; }
+    }
+    p = ring->slots[head & ring->mask];
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return p;
+} /* -- sr_spsc_pop -- */
+
+/* -- consumer: 1 if there is nothing to pop, reading the producer's index -- */
+static inline int sr_spsc_empty(struct sr_spsc* ring)
+{
+    return __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == ring->head;
+} /* -- sr_spsc_empty -- */
+
+#endif /* -- SR_SPSC_H -- */
@@ -0,0 +1,191 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_timer.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Hashed timer wheel, see sr_timer.h.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "sr_timer.h"
+
+uint64_t sr_timer_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+} /* -- sr_timer_now_ms -- */
+
+static void timer_link(struct sr_timer** head, struct sr_timer* timer)
+{
+    timer->next = *head;
+    if(*head)
+    { (*head)->pprev = &timer->next; }
+    *head = timer;
+    timer->pprev = head;
+} /* -- timer_link -- */
+
+static void timer_unlink(struct sr_timer* timer)
+{
+    *timer->pprev = timer->next;
+    if(timer->next)
+    { timer->next->pprev = timer->pprev; }
+    timer->next = 0;
+    timer->pprev = 0;
+} /* -- timer_unlink -- */
+
+void sr_timer_wheel_init(struct sr_timer_wheel* wheel, uint64_t now_ms)
+{
+    memset(wheel, 0, sizeof(struct sr_timer_wheel));
+    wheel->tick = now_ms / SR_TIMER_TICK_MS;
+} /* -- sr_timer_wheel_init -- */
+
+void sr_timer_init(struct sr_timer* timer, sr_timer_fn fn, void* arg)
+{
+    memset(timer, 0, sizeof(struct sr_timer));
+    timer->fn = fn;
+    timer->arg = arg;
+} /* -- sr_timer_init -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_timer_arm(..)
+ * Scope: Global
+ *
+ * Fire timer delay_ms after now_ms, rounded up to a whole tick and at
+ * least one tick away.  An armed timer is moved to the new time.
+ *
+ *---------------------------------------------------------------------*/
+
+void sr_timer_arm(struct sr_timer_wheel* wheel, struct sr_timer* timer,
+                  uint64_t now_ms, unsigned int delay_ms)
+{
+    uint64_t expires = (now_ms + delay_ms + SR_TIMER_TICK_MS - 1) /
+                       SR_TIMER_TICK_MS;
+
+    if(sr_timer_armed(timer))
+    { sr_timer_cancel(wheel, timer); }
+    if(expires <= wheel->tick)
+    { expires = wheel->tick + 1; }
+
+    timer->expires = expires;
+    timer_link(&wheel->slot[expires & (SR_TIMER_SLOTS - 1)], timer);
+    wheel->pending++;
+} /* -- sr_timer_arm -- */
+
+void sr_timer_cancel(struct sr_timer_wheel* wheel, struct sr_timer* timer)
+{
+    if(!sr_timer_armed(timer))
+    { return; }
+    timer_unlink(timer);
+    wheel->pending--;
+} /* -- sr_timer_cancel -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_timer_wheel_run(..)
+ * Scope: Global
+ *
+ * Fire every timer due by now_ms.  A callback may arm or cancel any
+ * timer, its own included.  Returns the number of timers fired.
+ *
+ *---------------------------------------------------------------------*/
+
+unsigned int sr_timer_wheel_run(struct sr_timer_wheel* wheel, uint64_t now_ms)
+{
+    struct sr_timer* due;
+    struct sr_timer* timer;
+    struct sr_timer** slot;
+    uint64_t target = now_ms / SR_TIMER_TICK_MS;
+    unsigned int fired = 0;
+
+    while(wheel->tick < target)
+    {
+        wheel->tick++;
+        if(wheel->pending == 0)
+        {
+            wheel->tick = target;
+            break;
+        }
+
+        /* -- detach the slot so callbacks can rearm into it safely -- */
+        slot = &wheel->slot[wheel->tick & (SR_TIMER_SLOTS - 1)];
+        due = *slot;
+        *slot = 0;
+        if(due)
+        { due->pprev = &due; }
+
+        while((timer = due) != 0)
+        {
+            timer_unlink(timer);
+            if(timer->expires > wheel->tick)
+            {
+                timer_link(slot, timer);   /* a later turn of the wheel */
+                continue;
+            }
+            wheel->pending--;
+            fired++;
+            timer->fn(timer, timer->arg);
+        }
+    }
+
+    return fired;
+} /* -- sr_timer_wheel_run -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_timer_wheel_next(..)
+ * Scope: Global
+ *
+ * Time in ms at which the earliest armed timer fires, or 0 if none is.
+ * Walks the slots in tick order from the next one, so a timer due in
+ * the current turn is found after looking at the slots before it only.
+ *
+ *---------------------------------------------------------------------*/
+
+uint64_t sr_timer_wheel_next(const struct sr_timer_wheel* wheel)
+{
+    const struct sr_timer* timer;
+    uint64_t tick, best = 0;
+    unsigned int i;
+
+    if(wheel->pending == 0)
+    { return 0; }
+    for(i = 1; i <= SR_TIMER_SLOTS; i++)
+    {
+        tick = wheel->tick + i;
+        for(timer = wheel->slot[tick & (SR_TIMER_SLOTS - 1)]; timer;
+            timer = timer->next)
+        {
+            if(timer->expires == tick)
+            { return tick * SR_TIMER_TICK_MS; }
+            if(best == 0 || timer->expires < best)
+            { best = timer->expires; }   /* a later turn */
+        }
+    }
+    return best * SR_TIMER_TICK_MS;
+} /* -- sr_timer_wheel_next -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_timer_wheel_timeout(..)
+ * Scope: Global
+ *
+ * Milliseconds the owner may wait before calling sr_timer_wheel_run
+ * again, in the form poll takes: -1 if no timer is armed, otherwise the
+ * time until the earliest one fires.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_timer_wheel_timeout(const struct sr_timer_wheel* wheel, uint64_t now_ms)
+{
+    uint64_t next = sr_timer_wheel_next(wheel);
+
+    if(next == 0)
+    { return -1; }
+    return next > now_ms ? (int)(next - now_ms) : 0;
+} /* -- sr_timer_wheel_timeout -- */
@@ -0,0 +1,78 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_timer.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Hashed timer wheel.  Timers are embedded in the objects they belong to
+ * and hang off one of SR_TIMER_SLOTS lists chosen by their expiry tick,
+ * so arming and cancelling are O(1) and advancing the wheel only looks
+ * at the slots of the ticks that passed.  A timer further out than one
+ * turn of the wheel stays in its slot until the right turn comes round.
+ *
+ * The wheel does not run by itself; its owner calls sr_timer_wheel_run
+ * with the current time, and can ask sr_timer_wheel_next when the next
+ * timer fires, or sr_timer_wheel_timeout how long it may wait until then.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_TIMER_H
+#define SR_TIMER_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#define SR_TIMER_SLOTS   512        /* a power of two */
+#define SR_TIMER_TICK_MS 100
+
+struct sr_timer;
+typedef void (*sr_timer_fn)(struct sr_timer* timer, void* arg);
+
+struct sr_timer
+{
+    struct sr_timer* next;
+    struct sr_timer** pprev;  /* 0 when not armed */
+    uint64_t expires;         /* tick */
+    sr_timer_fn fn;
+    void* arg;
+};
+
+struct sr_timer_wheel
+{
+    struct sr_timer* slot[SR_TIMER_SLOTS];
+    uint64_t tick;            /* last tick run */
+    unsigned int pending;
+};
+
+uint64_t sr_timer_now_ms(void);
+
+void sr_timer_wheel_init(struct sr_timer_wheel* wheel, uint64_t now_ms);
+unsigned int sr_timer_wheel_run(struct sr_timer_wheel* wheel,
+                                uint64_t now_ms);
+uint64_t sr_timer_wheel_next(const struct sr_timer_wheel* wheel);
+int  sr_timer_wheel_timeout(const struct sr_timer_wheel* wheel,
+                            uint64_t now_ms);
+
+void sr_timer_init(struct sr_timer* timer, sr_timer_fn fn, void* arg);
+void sr_timer_arm(struct sr_timer_wheel* wheel, struct sr_timer* timer,
+                  uint64_t now_ms, unsigned int delay_ms);
+void sr_timer_cancel(struct sr_timer_wheel* wheel, struct sr_timer* timer);
+
+/* -- time of the last tick run, cheaper than reading the clock -- */
+static inline uint64_t sr_timer_wheel_now(const struct sr_timer_wheel* wheel)
+{
+    return wheel->tick * SR_TIMER_TICK_MS;
+} /* -- sr_timer_wheel_now -- */
+
+/* -- timer is waiting to fire -- */
+static inline int sr_timer_armed(const struct sr_timer* timer)
+{
+    return timer->pprev != 0;
+} /* -- sr_timer_armed -- */
+
+#endif /* -- SR_TIMER_H -- */
@@ -0,0 +1,207 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_txq.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Transmit queue, see sr_txq.h.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+
+#include "sr_txq.h"
+
+/*---------------------------------------------------------------------
+ * Method: txq_write_all(..)
+ * Scope: Local
+ *
+ * Write all of iov, picking up after short writes and signals.  iov is
+ * used up in the process.  Returns 0, or -1 if a write failed.
+ *
+ *---------------------------------------------------------------------*/
+
+static int txq_write_all(struct sr_txq* txq, struct iovec* iov, int iovcnt)
+{
+    ssize_t ret;
+
+    while(iovcnt > 0)
+    {
+        ret = txq->writev(txq->ctx, iov, iovcnt);
+        if(ret < 0)
+        {
+            if(errno == EINTR)
+            { continue; }
+            return -1;
+        }
+        txq->writes++;
+        while(iovcnt > 0 && (size_t)ret >= iov->iov_len)
+        {
+            ret -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if(iovcnt > 0)
+        {
+            iov->iov_base = (uint8_t*)iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+    return 0;
+} /* -- txq_write_all -- */
+
+/* -- write out the queue, lock held -- */
+static int txq_flush_locked(struct sr_txq* txq)
+{
+    unsigned int i;
+    int ret;
+
+    if(txq->n == 0)
+    { return 0; }
+    ret = txq_write_all(txq, txq->iov, txq->n);
+    if(ret == 0)
+    { txq->messages += txq->n; }
+    else
+    { txq->errors += txq->n; }
+
+    for(i = 0; i < txq->n; i++)
+    {
+        if(txq->frames[i])
+        { sr_pbuf_put(txq->frames[i]); }
+    }
+    txq->n = 0;
+    txq->nbytes = 0;
+    return ret;
+} /* -- txq_flush_locked -- */
+
+struct sr_txq* sr_txq_create(ssize_t (*writev)(void* ctx,
+        const struct iovec* iov, int iovcnt), void* ctx)
+{
+    struct sr_txq* txq;
+
+    assert(writev);
+    txq = (struct sr_txq*)calloc(1, sizeof(struct sr_txq));
+    assert(txq);
+    pthread_mutex_init(&txq->lock, 0);
+    txq->writev = writev;
+    txq->ctx = ctx;
+    return txq;
+} /* -- sr_txq_create -- */
+
+/* -- queued messages are dropped, not written -- */
+void sr_txq_destroy(struct sr_txq* txq)
+{
+    unsigned int i;
+
+    if(txq == 0)
+    { return; }
+    for(i = 0; i < txq->n; i++)
+    {
+        if(txq->frames[i])
+        { sr_pbuf_put(txq->frames[i]); }
+    }
+    pthread_mutex_destroy(&txq->lock);
+    free(txq);
+} /* -- sr_txq_destroy -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_txq_add(..)
+ * Scope: Global
+ *
+ * Queue the len byte message at msg, in pb, taking a reference to pb,
+ * or outside any buffer if pb is 0; msg must not change until it is
+ * written.  Writes the queue first if the message would not fit, and
+ * after if it is then full.  Returns 0, or -1 if one of those writes
+ * failed.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_txq_add(struct sr_txq* txq, struct sr_pbuf* pb, void* msg,
+        unsigned int len, uint64_t now)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&txq->lock);
+    if(txq->n && txq->nbytes + len > SR_TXQ_BYTES)
+    { ret = txq_flush_locked(txq); }
+
+    if(pb)
+    { sr_pbuf_hold(pb); }
+    if(txq->n == 0)
+    { txq->first_ms = now; }
+    txq->frames[txq->n] = pb;
+    txq->iov[txq->n].iov_base = msg;
+    txq->iov[txq->n].iov_len = len;
+    txq->n++;
+    txq->nbytes += len;
+
+    if(txq->n == SR_TXQ_FRAMES || txq->nbytes >= SR_TXQ_BYTES)
+    { ret |= txq_flush_locked(txq); }
+    pthread_mutex_unlock(&txq->lock);
+    return ret;
+} /* -- sr_txq_add -- */
+
+/* -- 1 if the message at msg is waiting to be written -- */
+int sr_txq_holds(struct sr_txq* txq, const void* msg)
+{
+    unsigned int i;
+    int found = 0;
+
+    pthread_mutex_lock(&txq->lock);
+    for(i = 0; i < txq->n && !found; i++)
+    { found = txq->iov[i].iov_base == msg; }
+    pthread_mutex_unlock(&txq->lock);
+    return found;
+} /* -- sr_txq_holds -- */
+
+int sr_txq_flush(struct sr_txq* txq)
+{
+    int ret;
+
+    pthread_mutex_lock(&txq->lock);
+    ret = txq_flush_locked(txq);
+    pthread_mutex_unlock(&txq->lock);
+    return ret;
+} /* -- sr_txq_flush -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_txq_write(..)
+ * Scope: Global
+ *
+ * Write a message that cannot be queued, after those that are, so the
+ * server sees them in order.  Returns 0, or -1 if a write failed.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_txq_write(struct sr_txq* txq, const struct iovec* iov, int iovcnt)
+{
+    struct iovec left[2];
+    int ret;
+
+    assert(iovcnt <= 2);
+    memcpy(left, iov, iovcnt * sizeof(struct iovec));
+
+    pthread_mutex_lock(&txq->lock);
+    ret = txq_flush_locked(txq);
+    if(txq_write_all(txq, left, iovcnt) == 0)
+    { txq->messages++; }
+    else
+    {
+        txq->errors++;
+        ret = -1;
+    }
+    pthread_mutex_unlock(&txq->lock);
+    return ret;
+} /* -- sr_txq_write -- */
+
+void sr_txq_print(struct sr_txq* txq)
+{
+    printf("Transmit queue: %u messages waiting, %lu written in %lu writes "
+           "(%.2f per write), %lu lost to errors\n", txq->n, txq->messages,
+           txq->writes, txq->writes ? (double)txq->messages / txq->writes : 0.0,
+           txq->errors);
+} /* -- sr_txq_print -- */
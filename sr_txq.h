@@ -0,0 +1,77 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_txq.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Transmit queue.  Outgoing VNS messages collect here and go to the
+ * server in a single writev, so a burst of frames costs one system call
+ * instead of one each.  A message is the VNS header followed directly by
+ * the frame, in one packet buffer the queue holds a reference to, or in
+ * memory its owner keeps as it is until the next flush.
+ *
+ * The queue is flushed when it reaches SR_TXQ_FRAMES messages or
+ * SR_TXQ_BYTES bytes, and by its owner: the packet thread when it has
+ * read everything pending or the oldest message has waited
+ * SR_TXQ_DELAY_MS, other threads after each burst they send.  It is
+ * locked, so any thread may add to or flush it.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_TXQ_H
+#define SR_TXQ_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "sr_pbuf.h"
+
+#define SR_TXQ_FRAMES   64            /* messages per writev */
+#define SR_TXQ_BYTES    (64 * 1024)
+#define SR_TXQ_DELAY_MS 1             /* longest a message waits */
+
+struct sr_txq
+{
+    pthread_mutex_t lock;
+    struct sr_pbuf* frames[SR_TXQ_FRAMES]; /* or 0, not a packet buffer */
+    struct iovec iov[SR_TXQ_FRAMES];  /* the message of each */
+    unsigned int n;
+    unsigned int nbytes;
+    uint64_t first_ms;                /* when the oldest was added */
+
+    /* -- writes to the server, ctx is passed back -- */
+    ssize_t (*writev)(void* ctx, const struct iovec* iov, int iovcnt);
+    void* ctx;
+
+    unsigned long messages;           /* written */
+    unsigned long writes;             /* writev calls that wrote them */
+    unsigned long errors;             /* messages lost to a failed write */
+};
+
+struct sr_txq* sr_txq_create(ssize_t (*writev)(void* ctx,
+        const struct iovec* iov, int iovcnt), void* ctx);
+void sr_txq_destroy(struct sr_txq* txq);
+
+int sr_txq_add(struct sr_txq* txq, struct sr_pbuf* pb, void* msg,
+        unsigned int len, uint64_t now);
+int sr_txq_holds(struct sr_txq* txq, const void* msg);
+int sr_txq_flush(struct sr_txq* txq);
+int sr_txq_write(struct sr_txq* txq, const struct iovec* iov, int iovcnt);
+void sr_txq_print(struct sr_txq* txq);
+
+/* -- 1 if the oldest queued message has waited long enough -- */
+static inline int sr_txq_due(const struct sr_txq* txq, uint64_t now)
+{
+    return txq->n && now - txq->first_ms >= SR_TXQ_DELAY_MS;
+} /* -- sr_txq_due -- */
+
+#endif /* -- SR_TXQ_H -- */
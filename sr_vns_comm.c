@@ -35,6 +35,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 
 #include "sr_dumper.h"
 #include "sr_router.h"
@@ -43,14 +44,27 @@
 
 #include "sha1.h"
 #include "sr_pwospf.h"
+#include "sr_pbuf.h"
+#include "sr_rxring.h"
+#include "sr_timer.h"
+#include "sr_txq.h"
+#include "sr_worker.h"
+#include "sr_event.h"
 #include "vnscommand.h"
 
+#define VNS_MAX_COMMAND 10000 /* bytes, longer ones are refused */
+
 static void sr_log_packet(struct sr_instance* , uint8_t* , int );
 static int  sr_arp_req_not_for_us(struct sr_instance* sr,
                                   uint8_t * packet /* lent */,
                                   unsigned int len,
-                                  char* interface  /* lent */);
+                                  struct sr_if* iface  /* lent */);
 int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expected_cmd);
+static int sr_wait_for_server(struct sr_instance* sr /* borrowed */);
+static ssize_t sr_read_server(void* ctx, void* buf, size_t count);
+static ssize_t sr_write_server(void* ctx, const struct iovec* iov, int iovcnt);
+static int sr_send_message(struct sr_instance* sr, uint8_t* buf,
+                           unsigned int len, struct sr_if* iface, int copy);
 
 /*-----------------------------------------------------------------------------
  * Method: sr_connect_to_server()
@@ -80,6 +94,11 @@ int sr_connect_to_server(struct sr_instance* sr,unsigned short port,
     assert(sr);
     assert(server);
 
+    if(sr->txq == 0)
+    { sr->txq = sr_txq_create(sr_write_server, sr); }
+    if(sr->rx == 0)
+    { sr->rx = sr_rxring_create(SR_RXRING_SIZE, VNS_MAX_COMMAND); }
+
     /* purify UMR be gone ! */
     memset((void*)&command,0,sizeof(c_open));
 
@@ -328,99 +347,126 @@ int sr_handle_auth_status(struct sr_instance* sr, c_auth_status* status) {
  * Scope: global
  *
  * Houses main while loop for communicating with the virtual router server.
+ * Runs the router's timers while it waits for the next command, and
+ * sends what the forwarding workers have passed back, if there are any.
  *
  *---------------------------------------------------------------------------*/
 
 int sr_read_from_server(struct sr_instance* sr /* borrowed */)
 {
+    if(sr->workers)
+    { sr_workers_drain(sr->workers); }
+    if(sr_rxring_pending(sr->rx))
+    {
+        /* -- more of the batch already read, unless a send is late -- */
+        if(sr->txq && sr->txq->n && sr_txq_due(sr->txq, sr_timer_now_ms()))
+        { sr_send_flush(sr); }
+    }
+    else
+    {
+        /* -- the end of the batch: send what it produced, wait for more -- */
+        sr_send_flush(sr);
+        if(sr->loop && sr_wait_for_server(sr) != 0)
+        { return -1; }
+    }
     return sr_read_from_server_expect(sr, 0);
 }
 
-int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expected_cmd)
+/*-----------------------------------------------------------------------------
+ * Method: sr_wait_for_server(..)
+ * Scope: local
+ *
+ * Run the event loop until the server connection is readable: timers
+ * fire and the control socket is served in the meantime.  Frames
+ * forwarding workers pass back also wake it up, and are sent at once.
+ *
+ *---------------------------------------------------------------------------*/
+
+static int sr_wait_for_server(struct sr_instance* sr /* borrowed */)
 {
-    int command, len;
-    unsigned char *buf = 0;
-    c_packet_ethernet_header* sr_pkt = 0;
-    int ret = 0, bytes_read = 0;
+    int fd;
 
-    /* REQUIRES */
-    assert(sr);
+    if(sr->server_ev == 0)
+    {
+#ifdef VNL
+        fd = sr->vc->read_fd;
+#else
+        fd = sr->sockfd;
+#endif
+        if((sr->server_ev = sr_event_add(sr->loop, fd, EPOLLIN, 0, 0)) == 0)
+        { return -1; }
+    }
 
-    /*---------------------------------------------------------------------------
-      Read a command from the server
-      -------------------------------------------------------------------------*/
+    for(;;)
+    {
+        sr_event_loop_timers(sr->loop);
+
+        /* -- frames came back since the last look, send them first -- */
+        if(sr->workers && sr_workers_idle(sr->workers))
+        {
+            sr_send_flush(sr);
+            continue;
+        }
+        if(sr_event_loop_wait(sr->loop) < 0)
+        { return -1; }
+        if(sr->workers)
+        { sr_workers_busy(sr->workers); }
+        if(sr->server_ev->revents)
+        { return 0; }
+    }
+} /* -- sr_wait_for_server -- */
 
-    bytes_read = 0;
+/* -- the receive ring's way to the server -- */
+static ssize_t sr_read_server(void* ctx, void* buf, size_t count)
+{
+    struct sr_instance* sr = (struct sr_instance*)ctx;
 
-    /* attempt to read the size of the incoming packet */
-    while( bytes_read < 4)
-    {
-        do
-        { /* -- just in case SIGALRM breaks recv -- */
-            errno = 0; /* -- hacky glibc workaround -- */
 #ifdef VNL
-            if((ret = vnl_read(sr->vc,((uint8_t*)&len) + bytes_read,
-                            4 - bytes_read)) == -1)
+    return vnl_read(sr->vc, buf, count);
 #else
-            if((ret = recv(sr->sockfd,((uint8_t*)&len) + bytes_read,
-                            4 - bytes_read, 0)) == -1)
+    return read(sr->sockfd, buf, count);
 #endif
-            {
-                if ( errno == EINTR )
-                { continue; }
+} /* -- sr_read_server -- */
 
-                perror("recv(..):sr_client.c::sr_read_from_server");
-                return -1;
-            }
-            bytes_read += ret;
-        } while ( errno == EINTR); /* be mindful of signals */
+int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expected_cmd)
+{
+    int command;
+    unsigned int len;
+    unsigned char *buf = 0;
+    c_packet_ethernet_header* sr_pkt = 0;
+    struct sr_if* iface = 0;
+    ssize_t got;
+    int ret = 0;
 
-    }
+    /* REQUIRES */
+    assert(sr);
+    assert(sr->rx);
 
-    len = ntohl(len);
+    /*---------------------------------------------------------------------------
+      Take a command from the receive ring, reading more until it has one
+      -------------------------------------------------------------------------*/
 
-    if ( len > 10000 || len < 0 )
+    while((ret = sr_rxring_next(sr->rx, &buf, &len)) == 0)
     {
-        fprintf(stderr,"Error: command length to large %d\n",len);
-        close(sr->sockfd);
-        return -1;
+        /* -- queued sends may point into the ring, which a read may move -- */
+        sr_send_flush(sr);
+        if((got = sr_rxring_fill(sr->rx, sr_read_server, sr)) <= 0)
+        {
+            if(got == 0)
+            { fprintf(stderr,"Error: server closed the connection\n"); }
+            else
+            { perror("read(..):sr_vns_comm.c::sr_read_from_server"); }
+            return -1;
+        }
     }
 
-    if((buf = malloc(len)) == 0)
+    if ( ret < 0 )
     {
-        fprintf(stderr,"Error: out of memory (sr_read_from_server)\n");
+        fprintf(stderr,"Error: command length to large %u\n",len);
+        close(sr->sockfd);
         return -1;
     }
 
-    /* set first field of command since we've already read it */
-    *((int *)buf) = htonl(len);
-
-    bytes_read = 0;
-
-    /* read the rest of the command */
-    while ( bytes_read < len - 4)
-    {
-        do
-        {/* -- just in case SIGALRM breaks recv -- */
-            errno = 0; /* -- hacky glibc workaround -- */
-#ifdef VNL
-            if ((ret = vnl_read(sr->vc, buf+4+bytes_read, len - 4 - bytes_read)) ==
-                    -1)
-#else
-            if ((ret = read(sr->sockfd, buf+4+bytes_read, len - 4 - bytes_read)) ==
-                    -1)
-#endif
-            {
-                if ( errno == EINTR )
-                { continue; }
-                fprintf(stderr,"Error: failed reading command body %d\n",ret);
-                close(sr->sockfd);
-                return -1;
-            }
-            bytes_read += ret;
-        } while (errno == EINTR); /* be mindful of signals */
-    }
-
     /* My entry for most unreadable line of code - guido */
     /* ... you win - mc                                  */
     command = *(((int *)buf)+1) = ntohl(*(((int *)buf)+1));
@@ -441,12 +487,21 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
         case VNSPACKET:
             sr_pkt = (c_packet_ethernet_header *)buf;
 
+            /* -- resolve the interface name once for the whole frame -- */
+            iface = sr_get_interface(sr, sr_pkt->mInterfaceName);
+            if ( iface == 0 )
+            {
+                fprintf(stderr, "** Error, packet on unknown interface %.16s\n",
+                        sr_pkt->mInterfaceName);
+                break;
+            }
+
             /* -- check if it is an ARP to another router if so drop   -- */
             if ( sr_arp_req_not_for_us(sr,
                     (buf+sizeof(c_packet_header)),
                     len - sizeof(c_packet_ethernet_header) +
                     sizeof(struct sr_ethernet_hdr),
-                    (char*)(buf + sizeof(c_base))) )
+                    iface) )
             { break; }
 
             /* -- log packet -- */
@@ -454,11 +509,22 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
                     ntohl(sr_pkt->mLen) - sizeof(c_packet_header));
 
             /* -- pass to router, student's code should take over here -- */
-            sr_handlepacket(sr,
-                    (buf+sizeof(c_packet_header)),
-                    len - sizeof(c_packet_ethernet_header) +
-                    sizeof(struct sr_ethernet_hdr),
-                    (char*)(buf + sizeof(c_base)));
+            if(sr->workers)
+            {
+                sr_dispatchpacket(sr,
+                        (buf+sizeof(c_packet_header)),
+                        len - sizeof(c_packet_ethernet_header) +
+                        sizeof(struct sr_ethernet_hdr),
+                        iface);
+            }
+            else
+            {
+                sr_handlepacket(sr,
+                        (buf+sizeof(c_packet_header)),
+                        len - sizeof(c_packet_ethernet_header) +
+                        sizeof(struct sr_ethernet_hdr),
+                        iface);
+            }
 
             break;
 
@@ -468,8 +534,6 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
             fprintf(stderr,"VNS server closed session.\n");
             fprintf(stderr,"Reason: %s\n",((c_close*)buf)->mErrorMessage);
 
-            if(buf)
-            { free(buf); }
             return 0;
             break;
 
@@ -490,6 +554,8 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
             }
             /* Initialization for control subsystem. */
             pwospf_init(sr);
+            /* -- resolve the known next hops before traffic needs them -- */
+            arp_warm_up(sr);
             printf(" <-- Ready to process packets --> \n");
             break;
 
@@ -517,8 +583,6 @@ int sr_read_from_server_expect(struct sr_instance* sr /* borrowed */, int expect
 
     }/* -- switch -- */
 
-    if(buf)
-    { free(buf); }
     return ret;
 }/* -- sr_read_from_server -- */
 
@@ -534,24 +598,16 @@ static
 int
 sr_ether_addrs_match_interface( struct sr_instance* sr, /* borrowed */
                                 uint8_t* buf, /* borrowed */
-                                const char* name /* borrowed */ )
+                                struct sr_if* iface /* borrowed */ )
 {
     struct sr_ethernet_hdr* ether_hdr = 0;
-    struct sr_if* iface = 0;
 
     /* -- REQUIRES -- */
     assert(sr);
     assert(buf);
-    assert(name);
+    assert(iface);
 
     ether_hdr = (struct sr_ethernet_hdr*)buf;
-    iface = sr_get_interface(sr, name);
-
-    if ( iface == 0 )
-    {
-        fprintf( stderr, "** Error, interface %s, does not exist\n", name);
-        return 0;
-    }
 
     if ( memcmp( ether_hdr->ether_shost, iface->addr, ETHER_ADDR_LEN) != 0 )
     {
@@ -583,8 +639,88 @@ int sr_send_packet(struct sr_instance* sr /* borrowed */,
                          unsigned int len,
                          const char* iface /* borrowed */)
 {
-    c_packet_header *sr_pkt;
+    struct sr_if* if_rec;
+
+    /* REQUIRES */
+    assert(sr);
+    assert(iface);
+
+    if_rec = sr_get_interface(sr, iface);
+    if ( if_rec == 0 )
+    {
+        fprintf( stderr, "** Error, interface %s, does not exist\n", iface);
+        return -1;
+    }
+
+    return sr_send_packet_if(sr, buf, len, if_rec);
+} /* -- sr_send_packet -- */
+
+/*-----------------------------------------------------------------------------
+ * Method: sr_send_packet_if(..)
+ * Scope: Global
+ *
+ * sr_send_packet for callers that already hold the interface record.
+ * The frame is copied to the transmit queue, buf is free to change as
+ * soon as this returns.
+ *
+ *---------------------------------------------------------------------------*/
+
+int sr_send_packet_if(struct sr_instance* sr /* borrowed */,
+                      uint8_t* buf /* borrowed */ ,
+                      unsigned int len,
+                      struct sr_if* iface /* borrowed */)
+{
+    return sr_send_message(sr, buf, len, iface, 1);
+} /* -- sr_send_packet_if -- */
+
+/*-----------------------------------------------------------------------------
+ * Method: sr_send_packet_nocopy(..)
+ * Scope: Global
+ *
+ * sr_send_packet_if for a frame that stays as it is until sent, such as
+ * a forwarded one.  A frame in a pooled buffer with room in front of it
+ * is queued where it is, behind a VNS header written into that room.
+ *
+ *---------------------------------------------------------------------------*/
+
+int sr_send_packet_nocopy(struct sr_instance* sr /* borrowed */,
+                          uint8_t* buf /* borrowed */ ,
+                          unsigned int len,
+                          struct sr_if* iface /* borrowed */)
+{
+    return sr_send_message(sr, buf, len, iface, 0);
+} /* -- sr_send_packet_nocopy -- */
+
+/* -- write out the transmit queue, 0 or -1 if a write failed -- */
+int sr_send_flush(struct sr_instance* sr /* borrowed */)
+{
+    if(sr->txq == 0)
+    { return 0; }
+    return sr_txq_flush(sr->txq);
+} /* -- sr_send_flush -- */
+
+/*-----------------------------------------------------------------------------
+ * Method: sr_send_message(..)
+ * Scope: Local
+ *
+ * Put the VNS header in front of the frame and queue the message.  When
+ * copy is 0 the frame is queued where it is if it can be: as the frame
+ * of the command being handled, over the header it came with, or in a
+ * pooled buffer with room in front.  Otherwise it is copied into a new
+ * pooled buffer, and without one, written at once with writev from a
+ * header on the stack.
+ *
+ *---------------------------------------------------------------------------*/
+
+static int sr_send_message(struct sr_instance* sr, uint8_t* buf,
+                           unsigned int len, struct sr_if* iface, int copy)
+{
+    c_packet_header *sr_pkt = 0;
+    c_packet_header hdr;
+    struct sr_pbuf* pb = 0;
+    struct iovec iov[2];
     unsigned int total_len =  len + (sizeof(c_packet_header));
+    int ret;
 
     /* REQUIRES */
     assert(sr);
@@ -597,40 +733,84 @@ int sr_send_packet(struct sr_instance* sr /* borrowed */,
         return -1;
     }
 
-    /* Create packet */
-    sr_pkt = (c_packet_header *)malloc(len +
-            sizeof(c_packet_header));
-    assert(sr_pkt);
-    sr_pkt->mLen  = htonl(total_len);
-    sr_pkt->mType = htonl(VNSPACKET);
-    strncpy(sr_pkt->mInterfaceName,iface,16);
-    memcpy(((uint8_t*)sr_pkt) + sizeof(c_packet_header),
-            buf,len);
-
     /* -- log packet -- */
     sr_log_packet(sr,buf,len);
 
     if ( ! sr_ether_addrs_match_interface( sr, buf, iface) )
     {
         fprintf( stderr, "*** Error: problem with ethernet header, check log\n");
-        free ( sr_pkt );
         return -1;
     }
 
-#ifdef VNL
-    if( vnl_write(sr->vc, sr_pkt, total_len) < total_len )
-#else
-    if( write(sr->sockfd, sr_pkt, total_len) < total_len )
-#endif
+    /* -- where the frame is, unless already queued under another header -- */
+    if(!copy && sr->txq)
+    {
+        sr_pkt = (c_packet_header *)(buf - sizeof(c_packet_header));
+        if(sr->rx && sr_rxring_is_current(sr->rx, (uint8_t*)sr_pkt, total_len))
+        { pb = 0; }
+        else if((pb = sr_pbuf_of(sr->pbufs, buf)) == 0 ||
+                sr_pbuf_headroom(pb, buf) < sizeof(c_packet_header) ||
+                buf + len > pb->buf + SR_PBUF_SIZE)
+        { sr_pkt = 0; }
+        if(sr_pkt && sr_txq_holds(sr->txq, sr_pkt))
+        { sr_pkt = 0; }
+        if(sr_pkt == 0)
+        { pb = 0; }
+    }
+    if(sr_pkt == 0 && sr->txq && len <= SR_PBUF_SIZE - SR_PBUF_HEADROOM &&
+       (pb = sr_pbuf_alloc(sr->pbufs)) != 0)
+    {
+        memcpy(sr_pbuf_data(pb), buf, len);
+        buf = sr_pbuf_data(pb);
+        sr_pkt = (c_packet_header *)(buf - sizeof(c_packet_header));
+    }
+    else if(pb)
+    { sr_pbuf_hold(pb); }
+
+    /* Create packet header, in front of the frame if it is queued */
+    if(sr_pkt == 0)
+    { sr_pkt = &hdr; }
+    sr_pkt->mLen  = htonl(total_len);
+    sr_pkt->mType = htonl(VNSPACKET);
+    strncpy(sr_pkt->mInterfaceName,iface->name,16);
+
+    if(sr_pkt != &hdr)
+    {
+        ret = sr_txq_add(sr->txq, pb, sr_pkt, total_len, sr_timer_now_ms());
+        if(pb)
+        { sr_pbuf_put(pb); }
+    }
+    else
+    {
+        iov[0].iov_base = &hdr;
+        iov[0].iov_len = sizeof(c_packet_header);
+        iov[1].iov_base = buf;
+        iov[1].iov_len = len;
+        if(sr->txq)
+        { ret = sr_txq_write(sr->txq, iov, 2); }
+        else
+        { ret = sr_write_server(sr, iov, 2) < total_len ? -1 : 0; }
+    }
+
+    if(ret != 0)
     {
         fprintf(stderr, "Error writing packet\n");
-        free(sr_pkt);
         return -1;
     }
-
-    free(sr_pkt);
     return 0;
-} /* -- sr_send_packet -- */
+} /* -- sr_send_message -- */
+
+/* -- the transmit queue's way to the server -- */
+static ssize_t sr_write_server(void* ctx, const struct iovec* iov, int iovcnt)
+{
+    struct sr_instance* sr = (struct sr_instance*)ctx;
+
+#ifdef VNL
+    return vnl_writev(sr->vc, iov, iovcnt);
+#else
+    return writev(sr->sockfd, iov, iovcnt);
+#endif
+} /* -- sr_write_server -- */
 
 /*-----------------------------------------------------------------------------
  * Method: sr_log_packet()
@@ -668,9 +848,8 @@ void sr_log_packet(struct sr_instance* sr, uint8_t* buf, int len )
 int  sr_arp_req_not_for_us(struct sr_instance* sr,
                            uint8_t * packet /* lent */,
                            unsigned int len,
-                           char* interface  /* lent */)
+                           struct sr_if* iface  /* lent */)
 {
-    struct sr_if* iface = sr_get_interface(sr, interface);
     struct sr_ethernet_hdr* e_hdr = 0;
     struct sr_arphdr*       a_hdr = 0;
 
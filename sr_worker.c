@@ -0,0 +1,340 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_worker.c
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Forwarding workers, see sr_worker.h.
+ *
+ * Sleeping and waking on both sides follow one pattern.  The sleeper
+ * announces it is going to sleep, then looks at its ring once more; the
+ * other side pushes to the ring, then looks for the announcement.  With
+ * a full fence between the write and the read on each side, at least
+ * one of them sees the other's write, so a frame is never left in a
+ * ring with its consumer asleep.
+ *
+ *---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "sr_worker.h"
+
+/* -- wake the packet thread if it is in, or going into, poll -- */
+static void worker_wake_io(struct sr_workers* ws)
+{
+    ssize_t ret;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&ws->io_idle, __ATOMIC_RELAXED) &&
+       !__atomic_exchange_n(&ws->wake_pending, 1, __ATOMIC_SEQ_CST))
+    {
+        ret = write(ws->wake[1], "w", 1);
+        (void)ret;
+    }
+} /* -- worker_wake_io -- */
+
+/* -- hand pb back, waiting while the packet thread catches up -- */
+static void worker_return(struct sr_worker* w, struct sr_pbuf* pb)
+{
+    struct sr_workers* ws = w->pool;
+
+    while(sr_spsc_push(&w->out, pb) != 0)
+    {
+        /* -- nobody is draining any more, let it go -- */
+        if(__atomic_load_n(&ws->stop, __ATOMIC_ACQUIRE))
+        {
+            sr_pbuf_put(pb);
+            return;
+        }
+        worker_wake_io(ws);
+        sched_yield();
+    }
+} /* -- worker_return -- */
+
+/*---------------------------------------------------------------------
+ * Method: worker_wait(..)
+ * Scope: Local
+ *
+ * Sleep until w has a frame to route.  Returns 1 if instead the workers
+ * are stopping and w has nothing left to do.
+ *
+ *---------------------------------------------------------------------*/
+
+static int worker_wait(struct sr_worker* w)
+{
+    struct sr_workers* ws = w->pool;
+    int stop;
+
+    pthread_mutex_lock(&w->lock);
+    __atomic_store_n(&w->sleeping, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while(sr_spsc_empty(&w->in) && !__atomic_load_n(&ws->stop, __ATOMIC_ACQUIRE))
+    { pthread_cond_wait(&w->cond, &w->lock); }
+    __atomic_store_n(&w->sleeping, 0, __ATOMIC_RELAXED);
+    stop = sr_spsc_empty(&w->in);
+    pthread_mutex_unlock(&w->lock);
+    return stop;
+} /* -- worker_wait -- */
+
+static void* worker_main(void* arg)
+{
+    struct sr_worker* w = (struct sr_worker*)arg;
+    struct sr_workers* ws = w->pool;
+    struct sr_pbuf* pb;
+    unsigned int n;
+
+    for(;;)
+    {
+        if((pb = (struct sr_pbuf*)sr_spsc_pop(&w->in)) == 0)
+        {
+            if(worker_wait(w))
+            { break; }
+            continue;
+        }
+
+        /* -- routes found stay good until the frames are back in line -- */
+        sr_rcu_read_lock(ws->rcu, w->reader);
+        n = 0;
+        do
+        {
+            w->packets++;
+            if(ws->route(ws->ctx, pb))
+            { w->routed++; }
+            worker_return(w, pb);
+        } while(++n < SR_WORKER_BATCH &&
+                (pb = (struct sr_pbuf*)sr_spsc_pop(&w->in)) != 0);
+        sr_rcu_read_unlock(w->reader);
+        worker_wake_io(ws);
+    }
+    sr_pbuf_thread_flush();
+    return 0;
+} /* -- worker_main -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_workers_create(..)
+ * Scope: Global
+ *
+ * Start n worker threads.  route is called on a worker for each frame,
+ * inside a read section of rcu, and returns 1 if it routed the frame;
+ * transmit is called on the packet thread when the frame is back.
+ * Returns 0 if a thread or its rings could not be set up.
+ *
+ *---------------------------------------------------------------------*/
+
+struct sr_workers* sr_workers_create(unsigned int n, struct sr_rcu* rcu,
+        int (*route)(void* ctx, struct sr_pbuf* pb),
+        void (*transmit)(void* ctx, struct sr_pbuf* pb),
+        void* ctx)
+{
+    struct sr_workers* ws;
+    struct sr_worker* w;
+    unsigned int i;
+
+    assert(rcu && route && transmit);
+    if(n == 0 || n > SR_WORKER_MAX)
+    { return 0; }
+    ws = (struct sr_workers*)calloc(1, sizeof(struct sr_workers));
+    assert(ws);
+    if(posix_memalign((void**)&ws->w, 64, n * sizeof(struct sr_worker)) != 0)
+    {
+        free(ws);
+        return 0;
+    }
+    memset(ws->w, 0, n * sizeof(struct sr_worker));
+    ws->rcu = rcu;
+    ws->route = route;
+    ws->transmit = transmit;
+    ws->ctx = ctx;
+    if(pipe(ws->wake) != 0)
+    {
+        perror("pipe(..):sr_worker.c::sr_workers_create");
+        free(ws->w);
+        free(ws);
+        return 0;
+    }
+    fcntl(ws->wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(ws->wake[1], F_SETFL, O_NONBLOCK);
+
+    for(i = 0; i < n; i++)
+    {
+        w = &ws->w[i];
+        w->pool = ws;
+        pthread_mutex_init(&w->lock, 0);
+        pthread_cond_init(&w->cond, 0);
+        if(sr_spsc_init(&w->in, SR_WORKER_RING) != 0 ||
+           sr_spsc_init(&w->out, SR_WORKER_RING) != 0 ||
+           (w->reader = sr_rcu_register(rcu)) == 0 ||
+           pthread_create(&w->thread, 0, worker_main, w) != 0)
+        {
+            fprintf(stderr, "Error starting forwarding worker %u\n", i);
+            sr_spsc_free(&w->in);
+            sr_spsc_free(&w->out);
+            sr_workers_destroy(ws);
+            return 0;
+        }
+        ws->n++;
+    }
+    return ws;
+} /* -- sr_workers_create -- */
+
+/* -- stop the workers; frames still in their rings are dropped -- */
+void sr_workers_destroy(struct sr_workers* ws)
+{
+    struct sr_worker* w;
+    struct sr_pbuf* pb;
+    unsigned int i;
+
+    if(ws == 0)
+    { return; }
+    __atomic_store_n(&ws->stop, 1, __ATOMIC_RELEASE);
+    for(i = 0; i < ws->n; i++)
+    {
+        w = &ws->w[i];
+        pthread_mutex_lock(&w->lock);
+        pthread_cond_signal(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+    }
+    for(i = 0; i < ws->n; i++)
+    {
+        w = &ws->w[i];
+        pthread_join(w->thread, 0);
+        while((pb = (struct sr_pbuf*)sr_spsc_pop(&w->out)) != 0)
+        { sr_pbuf_put(pb); }
+        sr_spsc_free(&w->in);
+        sr_spsc_free(&w->out);
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->lock);
+    }
+    close(ws->wake[0]);
+    close(ws->wake[1]);
+    free(ws->w);
+    free(ws);
+} /* -- sr_workers_destroy -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_workers_dispatch(..)
+ * Scope: Global
+ *
+ * Packet thread: hand pb, and the caller's reference to it, to the
+ * worker for flow hash.  Returns 0, or -1 if that worker's ring is full
+ * and pb was dropped.
+ *
+ *---------------------------------------------------------------------*/
+
+int sr_workers_dispatch(struct sr_workers* ws, struct sr_pbuf* pb,
+        uint32_t hash)
+{
+    struct sr_worker* w = &ws->w[hash % ws->n];
+
+    if(sr_spsc_push(&w->in, pb) != 0)
+    {
+        w->dropped++;
+        sr_pbuf_put(pb);
+        return -1;
+    }
+    ws->dispatched++;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&w->sleeping, __ATOMIC_RELAXED))
+    {
+        pthread_mutex_lock(&w->lock);
+        pthread_cond_signal(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+    }
+    return 0;
+} /* -- sr_workers_dispatch -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_workers_drain(..)
+ * Scope: Global
+ *
+ * Packet thread: run the transmit callback on every frame the workers
+ * have passed back, taking up to SR_WORKER_BATCH from each in turn so
+ * that a busy worker does not hold up the others.  Returns how many.
+ *
+ *---------------------------------------------------------------------*/
+
+unsigned int sr_workers_drain(struct sr_workers* ws)
+{
+    struct sr_pbuf* pb;
+    unsigned int i, k, got, total = 0;
+
+    do
+    {
+        got = 0;
+        for(i = 0; i < ws->n; i++)
+        {
+            for(k = 0; k < SR_WORKER_BATCH; k++)
+            {
+                if((pb = (struct sr_pbuf*)sr_spsc_pop(&ws->w[i].out)) == 0)
+                { break; }
+                ws->transmit(ws->ctx, pb);
+                sr_pbuf_put(pb);
+            }
+            got += k;
+        }
+        total += got;
+    } while(got);
+    ws->drained += total;
+    return total;
+} /* -- sr_workers_drain -- */
+
+/*---------------------------------------------------------------------
+ * Method: sr_workers_idle(..)
+ * Scope: Global
+ *
+ * Packet thread, before it polls: from now on workers wake it through
+ * the pipe.  Drains the workers once more, after saying so; if that
+ * found anything, returns how many and the thread should not sleep yet.
+ *
+ *---------------------------------------------------------------------*/
+
+unsigned int sr_workers_idle(struct sr_workers* ws)
+{
+    unsigned int n;
+
+    __atomic_store_n(&ws->io_idle, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if((n = sr_workers_drain(ws)) != 0)
+    { __atomic_store_n(&ws->io_idle, 0, __ATOMIC_RELAXED); }
+    return n;
+} /* -- sr_workers_idle -- */
+
+/* -- packet thread, after it polls: empty the pipe, back to draining -- */
+void sr_workers_busy(struct sr_workers* ws)
+{
+    char buf[64];
+
+    __atomic_store_n(&ws->io_idle, 0, __ATOMIC_SEQ_CST);
+    /* -- a byte written after this read costs one early return from poll -- */
+    __atomic_store_n(&ws->wake_pending, 0, __ATOMIC_SEQ_CST);
+    while(read(ws->wake[0], buf, sizeof(buf)) > 0)
+    { }
+} /* -- sr_workers_busy -- */
+
+int sr_workers_wake_fd(const struct sr_workers* ws)
+{
+    return ws->wake[0];
+} /* -- sr_workers_wake_fd -- */
+
+void sr_workers_print(struct sr_workers* ws)
+{
+    struct sr_worker* w;
+    unsigned int i;
+
+    printf("Forwarding workers: %u, %lu frames handed out, %lu back\n",
+           ws->n, ws->dispatched, ws->drained);
+    for(i = 0; i < ws->n; i++)
+    {
+        w = &ws->w[i];
+        printf("  worker %u: %lu frames, %lu routed, %lu dropped on a full "
+               "ring\n", i, w->packets, w->routed, w->dropped);
+    }
+} /* -- sr_workers_print -- */
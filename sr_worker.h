@@ -0,0 +1,101 @@
+/*-----------------------------------------------------------------------------
+ * file:  sr_worker.h
+ * date:  Sat Oct 17 2026
+ *
+ * Description:
+ *
+ * Forwarding workers.  The packet thread, which reads the server
+ * connection, hands each frame it is given to one of n worker threads,
+ * picked by a hash of the frame's flow, over a ring only it pushes to
+ * and only that worker pops from.  The worker runs the route callback
+ * on it, inside an RCU read section of its own, and passes it back over
+ * a second ring the other way.  The packet thread drains the workers'
+ * rings in turn and runs the transmit callback on each frame, which
+ * sends it or handles whatever the worker left undone.
+ *
+ * A flow always goes to the same worker, and both rings are first in
+ * first out, so the frames of a flow come back in the order they went
+ * out.  A frame that finds its worker's ring full is dropped.
+ *
+ * An idle worker sleeps on a condition variable until the packet thread
+ * gives it a frame.  The packet thread sleeps in poll; a worker that
+ * passes frames back while it does wakes it through a pipe, whose read
+ * end sr_workers_wake_fd gives for the poll set.
+ *
+ *---------------------------------------------------------------------------*/
+
+#ifndef SR_WORKER_H
+#define SR_WORKER_H
+
+#ifdef _LINUX_
+#include <stdint.h>
+#endif /* _LINUX_ */
+
+#ifdef _DARWIN_
+#include <inttypes.h>
+#endif /* _DARWIN_ */
+
+#include <pthread.h>
+
+#include "sr_spsc.h"
+#include "sr_pbuf.h"
+#include "sr_rcu.h"
+
+#define SR_WORKER_MAX   32
+#define SR_WORKER_RING  1024          /* frames each way per worker */
+#define SR_WORKER_BATCH 64            /* frames per read section or turn */
+
+struct sr_workers;
+
+struct sr_worker
+{
+    struct sr_spsc in;                /* from the packet thread */
+    struct sr_spsc out;               /* back to it */
+    struct sr_workers* pool;
+    pthread_t thread;
+    struct sr_rcu_reader* reader;
+    pthread_mutex_t lock;             /* with cond, for sleeping */
+    pthread_cond_t cond;
+    int sleeping;
+
+    unsigned long packets;            /* routed or not, by the worker */
+    unsigned long routed;             /* the route callback said yes */
+    unsigned long dropped;            /* by the packet thread, ring full */
+} __attribute__((aligned(64)));
+
+struct sr_workers
+{
+    struct sr_worker* w;
+    unsigned int n;
+    struct sr_rcu* rcu;
+    int stop;
+
+    /* -- supplied by the owner, ctx is passed back to each -- */
+    int (*route)(void* ctx, struct sr_pbuf* pb);
+    void (*transmit)(void* ctx, struct sr_pbuf* pb);
+    void* ctx;
+
+    /* -- waking the packet thread -- */
+    int wake[2];                      /* pipe */
+    int io_idle;                      /* it is about to poll, or polling */
+    int wake_pending;                 /* a byte is in the pipe */
+
+    unsigned long dispatched;
+    unsigned long drained;
+};
+
+struct sr_workers* sr_workers_create(unsigned int n, struct sr_rcu* rcu,
+        int (*route)(void* ctx, struct sr_pbuf* pb),
+        void (*transmit)(void* ctx, struct sr_pbuf* pb),
+        void* ctx);
+void sr_workers_destroy(struct sr_workers* ws);
+
+int sr_workers_dispatch(struct sr_workers* ws, struct sr_pbuf* pb,
+        uint32_t hash);
+unsigned int sr_workers_drain(struct sr_workers* ws);
+unsigned int sr_workers_idle(struct sr_workers* ws);
+void sr_workers_busy(struct sr_workers* ws);
+int sr_workers_wake_fd(const struct sr_workers* ws);
+void sr_workers_print(struct sr_workers* ws);
+
+#endif /* -- SR_WORKER_H -- */
@@ -48,6 +48,11 @@ ssize_t vnl_write(struct VnlConn* vc, const void* buf, size_t count) {
 	return write(vc->write_fd,buf,count);
 }
 
+ssize_t vnl_writev(struct VnlConn* vc, const struct iovec* iov, int iovcnt) {
+	vnl_checkconn(vc);
+	return writev(vc->write_fd,iov,iovcnt);
+}
+
 void vnl_close(struct VnlConn* vc) {
 	close(vc->read_fd); close(vc->write_fd);
 	kill(vc->ssh_pid,SIGKILL);
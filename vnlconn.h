@@ -9,6 +9,7 @@ Junxiao Shi, University of Arizona
 #define VNLCONN_H
 #include <stdint.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 struct VnlConn {
 	pid_t ssh_pid;
@@ -19,6 +20,7 @@ struct VnlConn {
 struct VnlConn* vnl_open(uint16_t topoid, const char* host);
 ssize_t vnl_read(struct VnlConn* vc, void* buf, size_t count);
 ssize_t vnl_write(struct VnlConn* vc, const void* buf, size_t count);
+ssize_t vnl_writev(struct VnlConn* vc, const struct iovec* iov, int iovcnt);
 void vnl_close(struct VnlConn* vc);
 void vnl_checkconn(struct VnlConn* vc);
 